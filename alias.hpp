@@ -0,0 +1,51 @@
+#ifndef __ALIAS_HPP__
+#define __ALIAS_HPP__
+
+#include <llvm/IR/Instruction.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Type.h>
+
+/* -O: type based alias analysis metadata (!tbaa) on the loads and stores of the program's memory. Every place in a
+ * stack frame or an array holds one kind of value for as long as it lives, and the kinds never overlap: int data
+ * (i64), char data (i8), frame links (the first field of every frame, followed to reach the variables of the
+ * functions a function is nested in), refs (the pointers to the caller's variables a frame keeps) and the --budget
+ * left (libgrc's counter, which the program only charges, see Func_def::meter). So a store
+ * to an int array doesn't clobber a char array, the static link or a ref, and the loads of those stay out of the
+ * loops that write arrays (GVN and LICM move them, and the vectorizer finds the array pointers loop invariant).
+ * Whatever isn't tagged (the runtime lib, the other instrumentation, whole strings) may be any of them.
+ */
+class alias_tags {
+	public:
+		explicit alias_tags(llvm::LLVMContext &c) : i8(llvm::Type::getInt8Ty(c)), i64(llvm::Type::getInt64Ty(c)) {
+			llvm::MDBuilder md(c);
+			llvm::MDNode* const root = md.createTBAARoot("grace");
+			int_tag  = tag(md, root, "int");
+			char_tag = tag(md, root, "char");
+			link_tag = tag(md, root, "frame link");
+			ref_tag  = tag(md, root, "ref");
+			budget_tag = tag(md, root, "budget");
+		}
+
+		/* i accesses an int or a char (by t), or a ref a frame keeps (a pointer) */
+		void data(llvm::Instruction* const i, llvm::Type* const t) const {
+			if(t == i64)              i->setMetadata(llvm::LLVMContext::MD_tbaa, int_tag);
+			else if(t == i8)          i->setMetadata(llvm::LLVMContext::MD_tbaa, char_tag);
+			else if(t->isPointerTy()) i->setMetadata(llvm::LLVMContext::MD_tbaa, ref_tag);
+		}
+		/* i accesses the frame link of a frame */
+		void link(llvm::Instruction* const i) const { i->setMetadata(llvm::LLVMContext::MD_tbaa, link_tag); }
+		/* i accesses __grc_budget */
+		void budget(llvm::Instruction* const i) const { i->setMetadata(llvm::LLVMContext::MD_tbaa, budget_tag); }
+
+	private:
+		static llvm::MDNode *tag(llvm::MDBuilder &md, llvm::MDNode* const root, const char* const name) {
+			llvm::MDNode* const t = md.createTBAAScalarTypeNode(name, root);
+			return md.createTBAAStructTagNode(t, t, 0);
+		}
+
+		llvm::Type *i8, *i64;
+		llvm::MDNode *int_tag, *char_tag, *link_tag, *ref_tag, *budget_tag;
+};
+
+#endif
@@ -1,9 +1,3 @@
 #include "ast.hpp"
 
-llvm::LLVMContext AST::TheContext;
-llvm::IRBuilder<> AST::Builder(TheContext);
-std::unique_ptr<llvm::Module> AST::TheModule;
-std::unique_ptr<llvm::legacy::FunctionPassManager> AST::TheFPM;
-
-llvm::Type *AST::i8;
-llvm::Type *AST::i64;
+thread_local compiler_session *session = nullptr;
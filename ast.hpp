@@ -4,25 +4,51 @@
 #include <iostream>
 #include <vector>
 #include <deque>
+#include <algorithm>
+#include <atomic>
+#include <climits>
 #include <cstring>
-
-#include "symbol_table.hpp"
-#include "ll_st.hpp"
-
-extern symbol_table st;
-
+#include <functional>
+#include <mutex>
+#include <sstream>
+
+#include "alias.hpp"
+#include "cache.hpp"
+#include "debug.hpp"
+#include "driver.hpp"
+#include "interp.hpp"
+#include "pool.hpp"
+#include "profile.hpp"
+#include "remarks.hpp"
+#include "session.hpp"
+#include "specialize.hpp"
+
+#include <llvm/ADT/SetVector.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/Analysis/TypeBasedAliasAnalysis.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/CFG.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Dominators.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Value.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
 #include <llvm/Transforms/InstCombine/InstCombine.h>
 #include <llvm/Transforms/Scalar.h>
 #include <llvm/Transforms/Scalar/GVN.h>
 #include <llvm/Transforms/Utils.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
+#include <llvm/Transforms/Vectorize.h>
 
-#include "ll_st.hpp"
-
-extern ll_symbol_table ll_st;
 
 /* Global object to control print indentation
  * Callee is expected to use it
@@ -74,76 +100,253 @@ inline std::ostream &operator<<(std::ostream &out, print_align &a) {
 	return out;
 }
 
-extern print_align align;
+extern thread_local print_align align;
 
 /* end of print format code, AST code follows */
 
+class Expr;
+class Func_def;
+class const_eval;
+struct const_frame;
+
 
 class AST {
 	public:
+		virtual ~AST() {}
 		virtual void sem() {};
 		virtual void print(std::ostream &out) const = 0;
+		virtual void fingerprint(std::ostream &out) const = 0; // what its code depends on, for the cache (see Func_def::fingerprint)
 		virtual llvm::Value* compile() const {return nullptr; }
+		virtual void fold(const_eval &ev) {} // after sem (see const_eval)
+		void locate(const int l, const int c) { line = l; column = c; } // by the parser
+
+		int line = 0, column = 0; // where the node starts in the source (for -g)
+
+		/* fast is for -O0/-Og: no function passes at all and (when emitting asm or an object)
+		 * the in-process backend runs without optimizations so it can use FastISel
+		 */
+		void llvm_compile_and_dump(bool optimize=true, bool fast=false, emit_kind emit=EMIT_IR) {
+			begin_module(optimize, fast, emit);
 
-		void llvm_compile_and_dump(bool optimize=true) {
+			// Emit the program code.
+			compile();
+
+			end_module(fast, emit);
+		}
+
+		/* public so --serve can keep warm ones around */
+		static std::unique_ptr<llvm::TargetMachine> create_target_machine(bool fast, const std::string &triple="x86_64-pc-linux-gnu") {
+			static std::once_flag targets_initialized; // target registration isn't thread safe
+			std::call_once(targets_initialized, [] {
+				llvm::InitializeNativeTarget();
+				llvm::InitializeNativeTargetAsmPrinter();
+			});
+			std::string error;
+			const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, error);
+			if (target == nullptr) {
+				if (session != nullptr) session->diag << error << std::endl;
+				throw compile_error(1);
+			}
+			llvm::TargetOptions options;
+			options.EnableFastISel = fast;
+			return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(
+				triple, "generic", "", options, llvm::Reloc::PIC_, {},
+				fast ? llvm::CodeGenOpt::None : llvm::CodeGenOpt::Default
+			));
+		}
+
+	protected:
+		static void begin_module(bool optimize, bool fast, emit_kind emit) {
 			// Initialize
-			TheModule = std::make_unique<llvm::Module>("grace program", TheContext);
-			TheModule->setTargetTriple("x86_64-pc-linux-gnu"); // assuming compilation target (should be automatically changed by clang when compilig the ll)
+			session->linker = nullptr;
+			session->TheModule = std::make_unique<llvm::Module>("grace program", session->TheContext);
+			session->TheModule->setTargetTriple("x86_64-pc-linux-gnu"); // assuming compilation target (should be automatically changed by clang when compilig the ll)
 
-			// add more opts
-			TheFPM = std::make_unique<llvm::legacy::FunctionPassManager>(TheModule.get());
-			if (optimize) {
-				TheFPM->add(llvm::createPromoteMemoryToRegisterPass());
-				TheFPM->add(llvm::createInstructionCombiningPass());
-				TheFPM->add(llvm::createReassociatePass());
-				TheFPM->add(llvm::createGVNPass());
-				TheFPM->add(llvm::createCFGSimplificationPass());
+			if (emit != EMIT_IR || (optimize && !fast)) { // (-O's vectorizer asks the target what its vectors are)
+				if (session->target == nullptr) session->target = (session->own_target = create_target_machine(fast, session->TheModule->getTargetTriple())).get();
+				session->TheModule->setDataLayout(session->target->createDataLayout());
 			}
-			TheFPM->doInitialization();
 
-			// Initialize types
-			i8  = llvm::IntegerType::get(TheContext, 8);
-			i64 = llvm::IntegerType::get(TheContext, 64);
+			session->debug = nullptr;
+			if (session->opts.debug != DEBUG_NONE || session->opts.remarks()) session->debug = std::make_shared<debug_info>(*session->TheModule, session->opts);
+			session->remarks = nullptr;
+			if (session->opts.remarks()) session->remarks = std::make_shared<optimization_remarks>(session->TheContext, session->opts);
+
+			// add more opts
+			session->TheFPM = nullptr;
+			session->tbaa   = nullptr;
+			if (optimize && !fast) {
+				session->TheFPM = std::make_unique<llvm::legacy::FunctionPassManager>(session->TheModule.get());
+				session->TheFPM->add(llvm::createTargetTransformInfoWrapperPass(session->target->getTargetIRAnalysis()));
+				session->TheFPM->add(llvm::createTypeBasedAAWrapperPass()); // (see alias.hpp)
+				session->TheFPM->add(llvm::createSROAPass()); // the frames no nested function sees and no ref points into
+				session->TheFPM->add(llvm::createPromoteMemoryToRegisterPass());
+				session->TheFPM->add(llvm::createInstructionCombiningPass());
+				session->TheFPM->add(llvm::createReassociatePass());
+				session->TheFPM->add(llvm::createGVNPass());
+				session->TheFPM->add(llvm::createCFGSimplificationPass());
+				session->TheFPM->add(llvm::createLoopRotatePass()); // the loops that go over arrays
+				session->TheFPM->add(llvm::createLICMPass());
+				session->TheFPM->add(llvm::createIndVarSimplifyPass());
+				session->TheFPM->add(llvm::createLoopVectorizePass());
+				session->TheFPM->add(llvm::createInstructionCombiningPass());
+				session->TheFPM->add(llvm::createCFGSimplificationPass());
+				session->TheFPM->doInitialization();
+				session->tbaa = std::make_shared<alias_tags>(session->TheContext);
+			}
 
 			// Initialize library functions
 			init_lib();
+			if (session->opts.freestanding && (session->opts.profile_calls || session->opts.budget != 0 || !session->opts.profile_generate.empty()
+			                                   || session->opts.reentrant || session->opts.fork_server)) { // (their runtime needs libc)
+				session->diag << "--freestanding can't be used with -pg, --budget, -fprofile-generate, --reentrant or --fork-server" << std::endl;
+				throw compile_error(1);
+			}
+			if (session->opts.auto_memo && session->opts.reentrant) { // (the tables are shared by the threads)
+				session->diag << "-fauto-memo can't be used with --reentrant or --run-inputs" << std::endl;
+				throw compile_error(1);
+			}
+			if ((session->opts.profile_calls || !session->opts.profile_generate.empty() || session->opts.fork_server) && session->opts.reentrant) { // (their runtime is for one run of a process)
+				session->diag << "-pg, -fprofile-generate and --fork-server can't be used with --reentrant or --run-inputs" << std::endl;
+				throw compile_error(1);
+			}
+			if (session->opts.profile_calls) { // (see Func_def::count_calls, declared here so --stream prints them with the rest)
+				session->TheModule->getOrInsertFunction("__grc_pg_enter", llvm::Type::getVoidTy(session->TheContext), llvm::PointerType::get(session->i8, 0));
+				session->TheModule->getOrInsertFunction("__grc_pg_exit", llvm::Type::getVoidTy(session->TheContext));
+			}
+			if (session->opts.budget != 0) { // (see Func_def::meter, --stream prints the variable with the others at the end)
+				llvm::Function* const exhausted = llvm::cast<llvm::Function>(
+					session->TheModule->getOrInsertFunction("__grc_budget_exhausted", llvm::Type::getVoidTy(session->TheContext)).getCallee());
+				exhausted->addFnAttr(llvm::Attribute::Cold); // so the checks are laid out to fall through
+				exhausted->addFnAttr(llvm::Attribute::NoReturn);
+				session->TheModule->getOrInsertFunction("__grc_budget_init", llvm::Type::getVoidTy(session->TheContext), session->i64);
+			}
+			if (session->opts.fork_server) session->TheModule->getOrInsertFunction("__grc_fork_server", llvm::Type::getVoidTy(session->TheContext));
+			session->TheModule->getOrInsertFunction("__grc_writef", llvm::FunctionType::get( // (see Stmt_list::compile)
+				llvm::Type::getVoidTy(session->TheContext), {llvm::PointerType::get(session->i8, 0), session->i64}, true));
+		}
 
-			// Emit the program code.
-			compile();
+		static void end_module(bool fast, emit_kind emit) {
+			if (session->debug != nullptr) session->debug->finalize();
+			if (session->TheFPM != nullptr && session->stream == nullptr) specializer(*session->TheModule, *session->TheFPM).run();
+
+			if (!session->opts.profile_generate.empty()) profile_guide::generate(*session->TheModule, session->opts.profile_generate);
+			if (!session->opts.profile_use.empty())      profile_guide::use(*session->TheModule, session->opts.profile_use, session->TheFPM != nullptr);
 
 			// Verify the IR.
-			bool bad = verifyModule(*TheModule, &llvm::errs());
+			bool bad = verifyModule(*session->TheModule, &llvm::errs());
 			if (bad) {
-				std::cerr << "The IR is bad!" << std::endl;
-				TheModule->print(llvm::errs(), nullptr);
-				std::exit(1);
+				session->diag << "The IR is bad!" << std::endl;
+				session->TheModule->print(llvm::errs(), nullptr);
+				throw compile_error(1);
 			}
 
-			// Print out the IR.
-			TheModule->print(llvm::outs(), nullptr);
+			if (emit == EMIT_IR) // Print out the IR.
+				session->TheModule->print(session->out, nullptr);
+			// or generate the final code without going through llc/clang
+			else if (emit == EMIT_OBJ && session->opts.threads > 0 && defined_functions() > 1 && session->remarks == nullptr) // (the remarks are of TheContext)
+				emit_partitions(fast);
+			else
+				session->out << emit_object(*session->TheModule, emit);
+			if (session->remarks != nullptr) session->remarks->finish();
 		}
 
-	protected:
-		static llvm::LLVMContext TheContext;
-		static llvm::IRBuilder<> Builder;
-		static std::unique_ptr<llvm::Module> TheModule;
-		static std::unique_ptr<llvm::legacy::FunctionPassManager> TheFPM;
+		static llvm::SmallVector<char, 0> emit_object(llvm::Module &m, emit_kind emit=EMIT_OBJ) {
+			llvm::SmallVector<char, 0> buffer; // objects can't be written to a pipe directly
+			llvm::raw_svector_ostream os(buffer);
+			llvm::legacy::PassManager PM;
+			if (session->target->addPassesToEmitFile(PM, os, nullptr, emit == EMIT_OBJ ? llvm::CGFT_ObjectFile : llvm::CGFT_AssemblyFile)) {
+				session->diag << "The target machine can't emit this type of file" << std::endl;
+				throw compile_error(1);
+			}
+			PM.run(m);
+			return buffer;
+		}
+
+		static const unsigned max_partitions = 32;
+
+		/* -j: the backend runs on partitions of the module, each one in its own context, on its own target machine.
+		 * The module is split in the same partitions whatever the number of threads, so the object is always the same.
+		 * The partitions call each other so the internal functions (the nested a.b.c ones) and mains_stack_frame
+		 * become hidden globals, and they are made local again once the partitions are linked.
+		 */
+		static unsigned defined_functions() {
+			unsigned defined = 0;
+			for (const llvm::Function &f : *session->TheModule)
+				if (!f.isDeclaration()) ++defined;
+			return defined;
+		}
+		static void emit_partitions(const bool fast) {
+			const unsigned defined = defined_functions();
+			const unsigned partitions = defined < max_partitions ? defined : max_partitions;
+			std::vector<std::string> bitcode;
+			llvm::SplitModule(*session->TheModule, partitions, [&bitcode](std::unique_ptr<llvm::Module> part) {
+				bitcode.emplace_back();
+				llvm::raw_string_ostream os(bitcode.back());
+				llvm::WriteBitcodeToFile(*part, os);
+			});
+
+			const std::string triple = session->TheModule->getTargetTriple();
+			std::vector<std::string> objects(bitcode.size());
+			std::atomic<bool> unsupported(false); // (reported here, not on the threads)
+			work_stealing_pool::run(bitcode.size(), session->opts.threads, [&](const unsigned long long i) {
+				llvm::LLVMContext context; // contexts can't be shared between threads
+				std::unique_ptr<llvm::Module> part = llvm::cantFail(llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode[i], "partition"), context));
+				std::unique_ptr<llvm::TargetMachine> TM = create_target_machine(fast, triple);
+				llvm::SmallVector<char, 0> buffer;
+				llvm::raw_svector_ostream os(buffer);
+				llvm::legacy::PassManager PM;
+				if (TM->addPassesToEmitFile(PM, os, nullptr, llvm::CGFT_ObjectFile)) {
+					unsupported = true;
+					return;
+				}
+				PM.run(*part);
+				objects[i].assign(buffer.begin(), buffer.end());
+			});
+
+			if (unsupported) {
+				session->diag << "The target machine can't emit this type of file" << std::endl;
+				throw compile_error(1);
+			}
 
-		static llvm::Type *i8;
-		static llvm::Type *i64;
+			std::string object;
+			if (link_relocatable(objects, object, session->diag) != 0) throw compile_error(1);
+			session->out << object;
+		}
 
 		static llvm::ConstantInt* c8(char c) {
-			return llvm::ConstantInt::get(TheContext, llvm::APInt(8, c, true));
+			return llvm::ConstantInt::get(session->TheContext, llvm::APInt(8, c, true));
+		}
+		static llvm::ConstantInt* c64(long long n) {
+			return llvm::ConstantInt::get(session->TheContext, llvm::APInt(64, n, true));
+		}
+		/* -O: the loads and stores of the program's memory say what they access (see alias.hpp) */
+		template<class I> static I* data_access(I* const i, llvm::Type* const t) {
+			if(session->tbaa != nullptr) session->tbaa->data(i, t);
+			return i;
 		}
-		static llvm::ConstantInt* c64(int n) {
-			return llvm::ConstantInt::get(TheContext, llvm::APInt(64, n, true));
+		template<class I> static I* link_access(I* const i) {
+			if(session->tbaa != nullptr) session->tbaa->link(i);
+			return i;
+		}
+		static bool block_terminated() { // nothing can be emitted after a ret (everything that follows is dead)
+			return session->Builder.GetInsertBlock()->getTerminator() != nullptr;
+		}
+		static void branch_to(llvm::BasicBlock* const To) { // jump to To, dropping the current block if the jump would be all it contains
+			llvm::BasicBlock *Cur = session->Builder.GetInsertBlock();
+			if(Cur->empty() && Cur != &Cur->getParent()->getEntryBlock()) {
+				Cur->replaceAllUsesWith(To);
+				Cur->eraseFromParent();
+			}
+			else session->Builder.CreateBr(To);
 		}
 		
-		void init_lib() const {
-			ll_st.push_scope("#runtime_lib_scope");
+		static void init_lib() {
+			session->ll_st.push_scope("#runtime_lib_scope");
 			
+			llvm::Type *i8 = session->i8, *i64 = session->i64;
 			llvm::Type *str_ref = llvm::PointerType::get(i8, 0),
-			           *nothing = llvm::Type::getVoidTy(TheContext);
+			           *nothing = llvm::Type::getVoidTy(session->TheContext);
 
 			// Initialize library functions
 			// 1. IO
@@ -152,54 +355,54 @@ class AST {
 			);
 			llvm::Function *TheWriteInteger = llvm::Function::Create(
 				writeInteger_type, llvm::Function::ExternalLinkage,
-				"writeInteger", TheModule.get()
+				"writeInteger", session->TheModule.get()
 			);
-			ll_st.new_func("writeInteger", TheWriteInteger, true);
+			session->ll_st.new_func("writeInteger", TheWriteInteger, true);
 
 			llvm::FunctionType *writeChar_type = llvm::FunctionType::get(
 				nothing, {i8}, false
 			);
 			llvm::Function *TheWriteChar = llvm::Function::Create(
 				writeChar_type, llvm::Function::ExternalLinkage,
-				"writeChar", TheModule.get()
+				"writeChar", session->TheModule.get()
 			);
-			ll_st.new_func("writeChar", TheWriteChar, true);
+			session->ll_st.new_func("writeChar", TheWriteChar, true);
 
 			llvm::FunctionType *writeString_type = llvm::FunctionType::get(
 				nothing, {str_ref}, false
 			);
 			llvm::Function *TheWriteString = llvm::Function::Create(
 				writeString_type, llvm::Function::ExternalLinkage,
-				"writeString", TheModule.get()
+				"writeString", session->TheModule.get()
 			);
-			ll_st.new_func("writeString", TheWriteString, true);
+			session->ll_st.new_func("writeString", TheWriteString, true);
 
 			llvm::FunctionType *readInteger_type = llvm::FunctionType::get(
 				i64, {}, false
 			);
 			llvm::Function *TheReadInteger = llvm::Function::Create(
 				readInteger_type, llvm::Function::ExternalLinkage,
-				"readInteger", TheModule.get()
+				"readInteger", session->TheModule.get()
 			);
-			ll_st.new_func("readInteger", TheReadInteger, true);
+			session->ll_st.new_func("readInteger", TheReadInteger, true);
 
 			llvm::FunctionType *readChar_type = llvm::FunctionType::get(
 				i8, {}, false
 			);
 			llvm::Function *TheReadChar = llvm::Function::Create(
 				readChar_type, llvm::Function::ExternalLinkage,
-				"readChar", TheModule.get()
+				"readChar", session->TheModule.get()
 			);
-			ll_st.new_func("readChar", TheReadChar, true);
+			session->ll_st.new_func("readChar", TheReadChar, true);
 
 			llvm::FunctionType *readString_type = llvm::FunctionType::get(
 				nothing, {i64, str_ref}, false
 			);
 			llvm::Function *TheReadString = llvm::Function::Create(
 				readString_type, llvm::Function::ExternalLinkage,
-				"readString", TheModule.get()
+				"readString", session->TheModule.get()
 			);
-			ll_st.new_func("readString", TheReadString, true);
+			session->ll_st.new_func("readString", TheReadString, true);
 
 			// 2. Conversion Functions
 			llvm::FunctionType *ascii_type = llvm::FunctionType::get(
@@ -207,18 +410,18 @@ class AST {
 			);
 			llvm::Function *TheAscii = llvm::Function::Create(
 				ascii_type, llvm::Function::ExternalLinkage,
-				"ascii", TheModule.get()
+				"ascii", session->TheModule.get()
 			);
-			ll_st.new_func("ascii", TheAscii, true);
+			session->ll_st.new_func("ascii", TheAscii, true);
 
 			llvm::FunctionType *chr_type = llvm::FunctionType::get(
 				i8, {i64}, false
 			);
 			llvm::Function *TheChr = llvm::Function::Create(
 				chr_type, llvm::Function::ExternalLinkage,
-				"chr", TheModule.get()
+				"chr", session->TheModule.get()
 			);
-			ll_st.new_func("chr", TheChr, true);
+			session->ll_st.new_func("chr", TheChr, true);
 
 			// 3. String Management
 			llvm::FunctionType *strlen_type = llvm::FunctionType::get(
@@ -226,36 +429,43 @@ class AST {
 			);
 			llvm::Function *TheStrlen = llvm::Function::Create(
 				strlen_type, llvm::Function::ExternalLinkage,
-				"strlen", TheModule.get()
+				"strlen", session->TheModule.get()
 			);
-			ll_st.new_func("strlen", TheStrlen, true);
+			session->ll_st.new_func("strlen", TheStrlen, true);
 
 			llvm::FunctionType *strcmp_type = llvm::FunctionType::get(
 				i64, {str_ref, str_ref}, false
 			);
 			llvm::Function *TheStrcmp = llvm::Function::Create(
 				strcmp_type, llvm::Function::ExternalLinkage,
-				"strcmp", TheModule.get()
+				"strcmp", session->TheModule.get()
 			);
-			ll_st.new_func("strcmp", TheStrcmp, true);
+			session->ll_st.new_func("strcmp", TheStrcmp, true);
 
 			llvm::FunctionType *strcpy_type = llvm::FunctionType::get(
 				nothing, {str_ref, str_ref}, false
 			);
 			llvm::Function *TheStrcpy = llvm::Function::Create(
 				strcpy_type, llvm::Function::ExternalLinkage,
-				"strcpy", TheModule.get()
+				"strcpy", session->TheModule.get()
 			);
-			ll_st.new_func("strcpy", TheStrcpy, true);
+			session->ll_st.new_func("strcpy", TheStrcpy, true);
 
 			llvm::FunctionType *strcat_type = llvm::FunctionType::get(
 				nothing, {str_ref, str_ref}, false
 			);
 			llvm::Function *TheStrcat = llvm::Function::Create(
 				strcat_type, llvm::Function::ExternalLinkage,
-				"strcat", TheModule.get()
+				"strcat", session->TheModule.get()
 			);
-			ll_st.new_func("strcat", TheStrcat, true);
+			session->ll_st.new_func("strcat", TheStrcat, true);
+		}
+
+		/* the declaration of libgrc's __grc_budget in m (initial exec, the program is linked statically with libgrc) */
+		static llvm::GlobalVariable* budget_left(llvm::Module &m) {
+			llvm::GlobalVariable* const left = llvm::cast<llvm::GlobalVariable>(m.getOrInsertGlobal("__grc_budget", session->i64));
+			left->setThreadLocalMode(llvm::GlobalValue::InitialExecTLSModel);
+			return left;
 		}
 };
 
@@ -267,12 +477,9 @@ inline std::ostream &operator<<(std::ostream &out, const AST &ast) {
 /* Warning: Some Bad Code Ahead
  * (it was impossible to do some of the dirty work cleanly)
  * (particularly for semantic analysis)
- * Also due to semantic analysis it's possible there are memory leaks
- * because I was too lazy to write destructors for every class (so we
- * rely on the default destructors which should be fine). However if
- * someone were to write the destructors then there wouldn't be any
- * memory leaks. But it shouldn't matter in a program like this which
- * is guaranteed to terminate quickly.
+ * Every node owns its children and deletes them. The tree of a whole program
+ * is freed once it's compiled (--serve and --batch run many compilations),
+ * and --stream deletes the subtree of every function as soon as it's emitted.
  * Inheritance was a bad idea and is responsible for much of the bad code
  */
 
@@ -291,11 +498,16 @@ class Listable : public AST { // this was a really bad idea but it can't be chan
 		virtual bool is_func_def() const { return false; } // ok if somebody uses them
 		virtual llvm::Value* create_llvm_pointer_to(llvm::Type* &t) const { return nullptr; }; //should only be called by l_value
 		virtual void compile_vars(std::vector<std::string> &sfnames, std::vector<llvm::Type*> &sftypes) const {} // used in Var_def
+		virtual bool declare(const_eval &ev, const_frame &frame) const { return true; } // used in Var_def
+		virtual bool bind(const_frame &frame, std::vector<long long>::const_iterator &arg) const { return false; } // used in Fpar_def
+		virtual void lower(bytecode &bc) const {} // for --interp, used in Var_def, Fpar_def, Header and Func_def
+		virtual void insert_refs(std::vector<bool> &ref) const {} // used in Fpar_def
 }; // lol these funs are for specific types of listables but the way iterators work means we have to declare them here (all are for semantic analysis btw)
 
 class Item_list : public AST {
 	public:
 		Item_list(const char* name) : item_list(), list_name(name) {}
+		~Item_list() { for(const auto &item : item_list) delete item; }
 		void append(Listable* item) { item_list.push_back(item); }
 		void print(std::ostream &out) const override {
 			align.begin(out, list_name, true);
@@ -311,6 +523,11 @@ class Item_list : public AST {
 			out << *item_list.back();
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << '{';
+			for(const auto &item : item_list) item->fingerprint(out);
+			out << "} ";
+		}
 		
 		std::vector<Listable*> item_list;
 	private:
@@ -332,19 +549,77 @@ class Under_construction : public Listable {
 };
 */
 
+/* Calls with constant arguments are evaluated at compile time (see Func_call::fold): the Grace code runs here, in
+ * frames of its own, and the call is replaced by what it returned. The evaluation gives up (and leaves the call to
+ * run time) as soon as the code needs the program: runtime i/o, a ref parameter, a variable of the functions the
+ * call is in, a variable read before it's set, a division by zero, an index out of bounds or going over the limits.
+ * So the calls evaluated are the ones that have no side effects and depend on nothing but their arguments, whatever
+ * the function does on its other paths.
+ */
+struct const_var {
+	std::vector<unsigned long long> sizes; // of an array (none for a scalar)
+	std::vector<long long>          cells;
+	std::vector<bool>               set;   // the cells assigned so far
+};
+
+struct const_frame {
+	const Func_def                                *f;
+	const_frame                                   *parent; // of the function f is defined in (nullptr if it's outside the evaluation)
+	std::map<std::string, const_var, std::less<>> vars;    // the parameters and variables of f
+	long long                                     result;
+
+	const_var* lookup(const char* const name) { // the way sem found it
+		for(const_frame *fr = this; fr != nullptr; fr = fr->parent) {
+			auto v = fr->vars.find(name);
+			if(v != fr->vars.end()) return &v->second;
+		}
+		return nullptr;
+	}
+};
+
+class const_eval {
+	public:
+		enum outcome { NEXT, RETURNED, GIVE_UP }; // of a statement
+
+		void begin() { steps = cells = depth = 0; } // of the evaluation of a call
+		bool step() { return ++steps <= max_steps && ++total <= max_total; }
+		bool enter() { return ++depth <= max_depth && step(); }
+		void leave(const const_frame &frame) {
+			--depth;
+			for(const auto &v : frame.vars) cells -= v.second.cells.size();
+		}
+		bool allocate(unsigned long long n) {
+			if(n > max_cells - cells) return false;
+			cells += n;
+			return true;
+		}
+
+		std::map<std::pair<const Func_def*, std::vector<long long>>, std::pair<bool, long long>> done; // (whether it could, and the result)
+	private:
+		static constexpr unsigned long long max_steps = 1 << 20; // statements and calls of an evaluation
+		static constexpr unsigned long long max_total = 1 << 22; // of all of them, so the compilation stays fast
+		static constexpr unsigned long long max_cells = 1 << 20; // of the arrays in the frames
+		static constexpr unsigned           max_depth = 256;     // nested calls (each is a few frames of grc's own stack)
+
+		unsigned long long steps = 0, total = 0, cells = 0;
+		unsigned           depth = 0;
+};
+
 /* End of Utils, Actual Syntax Structures */
 
 class Id : public Listable {
 	public:
 		Id(const char* const id_name) : name(id_name) {}
+		~Id() { free((void*)name); }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Identifier", true);
 			out << " " << name << std::endl;
 			align.end(out, true);
 		}
+		void fingerprint(std::ostream &out) const override { out << name << ' '; }
 
 		const char* get_name() const override { return name; }
-		void set_main() { delete name; name = "main"; }
+		void set_main() { free((void*)name); name = strdup("main"); }
 	private:
 		const char* name;
 };
@@ -360,26 +635,28 @@ class Data_type : public AST {
 	public:
 		Data_type(const char* dtype) : data_type_name(dtype), cleanup(false) {}
 		Data_type(const Data_type &dt) : data_type_name(strdup(dt.data_type_name)), cleanup(true) {}
-		~Data_type() { if(cleanup) delete data_type_name; }
+		~Data_type() { if(cleanup) free((void*)data_type_name); }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Data Type");
 			align.no_line();
 			out << align << data_type_name << std::endl;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override { out << data_type_name << ' '; }
 
 		const char* get_dt_name() const { return data_type_name; }
 		bool operator==(const Data_type &dt) const {
 			return !strcmp(data_type_name, dt.get_dt_name());
 		}
 
+		bool is_char() const { return !strcmp(data_type_name, "char"); }
 		llvm::Type* get_ll_type() const {
-			if(!strcmp(data_type_name, "char")) return i8;
-			else                                return i64;
+			if(!strcmp(data_type_name, "char")) return session->i8;
+			else                                return session->i64;
 		}
 		void create_default_ret() const {
-			if(!strcmp(data_type_name, "char")) Builder.CreateRet(c8(0));
-			else                                Builder.CreateRet(c64(0));
+			if(!strcmp(data_type_name, "char")) session->Builder.CreateRet(c8(0));
+			else                                session->Builder.CreateRet(c64(0));
 		}
 	private:
 		const char* data_type_name;
@@ -398,11 +675,15 @@ class Array_tail_decl : public AST {
 			out << std::endl;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			for(const auto &n : sizes) out << '[' << n << ']';
+			out << ' ';
+		}
 
 		void sem() override {
 			for(const auto &n : sizes)
 				if(n == 0) {
-					std::cout << *this;
+					session->diag << *this;
 					yyerror("Semantic Error: array sizes cannot be 0");
 				}
 		}
@@ -425,7 +706,7 @@ class Type : public AST {
 	public:
 		Type(Data_type* dtype, Array_tail_decl* atdecl=nullptr) : dt(dtype), atd(atdecl) {}
 		Type(const Type &t) : dt(new Data_type(*(t.dt))), atd(t.atd == nullptr ? nullptr : new Array_tail_decl(*(t.atd))) {}
-		// may require destructor
+		~Type() { delete dt; delete atd; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Type");
 			if(atd == nullptr) {
@@ -439,6 +720,10 @@ class Type : public AST {
 			}
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			dt->fingerprint(out);
+			if(atd != nullptr) atd->fingerprint(out);
+		}
 
 		bool operator==(const Type &t) const {
 			/* Complex Logic Follows (maybe atd shouldn't have been allowed to be null but instead hold an empty vector) */
@@ -507,6 +792,7 @@ class Local_def : public Listable {
 class Var_def : public Local_def {
 	public:
 		Var_def(Id_list* idl, Type* t) : Identifier_list(idl), of_type(t) {}
+		~Var_def() { delete Identifier_list; delete of_type; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Variable Definition");
 			out << *Identifier_list
@@ -515,10 +801,18 @@ class Var_def : public Local_def {
 			out << *of_type;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << "(var ";
+			Identifier_list->fingerprint(out);
+			of_type->fingerprint(out);
+			out << ") ";
+		}
 
 		void sem() override {
-			for(const auto &id : Identifier_list->item_list)
-				st.new_symbol(id->get_name(), false, of_type);
+			for(const auto &id : Identifier_list->item_list) {
+				session->st.new_symbol(id->get_name(), false, of_type);
+				session->st.get_latest()->line = id->line;
+			}
 			// Here make sure n>0 in array def and NOT in the prev point
 			// check type
 			of_type->sem();
@@ -531,12 +825,34 @@ class Var_def : public Local_def {
 				sfnames.push_back(name);
 				sftypes.push_back(type);
 				/*
-				llvm::Value *v = Builder.CreateAlloca(t, nullptr, name);
-				ll_st.new_symbol(name, v, t);
+				llvm::Value *v = session->Builder.CreateAlloca(t, nullptr, name);
+				session->ll_st.new_symbol(name, v, t);
 				- no because we use a stack
 				*/
-				ll_st.new_symbol(name, nullptr, type);
+				session->ll_st.new_symbol(name, nullptr, type);
+			}
+		}
+		void lower(bytecode &bc) const override {
+			std::vector<unsigned long long> sizes;
+			if(of_type->atd != nullptr) sizes.assign(of_type->atd->sizes.begin(), of_type->atd->sizes.end());
+			for(const auto &id : Identifier_list->item_list) bc.variable(id->get_name(), of_type->dt->is_char(), false, sizes);
+		}
+		bool declare(const_eval &ev, const_frame &frame) const override {
+			for(const auto &id : Identifier_list->item_list) {
+				const_var v;
+				unsigned long long n = 1;
+				if(of_type->atd != nullptr)
+					for(const auto &size : of_type->atd->sizes) {
+						if(size > (1ull << 32) / n) return false; // (the limit is much lower)
+						n *= size;
+						v.sizes.push_back(size);
+					}
+				if(!ev.allocate(n)) return false;
+				v.cells.assign(n, 0);
+				v.set.assign(n, false);
+				frame.vars[id->get_name()] = std::move(v);
 			}
+			return true;
 		}
 		bool is_var_def() const override { return true; }
 	private:
@@ -570,6 +886,11 @@ class Fpar_type : public Type {
 			}
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			dt->fingerprint(out);
+			if(no_size_array) out << "[] ";
+			if(atd != nullptr) atd->fingerprint(out);
+		}
 
 		bool operator==(const Fpar_type &f) const {
 			return no_size_array == f.no_size_array && *dt == *(f.dt) && atd == f.atd;
@@ -612,7 +933,8 @@ class Fpar_type : public Type {
 
 class Fpar_def : public Listable {
 	public:
-		Fpar_def(bool is_ref, Id_list *idlist, Fpar_type *fpar_ty) : ref(is_ref), idl(idlist), fpt(fpar_ty) {}
+		Fpar_def(bool is_ref, Id_list *idlist, Fpar_type *fpar_ty) : ref(is_ref), idl(idlist), fpt(fpar_ty), t(nullptr) {}
+		~Fpar_def() { delete idl; delete fpt; delete t; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Formal Parameter Definition");	
 			if(ref) out << align << "BY REF" << std::endl;
@@ -622,56 +944,110 @@ class Fpar_def : public Listable {
 			out << *fpt;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << (ref ? "(ref " : "(");
+			idl->fingerprint(out);
+			fpt->fingerprint(out);
+			for(const char p : pass) out << (p == BY_REF ? "by-ref " : p == BY_VALUE ? "by-value " : "by-value-result "); // (see Func_def::promote_refs)
+			for(const bool u : unaliased) out << (u ? "noalias " : "may-alias ");
+			out << ") ";
+		}
 
 		void sem() override {
 			if(fpt->is_array() && !ref)
 				yyerror("Semantic Error: array types can only be passed by reference to functions");
-			for(const auto &id : idl->item_list) st.new_symbol(id->get_name(), false, fpt->to_type());
-			// because of this line and particuarly the call to_type() if the symbol table is destroyed before the end of the program there will be a memory leak
+			if(t == nullptr) t = fpt->to_type();
+			for(const auto &id : idl->item_list) {
+				session->st.new_symbol(id->get_name(), false, t);
+				session->st.get_latest()->line = id->line;
+			}
 			// It is necessary because the rest of the program needs the stentry to contain a type, not a formal type
+			// (the parameters share it and it lives as long as the header does)
 		}
 		
 		unsigned long long get_idlist_size() const override { return idl->item_list.size(); }
 		Fpar_type* get_fpt() const override { return fpt; }
 		
+		/* how each of its parameters is passed: -O passes some scalar refs by value (see Func_def::promote_refs) */
+		enum passing : char { BY_VALUE, BY_REF, BY_VALUE_RESULT };
+		passing passed(const size_t i) const { return !ref ? BY_VALUE : pass.empty() ? BY_REF : (passing)pass[i]; }
+		void pass_by(const size_t i, const passing p) {
+			pass.resize(get_idlist_size(), BY_REF);
+			pass[i] = p;
+		}
+		/* -O: an array ref nothing else reaches while the function runs is noalias (see Func_def::promote_refs) */
+		bool noalias(const size_t i) const { return i < unaliased.size() && unaliased[i]; }
+		void mark_noalias(const size_t i) {
+			unaliased.resize(get_idlist_size(), false);
+			unaliased[i] = true;
+		}
+		bool is_ref() const { return ref; }
+		bool is_scalar() const { return !fpt->is_array(); }
+		const char* name_of(const size_t i) const { return idl->item_list[i]->get_name(); }
+
 		void insert_ll_type_to(std::vector<llvm::Type*>& fpars) const override { // for header compile
 			// since fpt inherits from t, this is implemented by the Type class
 			// so it ignores the case it has an array of unknown size which will be handled here
-			llvm::Type *t = fpt->get_ll_type();
+			llvm::Type* const value = fpt->get_ll_type();
+			llvm::Type *t = value;
 			if(ref) t = t->getPointerTo(); // llvm::PointerType::get(t, 0) or t->getPointerTo();
 			if(fpt->has_unk_size_arr()) t = t->getPointerTo(); //llvm::PointerType::get(t, 0);
-			fpars.insert(fpars.end(), get_idlist_size(), t);
+			for(size_t i = 0; i < get_idlist_size(); ++i) fpars.push_back(passed(i) == BY_REF ? t : value);
+		}
+		void insert_result_types(std::vector<llvm::Type*> &results) const { // the values it returns (see Header::make_ll_fun)
+			for(size_t i = 0; i < get_idlist_size(); ++i)
+				if(passed(i) == BY_VALUE_RESULT) results.push_back(fpt->get_ll_type());
+		}
+		void insert_passing(std::vector<passing> &p) const {
+			for(size_t i = 0; i < get_idlist_size(); ++i) p.push_back(passed(i));
 		}
 		void make_args(llvm::Function::arg_iterator &arg, std::vector<std::string> &sfnames, std::vector<llvm::Type*> &sftypes) const { // for including the fpar in the scope/activation record
-			for(const auto &id : idl->item_list) {
-				const char* const name = id->get_name();
+			for(size_t i = 0; i < get_idlist_size(); ++i) {
+				const char* const name = name_of(i);
 				arg->setName(name);
 				llvm::Type *type = arg->getType();
-				// llvm::Value *v = Builder.CreateAlloca(type, nullptr, name); (- no because we use a stack)
+				// llvm::Value *v = session->Builder.CreateAlloca(type, nullptr, name); (- no because we use a stack)
 				llvm::Value *v = c64(42);
-				if(ref) {
+				if(passed(i) == BY_REF) {
 					llvm::Type *base_type = fpt->get_ll_type();
 					// if passed by ref and unk size then base type is array of unk size
 					if(fpt->has_unk_size_arr()) base_type = llvm::ArrayType::get(base_type, 1);
 					// LLVM big dumb here (this is to set the dereferenceable attribute to the arg)
 					arg->addAttr(llvm::Attribute::get(
-						TheContext, llvm::Attribute::Dereferenceable,
-						TheModule->getDataLayout().getTypeAllocSize(base_type)
+						session->TheContext, llvm::Attribute::Dereferenceable,
+						session->TheModule->getDataLayout().getTypeAllocSize(base_type)
 					));
-					ll_st.new_symbol(name, v, type, base_type);
+					if(noalias(i)) arg->addAttr(llvm::Attribute::NoAlias);
+					session->ll_st.new_symbol(name, v, type, base_type);
 				}
-				else ll_st.new_symbol(name, v, type);
+				else session->ll_st.new_symbol(name, v, type);
 				sfnames.push_back(name);
 				sftypes.push_back(type);
 
-				// Builder.CreateStore(arg, v); (- no because we use a stack)
+				// session->Builder.CreateStore(arg, v); (- no because we use a stack)
 				++arg;
 			}
 		}
+		void lower(bytecode &bc) const override {
+			std::vector<unsigned long long> sizes;
+			if(fpt->has_unk_size_arr()) sizes.push_back(0);
+			if(fpt->atd != nullptr) sizes.insert(sizes.end(), fpt->atd->sizes.begin(), fpt->atd->sizes.end());
+			for(const auto &id : idl->item_list) bc.variable(id->get_name(), fpt->dt->is_char(), ref, sizes);
+		}
+		void insert_refs(std::vector<bool> &refs) const override { refs.insert(refs.end(), idl->item_list.size(), ref); }
+		bool bind(const_frame &frame, std::vector<long long>::const_iterator &arg) const override { // for a call evaluated at compile time
+			if(ref) return false; // (it's a variable of the caller)
+			for(const auto &id : idl->item_list) frame.vars[id->get_name()] = const_var{{}, {*arg++}, {true}};
+			return true;
+		}
 	private:
 		bool      ref;
 		Id_list   *idl;
 		Fpar_type *fpt;
+		Type      *t; // what the parameters are in the symbol table
+
+		std::vector<char> pass; // how each one is passed (empty if as it's declared)
+		std::vector<bool> unaliased; // which are noalias
 };
 
 class Fpar_def_list : public Item_list {
@@ -684,6 +1060,7 @@ class Fpar_def_list : public Item_list {
 class Ret_type : public AST {
 	public:
 		Ret_type(Data_type* data_ty) : dt(data_ty), nothing(data_ty == nullptr) {}
+		~Ret_type() { delete dt; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Return Type");
 			align.no_line();
@@ -691,6 +1068,10 @@ class Ret_type : public AST {
 			else        out << *dt;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			if(nothing) out << "nothing ";
+			else        dt->fingerprint(out);
+		}
 
 		bool check_eq_with_t(Type* t) const {
 			if(nothing || t->atd != nullptr) return false;
@@ -705,11 +1086,11 @@ class Ret_type : public AST {
 		bool is_nothing() const { return nothing; }
 
 		llvm::Type* get_ll_type() const {
-			if(nothing) return llvm::Type::getVoidTy(TheContext);
+			if(nothing) return llvm::Type::getVoidTy(session->TheContext);
 			else        return dt->get_ll_type();
 		}
 		void create_default_ret() const {
-			if(nothing) Builder.CreateRetVoid();
+			if(nothing) session->Builder.CreateRetVoid();
 			else        dt->create_default_ret();
 		}
 	private:
@@ -720,6 +1101,7 @@ class Ret_type : public AST {
 class Header : public Func_decl {
 	public:
 		Header(Id* id, Fpar_def_list* parameters, Ret_type* return_type) : name(id), params(parameters), rtype(return_type) {}
+		~Header() { delete name; delete params; delete rtype; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Header");
 			out << *name;
@@ -729,12 +1111,19 @@ class Header : public Func_decl {
 			out << *rtype;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << (is_main ? "(main " : "(fun ");
+			name->fingerprint(out);
+			if(params != nullptr) params->fingerprint(out);
+			rtype->fingerprint(out);
+			out << ") ";
+		}
 
-		void sem() override { st.new_symbol(name->get_name(), true, nullptr, rtype, params, true); } // this is called by Func_decl so it is always a declaration
+		void sem() override { session->st.new_symbol(name->get_name(), true, nullptr, rtype, params, true); } // this is called by Func_decl so it is always a declaration
 		void semdef() { // this is only called by Func_def
-			st.new_symbol(name->get_name(), true, nullptr, rtype, params); // maybe convert rtype to str and params to condensed vector here?? How will this affect ret type checking in sem later??
-			st.set_next_scope_owner_latest_symbol();
-			st.push_scope(); // will be popped by caller
+			session->st.new_symbol(name->get_name(), true, nullptr, rtype, params); // maybe convert rtype to str and params to condensed vector here?? How will this affect ret type checking in sem later??
+			session->st.set_next_scope_owner_latest_symbol();
+			session->st.push_scope(); // will be popped by caller
 			// new symbols for all new parameters in new scope
 			if(params != nullptr)
 				for(const auto &fpd : params->item_list)
@@ -742,12 +1131,12 @@ class Header : public Func_decl {
 		}
 
 		llvm::Value* compile() const override { // for function declaration
-			const ll_ste* const prev_stack_frame = ll_st.lookup("#stack_frame");
+			const ll_ste* const prev_stack_frame = session->ll_st.lookup("#stack_frame");
 			llvm::Type* const frame_pointer_t = prev_stack_frame != nullptr ?
 				llvm::PointerType::get(prev_stack_frame->t, 0) : nullptr;
 			
 			llvm::Function* f = make_ll_fun(frame_pointer_t);
-			ll_st.new_func(get_name(), f);
+			session->ll_st.new_func(get_name(), f);
 			return f;
 		}
 
@@ -757,37 +1146,80 @@ class Header : public Func_decl {
 			if(params != nullptr)
 				for(const auto &fpd : params->item_list)
 					fpd->insert_ll_type_to(ll_fpars);
-			llvm::Type *rt = is_main ? i64 : rtype->get_ll_type();
+			llvm::Type *rt = is_main ? session->i64 : rtype->get_ll_type();
+			std::vector<llvm::Type*> results; // the parameters passed by value-result are returned after its result
+			if(params != nullptr)
+				for(const auto &fpd : params->item_list)
+					static_cast<const Fpar_def*>(fpd)->insert_result_types(results);
+			if(!results.empty()) {
+				if(!rt->isVoidTy()) results.insert(results.begin(), rt);
+				rt = llvm::StructType::get(session->TheContext, results);
+			}
 			llvm::FunctionType *f_type = llvm::FunctionType::get(rt, ll_fpars, false);
 			
-			std::string full_name = ll_st.get_scope_name(".");
+			std::string full_name = session->ll_st.get_scope_name(".");
 			if(full_name == "") full_name = name->get_name();
 			else                full_name += "." + std::string(name->get_name());
 			
 			llvm::GlobalValue::LinkageTypes linkage = is_main ? llvm::Function::ExternalLinkage
 			                                                  : llvm::Function::InternalLinkage;
-			return llvm::Function::Create(f_type, linkage, full_name, TheModule.get());
+			return llvm::Function::Create(f_type, linkage, full_name, session->TheModule.get());
 		}
 
 		void set_main() { name->set_main(); is_main = true; }
 		void create_default_ret() const {
-			if(is_main) Builder.CreateRet(c64(0));
+			if(is_main) session->Builder.CreateRet(c64(0));
 			else        rtype->create_default_ret();
 		}
 		void push_ll_formal_params(std::vector<std::string> &sfnames, std::vector<llvm::Type*> &sftypes) const {
-			llvm::Function *TheFunction = Builder.GetInsertBlock()->getParent();
+			llvm::Function *TheFunction = session->Builder.GetInsertBlock()->getParent();
 			llvm::Function::arg_iterator arg = TheFunction->arg_begin();
 			if (arg == TheFunction->arg_end()) return; // if no args no point in continuing
 			// set the dereferenceable attribute for the frame pointer (frame pointer should only be ommited in main which has no arguments)
 			arg->addAttr(llvm::Attribute::get(
-				TheContext, llvm::Attribute::Dereferenceable,
-				TheModule->getDataLayout().getTypeAllocSize(sftypes[0])
+				session->TheContext, llvm::Attribute::Dereferenceable,
+				session->TheModule->getDataLayout().getTypeAllocSize(sftypes[0])
 			));
 			++arg;
 			if(params != nullptr)
 				for(const auto &fpd : params->item_list)
 					fpd->make_args(arg, sfnames, sftypes);
 		}
+		void lower(bytecode &bc) const override { bc.declare_function(get_name(), refs(), !rtype->is_nothing()); } // (a declaration)
+		void begin_lower(bytecode &bc) const { // of the definition
+			bc.begin_function(get_name(), refs(), !rtype->is_nothing());
+			if(params != nullptr)
+				for(const auto &fpd : params->item_list)
+					fpd->lower(bc);
+		}
+		std::vector<bool> refs() const { // which parameters are by reference
+			std::vector<bool> r;
+			if(params != nullptr)
+				for(const auto &fpd : params->item_list)
+					fpd->insert_refs(r);
+			return r;
+		}
+		std::vector<Fpar_def::passing> passing() const {
+			std::vector<Fpar_def::passing> p;
+			if(params != nullptr)
+				for(const auto &fpd : params->item_list)
+					static_cast<const Fpar_def*>(fpd)->insert_passing(p);
+			return p;
+		}
+		std::vector<std::pair<Fpar_def*, size_t>> formals() const { // every parameter, by its definition and its place in it
+			std::vector<std::pair<Fpar_def*, size_t>> f;
+			if(params != nullptr)
+				for(const auto &fpd : params->item_list)
+					for(size_t i = 0; i < fpd->get_idlist_size(); ++i) f.emplace_back(static_cast<Fpar_def*>(fpd), i);
+			return f;
+		}
+		bool bind_args(const_frame &frame, const std::vector<long long> &args) const {
+			std::vector<long long>::const_iterator arg = args.begin();
+			if(params != nullptr)
+				for(const auto &fpd : params->item_list)
+					if(!fpd->bind(frame, arg)) return false;
+			return true;
+		}
 		const char* get_name() const      { return name->get_name(); }
 		bool is_func_def() const override { return true; }
 	private:
@@ -812,16 +1244,52 @@ class Local_def_list : public Item_list {
 				if(it->is_func_def())
 					it->compile();
 		}
+		void fold(const_eval &ev) override { for(const auto &it : item_list) it->fold(ev); }
+		void lower(bytecode &bc) const { // its variables, then the functions in it
+			for(const auto &it : item_list)
+				if(it->is_var_def()) it->lower(bc);
+			bc.end_variables();
+			for(const auto &it : item_list)
+				if(!it->is_var_def()) it->lower(bc);
+		}
+		bool declare(const_eval &ev, const_frame &frame) const {
+			for(const auto &it : item_list)
+				if(!it->declare(ev, frame)) return false;
+			return true;
+		}
 };
 
 class Stmt : public Listable {
 	public: // maybe print we are inside a stmt
 		virtual llvm::Value* compile() const override { return nullptr; }
+		virtual const_eval::outcome exec(const_eval &ev, const_frame &frame) const { return const_eval::GIVE_UP; } // at compile time
+		virtual void lower_stmt(bytecode &bc) const {} // for --interp
+		void lower_at(bytecode &bc) const { // with its line (for the runtime errors)
+			bc.at(line);
+			lower_stmt(bc);
+		}
+		virtual bool is_block() const { return false; }
+		virtual bool write(std::string &format, std::vector<const Expr*> &args) const { return false; } // (see Stmt_list::compile)
+		void compile_stmt() const { // with -g its code gets its line (and a nested block is a lexical block)
+			debug_info* const d = session->debug.get();
+			if(d == nullptr) {
+				compile();
+				return;
+			}
+			if(is_block()) d->begin_block(line, column);
+			d->at(line, column);
+			compile();
+			if(is_block()) d->end_block();
+		}
 };
 
 class Block : public Stmt {
 	public:
 		virtual void append(Stmt *s) = 0;
+		bool is_block() const override { return true; }
+		void locate_end(const int l, const int c) { end_line = l; end_column = c; } // of the closing brace
+
+		int end_line = 0, end_column = 0;
 		// maybe print we are inside a block
 };
 
@@ -830,18 +1298,75 @@ class Stmt_list : public Block {
 		Stmt_list() : s_list("Statement List") {}
 		void append(Stmt *s) override { s_list.append(s); }
 		void print(std::ostream &out) const override { s_list.print(out); }
+		void fingerprint(std::ostream &out) const override { s_list.fingerprint(out); }
 		void sem() override { for(auto const &s : s_list.item_list) s->sem(); }
+		void fold(const_eval &ev) override { for(auto const &s : s_list.item_list) s->fold(ev); }
+		void lower_stmt(bytecode &bc) const override {
+			for(auto const &s : s_list.item_list) {
+				const unsigned top = bc.temps();
+				static_cast<const Stmt*>(s)->lower_at(bc);
+				bc.release(top);
+			}
+		}
+		const_eval::outcome exec(const_eval &ev, const_frame &frame) const override {
+			for(auto const &s : s_list.item_list) {
+				if(!ev.step()) return const_eval::GIVE_UP;
+				const const_eval::outcome o = static_cast<const Stmt*>(s)->exec(ev, frame);
+				if(o != const_eval::NEXT) return o;
+			}
+			return const_eval::NEXT;
+		}
+		/* a run of writes (like writeString("x = "); writeInteger(x); writeChar('\n');) is one call of libgrc's
+		 * __grc_writef, with a format in which their constant pieces are already merged (see Func_call::write)
+		 */
 		llvm::Value* compile() const override {
-			for(auto const &s : s_list.item_list) s->compile();
+			const std::vector<Listable*> &l = s_list.item_list;
+			for(size_t i = 0; i < l.size();) {
+				if(block_terminated()) break; // unreachable statements after a return
+				std::string format;
+				std::vector<const Expr*> args;
+				size_t run = i;
+				while(run < l.size() && static_cast<const Stmt*>(l[run])->write(format, args)) ++run;
+				if(run - i < 2) {
+					static_cast<const Stmt*>(l[i++])->compile_stmt();
+					continue;
+				}
+				if(session->debug != nullptr) session->debug->at(l[i]->line, l[i]->column);
+				compile_writes(format, args);
+				i = run;
+			}
 			return nullptr;
 		}
 	private:
+		static void compile_writes(const std::string &format, const std::vector<const Expr*> &args);
+
 		Item_list s_list;
 };
 
+/* --stream: what the parser has open (the functions whose local definitions it's in) and where the finished functions went */
+class stream_state {
+	public:
+		struct open_function {
+			llvm::Function           *f;
+			llvm::Type               *frame_pointer_t;
+			std::vector<std::string> sfnames; // its parameters and variables so far (see Func_def::compile)
+			std::vector<llvm::Type*> sftypes;
+			llvm::Type               *frame;  // the part of its stack frame the functions nested in it see
+			size_t                   framed;  // how many of the sfnames are in that part
+		};
+		~stream_state() { for(const std::string &o : objects) unlink(o.c_str()); }
+
+		std::vector<open_function>    open;
+		std::unique_ptr<llvm::Module> chunk;          // finished functions that will be generated together (-c)
+		unsigned long long            chunk_size = 0; // in instructions
+		std::vector<std::string>      objects;        // the chunks generated so far (temporary files)
+		std::set<const llvm::Function*> intrinsics;   // declared in the IR printed so far
+};
+
 class Func_def : public Local_def {
 	public:
 		Func_def(Header *he, Local_def_list *ldli, Block *bl) : h(he), ldl(ldli), b(bl) {}
+		~Func_def() { delete h; delete ldl; delete b; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Function Definition");
 			out << *h << *ldl;
@@ -849,37 +1374,95 @@ class Func_def : public Local_def {
 			out << *b;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << "(def ";
+			h->fingerprint(out);
+			ldl->fingerprint(out);
+			b->fingerprint(out);
+			for(const auto &u : uses) out << u.first << ':' << u.second << ' '; // (the layout of its stack frame)
+			out << ") ";
+		}
 
 		void sem() override {
+			const stentry* const outer = session->st.get_scope_owner();
+			parent = outer != nullptr ? outer->def : nullptr;
+			declared = session->st.get_current_symbols().count(h->get_name()) != 0;
 			h->semdef(); // pushes a scope because we are in a function def
+			session->st.get_scope_owner()->def = this; // (its body may call it)
 			ldl->sem();
-			b->sem();
-			st.pop_scope();
+			sem_body();
 		}
 
+		/* after sem: the constant expressions and conditions, and the calls that can be evaluated (see const_eval) */
+		void fold_constants() {
+			const_eval ev;
+			fold(ev);
+		}
+		void fold(const_eval &ev) override {
+			ldl->fold(ev);
+			b->fold(ev);
+		}
+
+		/* --interp: the program is run by grc itself (see interp.hpp) */
+		void interpret() const {
+			bytecode bc;
+			lower(bc);
+			const int status = bc.run();
+			if(status != 0) throw compile_error(status);
+		}
+		void lower(bytecode &bc) const override {
+			h->begin_lower(bc);
+			ldl->lower(bc);
+			b->lower_stmt(bc);
+			bc.end_function();
+		}
+
+		/* a call of f evaluated at compile time, false if it had to give up (link is the frame of the function f is in) */
+		bool call(const_eval &ev, const_frame* const link, const std::vector<long long> &args, long long &result) const {
+			const_frame frame{this, link, {}, 0}; // (0 is what it returns if it ends without a return, see create_default_ret)
+			const bool done = ev.enter() && h->bind_args(frame, args) && ldl->declare(ev, frame) && b->exec(ev, frame) != const_eval::GIVE_UP;
+			ev.leave(frame);
+			result = frame.result;
+			return done;
+		}
+		const Func_def* get_parent() const { return parent; }
+		std::vector<Fpar_def::passing> passing() const { return h->passing(); }
+
 		llvm::Value* compile() const override {
-			const ll_ste* const prev_stack_frame = ll_st.lookup("#stack_frame");
+			const ll_ste* const prev_stack_frame = session->ll_st.lookup("#stack_frame");
 			llvm::Type* const frame_pointer_t = prev_stack_frame != nullptr ?
 				llvm::PointerType::get(prev_stack_frame->t, 0) : nullptr;
 			
 			llvm::Function* f;
-			const ll_ste *ste = ll_st.lookup(h->get_name(), ll_st.get_current_scope_no());
+			const ll_ste *ste = session->ll_st.lookup(h->get_name(), session->ll_st.get_current_scope_no());
 			if(ste != nullptr) f = ste->f; // f was already decleared
 			else               f = h->make_ll_fun(frame_pointer_t);
 
-			llvm::BasicBlock *Prev = Builder.GetInsertBlock();
-			llvm::BasicBlock *FunB = llvm::BasicBlock::Create(TheContext, "entry", f);
-
 			// register f so anyone in the scope can see it (including itself)
-			ll_st.new_func(h->get_name(), f);
+			session->ll_st.new_func(h->get_name(), f);
+
+			// reuse the optimized code of f (and its nested functions) from an earlier compilation if nothing it depends on changed
+			std::string key;
+			if(frame_pointer_t != nullptr && session->cache != nullptr && session->TheFPM != nullptr && session->debug == nullptr) { // (its lines may have moved)
+				key = session->cache->function_key(fingerprint(f), session->opts);
+				const std::string name = f->getName().str();
+				if(reuse(key)) {
+					session->ll_st.new_func(h->get_name(), session->TheModule->getFunction(name)); // the linker replaced the declaration of f
+					return nullptr;
+				}
+			}
+
+			llvm::BasicBlock *Prev = session->Builder.GetInsertBlock();
+			llvm::BasicBlock *FunB = llvm::BasicBlock::Create(session->TheContext, "entry", f);
 
 			// start generating code for f
-			Builder.SetInsertPoint(FunB);
-			ll_st.push_scope(h->get_name());
+			session->Builder.SetInsertPoint(FunB);
+			if(session->debug != nullptr) session->debug->begin_function(f, h->get_name(), h->line, h->column, b->line);
+			session->ll_st.push_scope(h->get_name());
 			std::vector<std::string> sfnames;
 			std::vector<llvm::Type*> sftypes;
 			sfnames.push_back("frame_pointer");
-			sftypes.push_back(frame_pointer_t == nullptr ? i64->getPointerTo() : frame_pointer_t);
+			sftypes.push_back(frame_pointer_t == nullptr ? session->i64->getPointerTo() : frame_pointer_t);
 			h->push_ll_formal_params(sfnames, sftypes);
 			ldl->compile_vars(sfnames, sftypes);
 
@@ -887,62 +1470,991 @@ class Func_def : public Local_def {
 
 			ldl->compile_funcs();
 			b->compile();
-			h->create_default_ret(); // just in case no return statement exists
-			ll_st.pop_scope();
-			Builder.SetInsertPoint(Prev);
+			end_body(f);
+			session->ll_st.pop_scope();
+			session->Builder.SetInsertPoint(Prev);
 			
 			// optimize (if selected in AST)
-			TheFPM->run(*f);
+			if(session->TheFPM != nullptr) session->TheFPM->run(*f);
+			if(!key.empty()) store(key, f);
 			return nullptr;
 		}
 
 		void set_main() const { h->set_main(); }
 		bool is_func_def() const override { return true; }
+
+		void end_body(llvm::Function* const f) const {
+			if(!block_terminated()) { // just in case no return statement exists
+				if(session->debug != nullptr) session->debug->at(b->end_line, b->end_column);
+				h->create_default_ret();
+			}
+			return_results(f);
+			if(session->remarks != nullptr) {
+				session->remarks->loops(*f);
+				report_promotions(f);
+			}
+			if(session->opts.budget != 0) meter(f); // (first, the counts are of the program's own code)
+			if(session->opts.profile_calls) count_calls(f);
+			if(session->opts.auto_memo && std::find(callees.begin(), callees.end(), this) != callees.end()) memoize(f);
+			if(session->opts.reentrant && f->getName() == "main") free_frame(f);
+			if(session->opts.fork_server && f->getName() == "main") { // before anything else (see libgrc/src/fork.c)
+				llvm::BasicBlock::iterator entry = f->getEntryBlock().begin();
+				while(llvm::isa<llvm::AllocaInst>(*entry)) ++entry;
+				llvm::IRBuilder<>(&*entry).CreateCall(session->TheModule->getOrInsertFunction("__grc_fork_server", llvm::Type::getVoidTy(session->TheContext)));
+			}
+			if(session->debug != nullptr) session->debug->end_function(f);
+		}
+
+		/* --reentrant: main frees the frame it allocated (see generate_stack_frame) when it returns */
+		static void free_frame(llvm::Function* const f) {
+			llvm::PointerType* const ptr = llvm::PointerType::get(session->i8, 0);
+			llvm::Value* const frame = session->ll_st.lookup("#stack_frame")->v;
+			llvm::FunctionCallee free = session->TheModule->getOrInsertFunction("free", llvm::Type::getVoidTy(session->TheContext), ptr);
+			for(llvm::BasicBlock &bb : *f)
+				if(llvm::isa<llvm::ReturnInst>(bb.getTerminator())) {
+					llvm::IRBuilder<> b(bb.getTerminator());
+					b.CreateCall(free, {b.CreateBitCast(frame, ptr)});
+				}
+		}
+
+		/* -fauto-memo: a function is pure (nullptr) if it does no i/o, uses no variable of the functions it's in (its
+		 * parameters are values or refs to what its caller has) and only calls pure functions, or the reason it isn't
+		 */
+		const char *pure(std::set<const Func_def*> &seen) const {
+			if(impure != nullptr) return impure;
+			seen.insert(this);
+			for(const Func_def* const g : callees) {
+				if(seen.count(g) != 0) continue; // (recursion)
+				if(!g->checked || g->pure(seen) != nullptr) return "it calls a function that isn't pure";
+			}
+			return nullptr;
+		}
+
+		/* -fauto-memo: a pure recursive function of up to four int or char values that returns an int or a char
+		 * looks its arguments up in a direct mapped table of the results it returned before (libgrc/src/memo.c)
+		 * after its frame is allocated, and puts what it returns in it. Every function that could be is reported.
+		 */
+		void memoize(llvm::Function* const f) const {
+			const auto formals = h->formals();
+			const unsigned n = formals.size();
+			bool values = n > 0 && n <= 4 && f->getReturnType()->isIntegerTy();
+			for(const auto &p : formals) values = values && !p.first->is_ref() && p.first->is_scalar(); // (a ref may be promoted to a value, see promote_refs)
+			std::set<const Func_def*> seen;
+			const char* const why = values ? pure(seen) : "it doesn't take up to four int or char values and return an int or a char";
+			session->diag << "-fauto-memo: " << f->getName().str();
+			if(why != nullptr) {
+				session->diag << " isn't memoized: " << why << std::endl;
+				return;
+			}
+			session->diag << " is memoized" << std::endl;
+
+			llvm::Type* const i64 = session->i64;
+			llvm::PointerType* const ptr = llvm::PointerType::get(session->i8, 0);
+			llvm::ArrayType* const table_t = llvm::ArrayType::get(session->i8, memo_table_size);
+			llvm::GlobalVariable* const table = new llvm::GlobalVariable(*session->TheModule, table_t, false, llvm::GlobalValue::PrivateLinkage,
+				llvm::ConstantAggregateZero::get(table_t), "memo." + f->getName()); // (unique, --stream prints them with f)
+			table->setAlignment(llvm::Align(64));
+			llvm::FunctionCallee get = session->TheModule->getOrInsertFunction("__grc_memo_get", i64, ptr, ptr, i64, ptr);
+			llvm::FunctionCallee put = session->TheModule->getOrInsertFunction("__grc_memo_put", llvm::Type::getVoidTy(session->TheContext), ptr, ptr, i64, i64);
+
+			llvm::BasicBlock* const entry = &f->getEntryBlock();
+			llvm::BasicBlock::iterator first = entry->begin();
+			while(llvm::isa<llvm::AllocaInst>(*first)) ++first;
+			llvm::BasicBlock* const body = entry->splitBasicBlock(first, "memo_miss");
+			std::vector<llvm::BasicBlock*> returns;
+			for(llvm::BasicBlock &bb : *f)
+				if(llvm::isa<llvm::ReturnInst>(bb.getTerminator())) returns.push_back(&bb);
+
+			entry->getTerminator()->eraseFromParent();
+			llvm::IRBuilder<> b(entry);
+			llvm::Value* const key   = b.CreateAlloca(llvm::ArrayType::get(i64, n), nullptr, "memo_key");
+			llvm::Value* const found = b.CreateAlloca(i64, nullptr, "memo_value");
+			for(unsigned i = 0; i < n; ++i)
+				b.CreateStore(b.CreateSExt(f->getArg(i + 1), i64), b.CreateConstInBoundsGEP2_64(llvm::ArrayType::get(i64, n), key, 0, i));
+			llvm::BasicBlock* const hit = llvm::BasicBlock::Create(session->TheContext, "memo_hit", f, body);
+			b.CreateCondBr(b.CreateICmpNE(b.CreateCall(get, {table, key, c64(n), found}), c64(0)), hit, body);
+			b.SetInsertPoint(hit);
+			b.CreateRet(b.CreateTrunc(b.CreateLoad(i64, found), f->getReturnType()));
+			for(llvm::BasicBlock* const bb : returns) {
+				llvm::ReturnInst* const ret = llvm::cast<llvm::ReturnInst>(bb->getTerminator());
+				b.SetInsertPoint(ret);
+				b.CreateCall(put, {table, key, c64(n), b.CreateSExt(ret->getReturnValue(), i64)});
+			}
+		}
+		static const unsigned long long memo_table_size = 48 << 14; // (sizeof(struct grc_memo) in libgrc/src/memo.c)
+
+		/* what a function may use (or write) while it runs, of every function's variables */
+		struct access {
+			std::set<var_id> vars;
+			bool all = false; // anything (it calls a function that's declared before it's defined)
+			bool insert(const var_id &v) { return !all && v.first != nullptr && vars.insert(v).second; }
+			bool merge(const access &a) {
+				bool changed = everything_if(a.all);
+				for(const var_id &v : a.vars) changed |= insert(v);
+				return changed;
+			}
+			bool everything_if(const bool any) {
+				if(!any || all) return false;
+				vars.clear();
+				return all = true;
+			}
+			bool has(const var_id &v) const { return all || vars.count(v) != 0; }
+		};
+
+		/* -O: a scalar ref parameter (ref int, ref char) is a pointer, so the variable the caller passes has to stay
+		 * in memory (it escapes, the caller's frame can't be split into registers) and the function loads it at every
+		 * use. If nothing else can reach the variable while the function runs, the parameter is passed by value when
+		 * the function never writes it, or by value-result when it does (its last value is returned along with the
+		 * result and the call stores it back). What every function may use and write while it runs (its own code and
+		 * that of the functions it calls, through their refs too) is found over the whole program, then every call is
+		 * checked: the variable it passes mustn't be another argument the function writes (or uses, for value-result)
+		 * or a variable of the functions it's in that it writes (or uses). A ref of the caller may be any variable.
+		 * A function declared before it's defined keeps its refs, and with --budget every function does (see meter).
+		 * Every scalar ref is a remark of "promote-refs".
+		 * An array ref stays a pointer, but it's noalias (llvm knows no other pointer reaches the array while the
+		 * function runs, so its loads and stores don't clobber anything else and loops over it vectorize without
+		 * checks) if at every call the arrays it may be are none of the ones the other refs (that are written, or
+		 * if it's written) or the variables outside the function it uses (or writes) may be. What a ref of the
+		 * caller may be is found over the calls too. Every array ref is a remark of "promote-refs" as well.
+		 */
+		void promote_refs() {
+			std::vector<Func_def*> defs;
+			subtree(defs);
+			std::map<const Func_def*, access> uses, writes; // (of all the variables, the function's own too)
+			for(Func_def* const f : defs) {
+				for(const var_id &v : f->used_vars)    uses[f].insert(v);
+				for(const var_id &v : f->written_vars) writes[f].insert(v);
+			}
+			for(bool changed = true; changed;) { // (the calls may be recursive)
+				changed = false;
+				for(Func_def* const f : defs)
+					for(const call_site &c : f->sites) {
+						if(c.callee == nullptr) {
+							changed |= uses[f].everything_if(true) | writes[f].everything_if(true);
+							continue;
+						}
+						changed |= uses[f].merge(c.callee->outside(uses[c.callee])) | writes[f].merge(c.callee->outside(writes[c.callee]));
+						const auto formals = c.callee->h->formals();
+						for(size_t i = 0; i < formals.size() && i < c.args.size(); ++i) {
+							if(!formals[i].first->is_ref()) continue;
+							changed |= uses[f].insert(c.args[i]);
+							if(writes[c.callee].has({c.callee, formals[i].first->name_of(formals[i].second)})) changed |= writes[f].insert(c.args[i]);
+						}
+					}
+			}
+
+			std::map<const Func_def*, std::vector<const call_site*>> calls;
+			for(Func_def* const f : defs)
+				for(const call_site &c : f->sites)
+					if(c.callee != nullptr) calls[c.callee].push_back(&c);
+			std::map<var_id, access> targets; // the variables every ref may be
+			for(Func_def* const f : defs)
+				for(const auto &p : f->h->formals())
+					if(p.first->is_ref() && f->declared) targets[{f, p.first->name_of(p.second)}].everything_if(true); // (its calls aren't known)
+			for(bool changed = true; changed;) {
+				changed = false;
+				for(Func_def* const f : defs)
+					for(const call_site* const c : calls[f]) {
+						const auto formals = f->h->formals();
+						for(size_t i = 0; i < formals.size() && i < c->args.size(); ++i)
+							if(formals[i].first->is_ref()) changed |= targets[{f, formals[i].first->name_of(formals[i].second)}].merge(pointed(c->args[i], targets));
+					}
+			}
+			for(Func_def* const f : defs) {
+				const auto formals = f->h->formals();
+				for(size_t i = 0; i < formals.size(); ++i) {
+					Fpar_def* const p = formals[i].first;
+					if(!p->is_ref() || !p->is_scalar()) continue;
+					const std::string name = p->name_of(formals[i].second);
+					const bool result = writes[f].has({f, name});
+					const std::string why = f->declared ? "it's declared before it's defined"
+					                                    : f->aliased(i, result, f->outside(result ? uses[f] : writes[f]), writes[f], calls[f]);
+					if(!why.empty()) {
+						f->promotions.emplace_back(false, name + " stays a ref: " + why);
+						continue;
+					}
+					p->pass_by(formals[i].second, result ? Fpar_def::BY_VALUE_RESULT : Fpar_def::BY_VALUE);
+					f->promotions.emplace_back(true, name + (result ? " is passed by value-result" : " is passed by value (it's only read)"));
+				}
+				for(size_t i = 0; i < formals.size(); ++i) { // (once the scalars that won't be pointers are known)
+					Fpar_def* const p = formals[i].first;
+					if(!p->is_ref() || p->is_scalar()) continue;
+					const std::string name = p->name_of(formals[i].second);
+					const bool written = writes[f].has({f, name});
+					const std::string why = f->declared ? "it's declared before it's defined"
+					                                    : f->shared(i, written, f->outside(written ? uses[f] : writes[f]), writes[f], calls[f], targets);
+					if(!why.empty()) {
+						f->promotions.emplace_back(false, name + " may alias: " + why);
+						continue;
+					}
+					p->mark_noalias(formals[i].second);
+					f->promotions.emplace_back(true, name + " is noalias");
+				}
+			}
+		}
+
+		/* -pg: f tells libgrc (libgrc/src/pg.c) when it's entered and when it returns. Its counters (the calls and
+		 * the time in it, with and without the functions it calls) are a static struct pg_function that ends with
+		 * its full nested name, so nothing has to collect them in the module.
+		 */
+		static void count_calls(llvm::Function* const f) {
+			llvm::PointerType* const ptr = llvm::PointerType::get(session->i8, 0);
+			llvm::Constant* const name = llvm::ConstantDataArray::getString(session->TheContext, session->ll_st.get_scope_name("."));
+			llvm::StructType* const counters_t = llvm::StructType::get(session->TheContext,
+				{session->i64, session->i64, session->i64, session->i64, ptr, ptr, session->i64, name->getType()});
+			llvm::Constant* const zero = llvm::ConstantInt::get(session->i64, 0);
+			llvm::Constant* const null = llvm::ConstantPointerNull::get(ptr);
+			llvm::GlobalVariable* const counters = new llvm::GlobalVariable(*session->TheModule, counters_t, false, llvm::GlobalValue::PrivateLinkage,
+				llvm::ConstantStruct::get(counters_t, {zero, zero, zero, zero, null, null, zero, name}), "pg." + f->getName()); // (unique, --stream prints them on their own)
+			llvm::IRBuilder<> b(&*f->getEntryBlock().getFirstInsertionPt());
+			b.CreateCall(session->TheModule->getOrInsertFunction("__grc_pg_enter", llvm::Type::getVoidTy(session->TheContext), ptr), {counters});
+			llvm::FunctionCallee exit = session->TheModule->getOrInsertFunction("__grc_pg_exit", llvm::Type::getVoidTy(session->TheContext));
+			for(llvm::BasicBlock &bb : *f)
+				if(llvm::isa<llvm::ReturnInst>(bb.getTerminator())) llvm::IRBuilder<>(bb.getTerminator()).CreateCall(exit);
+		}
+
+		/* --budget[=N]: f charges the code it runs to a budget so that the time limit of a program is a number of
+		 * instructions and not of seconds, and the same on any machine. Entering f costs the instructions of its
+		 * blocks outside of loops and every back edge of a while loop those of the blocks in the loop (but not in
+		 * the loops nested in it), counted before the code is optimized so -O doesn't change them (which is why -O
+		 * promotes no refs with it). What's left of the budget is a thread local of libgrc (libgrc/src/budget.c),
+		 * which stops the program when it runs out.
+		 */
+		static void meter(llvm::Function* const f) {
+			llvm::DominatorTree dt(*f);
+			llvm::LoopInfo loops(dt);
+			uint64_t entry_cost = 0;
+			std::map<llvm::Loop*, uint64_t> loop_cost;
+			for(llvm::BasicBlock &bb : *f) {
+				llvm::Loop* const l = loops.getLoopFor(&bb);
+				(l != nullptr ? loop_cost[l] : entry_cost) += bb.sizeWithoutDebug();
+			}
+			llvm::BasicBlock::iterator entry = f->getEntryBlock().begin(); // after the frame, its alloca must stay in the entry block
+			while(llvm::isa<llvm::AllocaInst>(*entry)) ++entry;
+			std::vector<std::pair<llvm::Instruction*, uint64_t>> charges = {{&*entry, entry_cost}};
+			for(llvm::Loop* const l : loops.getLoopsInPreorder()) { // (in the order of the code, not of the addresses)
+				llvm::SmallVector<llvm::BasicBlock*, 2> latches;
+				l->getLoopLatches(latches);
+				for(llvm::BasicBlock *bb : latches) charges.emplace_back(bb->getTerminator(), loop_cost[l]);
+			}
+
+			if(f->getName() == "main") { // before its own charge
+				llvm::IRBuilder<> b(&*entry);
+				b.CreateCall(session->TheModule->getOrInsertFunction("__grc_budget_init", llvm::Type::getVoidTy(session->TheContext), session->i64),
+					{llvm::ConstantInt::get(session->i64, session->opts.budget)});
+			}
+			llvm::GlobalVariable* const left = budget_left(*session->TheModule);
+			llvm::FunctionCallee exhausted = session->TheModule->getOrInsertFunction("__grc_budget_exhausted", llvm::Type::getVoidTy(session->TheContext));
+			for(const auto &c : charges) {
+				llvm::IRBuilder<> b(c.first);
+				llvm::LoadInst* const now = b.CreateLoad(session->i64, left);
+				llvm::Value* const n = b.CreateSub(now, llvm::ConstantInt::get(session->i64, c.second), "budget");
+				llvm::StoreInst* const store = b.CreateStore(n, left);
+				if(session->tbaa != nullptr) { session->tbaa->budget(now); session->tbaa->budget(store); } // (so the loops over refs vectorize)
+				llvm::Instruction* const out = llvm::SplitBlockAndInsertIfThen(b.CreateICmpSLT(n, llvm::ConstantInt::get(session->i64, 0)), c.first, true);
+				llvm::IRBuilder<>(out).CreateCall(exhausted);
+			}
+		}
+
+		/* --stream: instead of compiling the tree of the whole program at the end, the parser calls these as it goes
+		 * (after the header of a function, after each of its local definitions and at its end). A function is checked
+		 * and emitted as soon as it ends, and then its subtree and its code are freed (only its header stays, for the
+		 * calls to it), so grc needs memory for the functions it's in and not for the whole program.
+		 * The functions nested in a function are emitted before its stack frame is complete: they see the part of it
+		 * defined before them, which doesn't move because the frames of streamed functions are laid out in the order
+		 * of the definitions (see layout_stack_frame).
+		 */
+		static void stream_begin(Header* const h) {
+			if(session->stream == nullptr) {
+				if(session->opts.emit == EMIT_ASM) {
+					session->diag << "--stream emits IR or objects, not assembly" << std::endl;
+					throw compile_error(1);
+				}
+				if(session->opts.emit == EMIT_IR && (session->opts.debug != DEBUG_NONE || session->opts.remarks())) { // the metadata is printed at the end of a module
+					session->diag << "--stream with -g, -Rpass or -fsave-optimization-record emits objects, not IR" << std::endl;
+					throw compile_error(1);
+				}
+				if(!session->opts.profile_generate.empty() || !session->opts.profile_use.empty()) { // they need the whole module
+					session->diag << "--stream can't be used with -fprofile-generate or -fprofile-use" << std::endl;
+					throw compile_error(1);
+				}
+				if(session->opts.auto_memo) { // (a streamed function's calls of itself and of its siblings aren't known to be pure)
+					session->diag << "--stream can't be used with -fauto-memo" << std::endl;
+					throw compile_error(1);
+				}
+				session->stream = std::make_shared<stream_state>();
+				begin_module(session->opts.optimize, session->opts.fast, session->opts.emit);
+				if(session->opts.emit == EMIT_IR) session->TheModule->print(session->out, nullptr); // the runtime lib declarations
+			}
+			stream_state &s = *session->stream;
+			llvm::Type* const outer_frame     = s.open.empty() ? nullptr : stream_frame(s.open.back());
+			llvm::Type* const frame_pointer_t = s.open.empty() ? nullptr : llvm::PointerType::get(outer_frame, 0);
+
+			h->semdef();
+			if(s.open.empty()) h->set_main();
+			const ll_ste *ste = session->ll_st.lookup(h->get_name(), session->ll_st.get_current_scope_no());
+			llvm::Function* const f = ste != nullptr ? ste->f : h->make_ll_fun(frame_pointer_t);
+			session->ll_st.new_func(h->get_name(), f);
+
+			session->Builder.SetInsertPoint(llvm::BasicBlock::Create(session->TheContext, "entry", f));
+			if(session->debug != nullptr) session->debug->begin_function(f, h->get_name(), h->line, h->column, h->line);
+			session->ll_st.push_scope(h->get_name());
+			if(outer_frame != nullptr) // the static links are followed through it before its value exists
+				session->ll_st.new_symbol("#frame_pointer", nullptr, frame_pointer_t, outer_frame, 0);
+			stream_state::open_function o{f, frame_pointer_t, {"frame_pointer"}, {frame_pointer_t == nullptr ? session->i64->getPointerTo() : frame_pointer_t}, nullptr, 0};
+			h->push_ll_formal_params(o.sfnames, o.sftypes);
+			s.open.push_back(std::move(o));
+		}
+
+		static void stream_def(Local_def* const d) {
+			stream_state::open_function &o = session->stream->open.back();
+			if(d->is_var_def()) {
+				d->sem();
+				d->compile_vars(o.sfnames, o.sftypes);
+			}
+			else if(Header* const decl = dynamic_cast<Header*>(d)) {
+				decl->sem();
+				stream_frame(o);
+				decl->compile();
+			}
+			// a nested function definition has been emitted already
+		}
+
+		void stream_end() {
+			stream_state &s = *session->stream;
+			stream_state::open_function &o = s.open.back();
+			sem_body();
+			const_eval ev; // (only constants, the functions it calls are gone)
+			b->fold(ev);
+
+			llvm::Function* const f = o.f;
+			session->Builder.SetInsertPoint(&f->getEntryBlock());
+			if(session->debug != nullptr) session->debug->at(h->line, h->column);
+			const ll_ste* const prev_stack_frame = session->ll_st.lookup("#stack_frame", session->ll_st.get_current_scope_no() - 1); // f has one too if it has nested functions
+			generate_stack_frame(o.frame_pointer_t, f, prev_stack_frame, o.sfnames, o.sftypes);
+			b->compile();
+			end_body(f);
+			std::vector<llvm::Function*> nested;
+			for(const auto &e : session->ll_st.get_scope_vars(session->ll_st.get_current_scope_no()))
+				if(e.second->t == nullptr) nested.push_back(e.second->f);
+			session->ll_st.pop_scope();
+			session->Builder.ClearInsertionPoint();
+			if(session->TheFPM != nullptr) session->TheFPM->run(*f);
+			s.open.pop_back();
+
+			if(s.open.empty()) stream_main(f);
+			else               stream_function(f, h->get_name());
+			for(llvm::Function *n : nested) // nothing can call them anymore
+				if(n->use_empty()) n->eraseFromParent();
+			delete ldl;
+			delete b;
+			ldl = nullptr;
+			b   = nullptr;
+		}
 	private:
+		/* -O's ref promotion (see promote_refs) */
+		void subtree(std::vector<Func_def*> &defs) { // this function and the ones nested in it
+			defs.push_back(this);
+			for(const auto &d : ldl->item_list)
+				if(Func_def* const f = dynamic_cast<Func_def*>(d)) f->subtree(defs);
+		}
+		bool inside(const Func_def *g) const { // g is this function or one nested in it
+			for(; g != nullptr; g = g->parent)
+				if(g == this) return true;
+			return false;
+		}
+		access outside(const access &a) const { // the variables of a that aren't of this function or the ones nested in it
+			access o;
+			o.all = a.all;
+			for(const var_id &v : a.vars)
+				if(!inside(v.first)) o.vars.insert(v);
+			return o;
+		}
+		bool ref_param(const std::string &name) const {
+			for(const auto &p : h->formals())
+				if(p.first->is_ref() && name == p.first->name_of(p.second)) return true;
+			return false;
+		}
+		/* why the variable a call passes to the i-th parameter may be reached some other way while the function runs
+		 * (other is what it uses or writes of the variables outside of it), empty if it can't be
+		 */
+		std::string aliased(const size_t i, const bool result, const access &other, const access &writes, const std::vector<const call_site*> &calls) const {
+			if(other.all) return "it calls a function that's declared before it's defined";
+			const auto formals = h->formals();
+			for(const call_site* const c : calls) {
+				if(i >= c->args.size() || c->args[i].first == nullptr) continue;
+				const var_id &x = c->args[i];
+				const bool anything = x.first->ref_param(x.second); // (a ref of the caller)
+				const std::string where = " on line " + std::to_string(c->line);
+				for(const var_id &v : other.vars)
+					if(anything || v == x || v.first->ref_param(v.second))
+						return std::string(result ? "it uses " : "it writes ") + v.second + ", which may be what the call" + where + " passes";
+				for(size_t j = 0; j < formals.size() && j < c->args.size(); ++j) {
+					const var_id &y = c->args[j];
+					if(j == i || !formals[j].first->is_ref() || y.first == nullptr) continue;
+					const std::string other_name = formals[j].first->name_of(formals[j].second);
+					if(!result && !writes.has({this, other_name})) continue;
+					if(anything || y == x || y.first->ref_param(y.second))
+						return "the call" + where + " may pass the same variable to " + other_name;
+				}
+			}
+			return "";
+		}
+		/* the variables a variable passed by ref may be (none if it's not a variable) */
+		static access pointed(const var_id &x, std::map<var_id, access> &targets) {
+			if(x.first != nullptr && x.first->ref_param(x.second)) return targets[x];
+			access a;
+			a.insert(x);
+			return a;
+		}
+		static bool overlap(const access &a, const access &b) {
+			if(a.all) return b.all || !b.vars.empty();
+			for(const var_id &v : a.vars)
+				if(b.has(v)) return true;
+			return false;
+		}
+		/* why the array a call passes to the i-th parameter may be reached through another pointer while the function
+		 * runs (other is what it uses or writes of the variables outside of it), empty if it can't be
+		 */
+		std::string shared(const size_t i, const bool written, const access &other, const access &writes, const std::vector<const call_site*> &calls,
+		                   std::map<var_id, access> &targets) const {
+			if(other.all) return "it calls a function that's declared before it's defined";
+			const auto formals = h->formals();
+			for(const call_site* const c : calls) {
+				if(i >= c->args.size()) continue;
+				const access x = pointed(c->args[i], targets);
+				const std::string where = " on line " + std::to_string(c->line);
+				if(x.all) return "the call" + where + " passes a ref of a function that's declared before it's defined";
+				for(const var_id &v : other.vars)
+					if(overlap(x, pointed(v, targets)))
+						return std::string(written ? "it uses " : "it writes ") + v.second + ", which may be what the call" + where + " passes";
+				for(size_t j = 0; j < formals.size() && j < c->args.size(); ++j) {
+					if(j == i || formals[j].first->passed(formals[j].second) != Fpar_def::BY_REF) continue;
+					const std::string other_name = formals[j].first->name_of(formals[j].second);
+					if(!written && !writes.has({this, other_name})) continue;
+					if(overlap(x, pointed(c->args[j], targets)))
+						return "the call" + where + " may pass the same array to " + other_name;
+				}
+			}
+			return "";
+		}
+		void report_promotions(const llvm::Function* const f) const {
+			for(const auto &p : promotions)
+				if(p.first) {
+					llvm::OptimizationRemark r("promote-refs", "Promoted", f);
+					r << p.second;
+					f->getContext().diagnose(r);
+				}
+				else {
+					llvm::OptimizationRemarkMissed r("promote-refs", "NotPromoted", f);
+					r << p.second;
+					f->getContext().diagnose(r);
+				}
+		}
+		/* the parameters passed by value-result are returned after what f returns, from its stack frame */
+		void return_results(llvm::Function* const f) const {
+			llvm::StructType* const results = llvm::dyn_cast<llvm::StructType>(f->getReturnType());
+			if(results == nullptr) return;
+			std::vector<const char*> names;
+			for(const auto &p : h->formals())
+				if(p.first->passed(p.second) == Fpar_def::BY_VALUE_RESULT) names.push_back(p.first->name_of(p.second));
+			const unsigned first = results->getNumElements() - names.size(); // (1 if it returns something)
+			for(llvm::BasicBlock &bb : *f) {
+				llvm::ReturnInst* const ret = llvm::dyn_cast<llvm::ReturnInst>(bb.getTerminator());
+				if(ret == nullptr) continue;
+				llvm::IRBuilder<> b(ret);
+				llvm::Value *v = llvm::UndefValue::get(results);
+				if(first == 1) v = b.CreateInsertValue(v, ret->getReturnValue(), 0);
+				for(unsigned i = 0; i < names.size(); ++i) {
+					const ll_ste* const ste = session->ll_st.lookup(names[i]);
+					v = b.CreateInsertValue(v, data_access(b.CreateLoad(ste->t, ste->v, names[i]), ste->t), first + i);
+				}
+				b.CreateRet(v)->setDebugLoc(ret->getDebugLoc());
+				ret->eraseFromParent();
+			}
+		}
+
+		/* the part of the stack frame of o its nested functions see (everything defined in o so far) */
+		static llvm::Type* stream_frame(stream_state::open_function &o) {
+			if(o.frame != nullptr && o.framed == o.sfnames.size()) return o.frame;
+			std::vector<frame_field> fields = frame_fields(o.sfnames, o.sftypes);
+			std::vector<llvm::Type*> types(1, o.sftypes[0]);
+			bool cache_aligned = false;
+			layout_stack_frame(fields, types, cache_aligned, true);
+			for(const auto &ff : fields) {
+				const ll_ste *ste = session->ll_st.lookup(ff.name);
+				session->ll_st.new_symbol(ff.name, ste->v, ste->t, ste->base_type, ff.index);
+			}
+			o.frame  = llvm::StructType::get(session->TheContext, types);
+			o.framed = o.sfnames.size();
+			session->ll_st.new_symbol("#stack_frame", nullptr, o.frame); // its value only exists in the code of o
+			return o.frame;
+		}
+
+		static void stream_verify(llvm::Function* const f) {
+			if(llvm::verifyFunction(*f, &llvm::errs())) {
+				session->diag << "The IR is bad!" << std::endl;
+				f->print(llvm::errs());
+				throw compile_error(1);
+			}
+		}
+
+		/* IR is printed right away. Objects are generated a chunk of functions at a time: a function moves to the
+		 * chunk and leaves a declaration behind for the calls to it that haven't been emitted yet. The functions of
+		 * different chunks call each other so they are hidden, and made local again once the chunks are linked.
+		 */
+		static const unsigned long long chunk_instructions = 1 << 16;
+
+		static void stream_function(llvm::Function* const f, const char* const name) {
+			stream_verify(f);
+			llvm::SetVector<llvm::GlobalVariable*> counters; // of -pg (and the formats of the writes and -fauto-memo's table), they go with f
+			for(llvm::BasicBlock &bb : *f)
+				for(llvm::Instruction &i : bb)
+					for(llvm::Use &u : i.operands())
+						if(llvm::GlobalVariable *v = llvm::dyn_cast<llvm::GlobalVariable>(u.get()))
+							if(v->hasPrivateLinkage()) counters.insert(v); // (once, however many instructions use it)
+			if(session->opts.emit == EMIT_IR) {
+				session->out << '\n';
+				for(llvm::GlobalVariable *v : counters) session->out << *v << '\n';
+				stream_print(f);
+				f->deleteBody();
+				for(llvm::GlobalVariable *v : counters) v->eraseFromParent();
+				return;
+			}
+			stream_state &s = *session->stream;
+			if(s.chunk == nullptr) {
+				s.chunk = std::make_unique<llvm::Module>("grace program chunk", session->TheContext);
+				s.chunk->setTargetTriple(session->TheModule->getTargetTriple());
+				s.chunk->setDataLayout(session->TheModule->getDataLayout());
+				if(session->debug != nullptr) session->debug->add_to(*s.chunk);
+			}
+			const std::string fname = f->getName().str();
+			f->removeFromParent();
+			llvm::Function* const decl = llvm::Function::Create(f->getFunctionType(), llvm::Function::ExternalLinkage, fname, session->TheModule.get());
+			decl->setVisibility(llvm::GlobalValue::HiddenVisibility);
+			session->ll_st.new_func(name, decl);
+
+			f->setLinkage(llvm::Function::ExternalLinkage);
+			f->setVisibility(llvm::GlobalValue::HiddenVisibility);
+			llvm::Function* const called = s.chunk->getFunction(fname); // by a function that came to the chunk first
+			if(called != nullptr) called->setName("");
+			s.chunk->getFunctionList().push_back(f);
+			if(called != nullptr) {
+				called->replaceAllUsesWith(f);
+				called->eraseFromParent();
+			}
+			for(llvm::BasicBlock &bb : *f)
+				for(llvm::Instruction &i : bb) {
+					++s.chunk_size;
+					for(llvm::Use &u : i.operands()) { // calls are the only references to other functions (and --budget's the only shared variable)
+						if(llvm::Function *g = llvm::dyn_cast<llvm::Function>(u.get())) {
+							if(g->getParent() != s.chunk.get())
+								u.set(s.chunk->getOrInsertFunction(g->getName(), g->getFunctionType()).getCallee());
+						}
+						else if(llvm::GlobalVariable *v = llvm::dyn_cast<llvm::GlobalVariable>(u.get()))
+							if(v->getName() == "__grc_budget" && v->getParent() != s.chunk.get()) u.set(budget_left(*s.chunk));
+					}
+				}
+			for(llvm::GlobalVariable *v : counters) {
+				v->removeFromParent();
+				s.chunk->getGlobalList().push_back(v);
+			}
+			if(s.chunk_size >= chunk_instructions) {
+				stream_object(*s.chunk);
+				s.chunk      = nullptr;
+				s.chunk_size = 0;
+			}
+		}
+
+		/* A function of streamed IR is printed without the metadata of its instructions (-O's, the module's metadata is
+		 * printed at its end), after the declarations of the intrinsics it's the first to call (the passes add them,
+		 * like the reductions of vectorized loops).
+		 */
+		static void stream_print(llvm::Function* const f) {
+			for(llvm::BasicBlock &bb : *f)
+				for(llvm::Instruction &i : bb) {
+					i.dropUnknownNonDebugMetadata();
+					llvm::CallInst* const call = llvm::dyn_cast<llvm::CallInst>(&i);
+					llvm::Function* const g = call != nullptr ? call->getCalledFunction() : nullptr;
+					if(g == nullptr || !g->isIntrinsic() || !session->stream->intrinsics.insert(g).second) continue;
+					const llvm::AttributeList attributes = g->getAttributes(); // (they'd be attribute groups, llvm gives intrinsics theirs when it reads them)
+					g->setAttributes(llvm::AttributeList());
+					g->print(session->out);
+					g->setAttributes(attributes);
+				}
+			f->print(session->out);
+		}
+
+		static void stream_object(llvm::Module &m) {
+			const llvm::SmallVector<char, 0> object = emit_object(m);
+			const std::string path = write_temporary(std::string(object.begin(), object.end()), ".o");
+			if(path.empty()) {
+				session->diag << "can't create a temporary file" << std::endl;
+				throw compile_error(1);
+			}
+			session->stream->objects.push_back(path);
+		}
+
+		/* main is the last function, what's left of the module is main, its frame and the declarations it uses */
+		static void stream_main(llvm::Function* const f) {
+			stream_state &s = *session->stream;
+			if(session->debug != nullptr) session->debug->finalize();
+			stream_verify(f);
+			if(session->opts.emit == EMIT_IR) {
+				session->out << '\n';
+				stream_print(f);
+				session->out << '\n';
+				for(const llvm::GlobalVariable &g : session->TheModule->globals()) {
+					g.print(session->out);
+					session->out << '\n';
+				}
+				return;
+			}
+			if(s.chunk != nullptr) stream_object(*s.chunk);
+			s.chunk = nullptr;
+			stream_object(*session->TheModule);
+			if(session->remarks != nullptr) session->remarks->finish();
+			if(s.objects.size() == 1) {
+				copy_out(s.objects.back(), session->out);
+				s.objects.clear();
+				return;
+			}
+			const std::string linked = write_temporary("", ".o");
+			if(link_files("ld -r", s.objects, "&& objcopy --localize-hidden " + linked, linked, session->diag) != 0) throw compile_error(1);
+			copy_out(linked, session->out);
+		}
+
+		void sem_body() {
+			b->sem();
+			// the scope holds exactly what will be in the stack frame (and the nested functions)
+			for(const auto &s : session->st.get_current_symbols())
+				if(!s.second->is_fun) {
+					uses[s.first]  = s.second->uses;
+					lines[s.first] = s.second->line;
+				}
+			impure  = session->st.get_scope_owner()->impure;
+			callees = session->st.get_scope_owner()->calls;
+			used_vars    = std::move(session->st.get_scope_owner()->used);
+			written_vars = std::move(session->st.get_scope_owner()->written);
+			sites        = std::move(session->st.get_scope_owner()->sites);
+			checked = true;
+			session->st.pop_scope();
+		}
+
+		/* Everything the code of a function (and of the functions nested in it) depends on: its subtree,
+		 * and what it can see from the outside, which is the variables and functions of the enclosing
+		 * scopes, their llvm types and the layouts of the enclosing stack frames (and with -fauto-memo which of its
+		 * functions are pure).
+		 */
+		std::string fingerprint(const llvm::Function* const f) const {
+			std::string fp;
+			llvm::raw_string_ostream out(fp);
+			std::ostringstream tree;
+			fingerprint(tree);
+			out << f->getName() << ' ' << *f->getFunctionType() << '\n' << tree.str();
+			if(session->opts.auto_memo) print_purity(out);
+			for(unsigned long long scope = 1; scope <= session->ll_st.get_current_scope_no(); ++scope) {
+				out << "scope " << scope << '\n';
+				for(const auto &v : session->ll_st.get_scope_vars(scope)) {
+					const ll_ste &e = *v.second;
+					if(e.is_rtf) continue;
+					out << v.first << ' ';
+					if(e.t == nullptr) out << e.f->getName() << ' ' << *e.f->getFunctionType();
+					else {
+						out << e.frame_no << ' ' << *e.t;
+						if(e.base_type != nullptr) out << ' ' << *e.base_type;
+						if(llvm::StructType *sf = llvm::dyn_cast<llvm::StructType>(e.t)) // a stack frame
+							for(llvm::Type *t : sf->elements()) out << ' ' << *t;
+					}
+					out << '\n';
+				}
+			}
+			return out.str();
+		}
+
+		/* -fauto-memo: whether the functions of the subtree are memoized depends on the bodies of the functions
+		 * they call, outside of it too (see pure)
+		 */
+		void print_purity(llvm::raw_ostream &out) const {
+			std::set<const Func_def*> seen;
+			out << h->get_name() << (pure(seen) == nullptr ? " is pure\n" : " isn't pure\n");
+			if(ldl != nullptr) // (--stream freed it)
+				for(const auto &d : ldl->item_list)
+					if(const Func_def* const g = dynamic_cast<const Func_def*>(d)) g->print_purity(out);
+		}
+
+		/* The cached functions keep their (internal) names, so every internal function of the module
+		 * is made external while linking to resolve the calls between the old and the new code.
+		 */
+		static bool reuse(const std::string &key) {
+			std::string bitcode;
+			if(!session->cache->fetch(key, bitcode)) return false;
+			llvm::Expected<std::unique_ptr<llvm::Module>> cached = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, key), session->TheContext);
+			if(!cached) {
+				llvm::consumeError(cached.takeError());
+				return false;
+			}
+			std::vector<std::string> defined;
+			for(const llvm::Function &f : **cached)
+				if(!f.isDeclaration()) defined.push_back(f.getName().str());
+			std::vector<llvm::Function*> internal;
+			for(llvm::Function &f : *session->TheModule)
+				if(f.hasInternalLinkage()) {
+					internal.push_back(&f);
+					f.setLinkage(llvm::Function::ExternalLinkage);
+				}
+			if(session->linker == nullptr) session->linker = std::make_unique<llvm::Linker>(*session->TheModule);
+			const bool failed = session->linker->linkInModule(std::move(*cached), llvm::Linker::LinkOnlyNeeded);
+			for(llvm::Function *f : internal) f->setLinkage(llvm::Function::InternalLinkage);
+			for(const std::string &name : defined)
+				if(llvm::Function *f = session->TheModule->getFunction(name)) f->setLinkage(llvm::Function::InternalLinkage);
+			if(failed) {
+				session->diag << "Compiler Bug: can't link a cached function" << std::endl;
+				throw compile_error(1);
+			}
+			return true;
+		}
+
+		/* keeps f, the functions nested in it (their names start with the name of f) and their strings, with
+		 * declarations of everything else they use. Only the subtree is copied (not the module, that grows
+		 * with every function): its functions are the ones made after f, since f is made before its body.
+		 */
+		static void store(const std::string &key, const llvm::Function* const f) {
+			const std::string name = f->getName().str(), nested = name + '.';
+			std::vector<const llvm::Function*> subtree;
+			for(auto g = f->getIterator(); g != session->TheModule->end(); ++g)
+				if(!g->isDeclaration() && (g->getName() == name || g->getName().startswith(nested))) subtree.push_back(&*g);
+
+			std::vector<const llvm::GlobalValue*> used; // what the subtree (and the strings it keeps) refers to
+			std::set<const llvm::Value*> seen(subtree.begin(), subtree.end());
+			std::function<void(const llvm::Value*)> use = [&](const llvm::Value* const v) {
+				if(!llvm::isa<llvm::Constant>(v) || !seen.insert(v).second) return;
+				if(const llvm::GlobalValue* const g = llvm::dyn_cast<llvm::GlobalValue>(v)) used.push_back(g);
+				else for(const llvm::Value* const op : llvm::cast<llvm::Constant>(v)->operands()) use(op);
+			};
+			auto kept = [](const llvm::GlobalValue* const g) { return g->hasLocalLinkage() && g->getName() != "mains_stack_frame"; };
+			for(const llvm::Function* const g : subtree)
+				for(const llvm::BasicBlock &bb : *g)
+					for(const llvm::Instruction &i : bb)
+						for(const llvm::Value* const op : i.operands()) use(op);
+			for(size_t i = 0; i < used.size(); ++i)
+				if(const llvm::GlobalVariable* const g = llvm::dyn_cast<llvm::GlobalVariable>(used[i]))
+					if(kept(g) && g->hasInitializer()) use(g->getInitializer());
+
+			auto m = std::make_unique<llvm::Module>(session->TheModule->getName(), session->TheContext);
+			m->setTargetTriple(session->TheModule->getTargetTriple());
+			m->setDataLayout(session->TheModule->getDataLayout());
+			llvm::ValueToValueMapTy vmap;
+			auto declare = [&](const llvm::Function* const g) { // external, so they are linked with the functions of the module (functions declared before being defined are internal declarations until then)
+				llvm::Function* const d = llvm::Function::Create(g->getFunctionType(), llvm::Function::ExternalLinkage, g->getAddressSpace(), g->getName(), m.get());
+				d->copyAttributesFrom(g);
+				d->setLinkage(llvm::Function::ExternalLinkage);
+				vmap[g] = d;
+			};
+			for(const llvm::Function* const g : subtree) declare(g);
+			for(const llvm::GlobalValue* const g : used)
+				if(const llvm::Function* const fn = llvm::dyn_cast<llvm::Function>(g)) declare(fn);
+				else if(const llvm::GlobalVariable* const gv = llvm::dyn_cast<llvm::GlobalVariable>(g)) {
+					llvm::GlobalVariable* const d = new llvm::GlobalVariable(*m, gv->getValueType(), gv->isConstant(), llvm::GlobalValue::ExternalLinkage,
+						nullptr, gv->getName(), nullptr, gv->getThreadLocalMode(), gv->getAddressSpace());
+					if(kept(gv)) { // (a string, its initializer is copied below)
+						d->copyAttributesFrom(gv);
+						d->setLinkage(gv->getLinkage());
+					}
+					vmap[gv] = d;
+				}
+			for(const llvm::GlobalValue* const g : used)
+				if(const llvm::GlobalVariable* const gv = llvm::dyn_cast<llvm::GlobalVariable>(g))
+					if(kept(gv) && gv->hasInitializer()) llvm::cast<llvm::GlobalVariable>(vmap[gv])->setInitializer(llvm::MapValue(gv->getInitializer(), vmap));
+			for(const llvm::Function* const g : subtree) {
+				llvm::Function* const c = llvm::cast<llvm::Function>(vmap[g]);
+				for(size_t i = 0; i < g->arg_size(); ++i) vmap[g->getArg(i)] = c->getArg(i);
+				llvm::SmallVector<llvm::ReturnInst*, 4> returns;
+				llvm::CloneFunctionInto(c, g, vmap, llvm::CloneFunctionChangeType::DifferentModule, returns);
+				c->setLinkage(llvm::Function::ExternalLinkage);
+			}
+			if(llvm::NamedMDNode* const cus = m->getNamedMetadata("llvm.dbg.cu")) m->eraseNamedMetadata(cus); // (made empty by the cloning, there's no -g)
+
+			std::string bitcode;
+			llvm::raw_string_ostream out(bitcode);
+			llvm::WriteBitcodeToFile(*m, out);
+			session->cache->store(key, out.str());
+		}
+
 		struct stack_frame { llvm::Value *v; llvm::Type *t; };
+		struct frame_field {
+			std::string name;
+			llvm::Type  *t;
+			llvm::Value *arg; // nullptr if it's not a formal parameter
+			unsigned long long uses, size, align, index, offset;
+			int line; // where it was defined (for -g)
+		};
+		static const unsigned long long cache_line = 64;
+		static const unsigned long long cache_align_min_size = 4 * cache_line; // smaller arrays aren't worth the padding
+
+		static unsigned long long ll_align_of(llvm::Type *t) { // x86_64 alignment (the module has no data layout)
+			while(t->isArrayTy()) t = t->getArrayElementType();
+			if(t->isPointerTy()) return 8;
+			return t->getPrimitiveSizeInBits() / 8;
+		}
+
 		void generate_stack_frame(llvm::Type* const frame_pointer_t, llvm::Function* const f, const ll_ste* const prev_stack_frame,
 		const std::vector<std::string> &sfnames, const std::vector<llvm::Type*> &sftypes) const {
 			// sfnames, sftypes must contain the formal parameters in the same order as the function f passed
+			llvm::Function::arg_iterator arg = f->arg_begin();
+			std::vector<frame_field> fields = frame_fields(sfnames, sftypes);
+			for(auto &ff : fields) {
+				if(session->ll_st.lookup(ff.name)->v != nullptr) ff.arg = &*(++arg); // if it's a formal parameter (the value has been set to something to let us know)
+				auto u  = uses.find(ff.name);
+				ff.uses = u != uses.end() ? u->second : 0;
+				auto l  = lines.find(ff.name);
+				ff.line = l != lines.end() ? l->second : 0;
+			}
+			std::vector<llvm::Type*> types(1, sftypes[0]); // the frame pointer
+			bool cache_aligned = false;
+			const unsigned long long padding = layout_stack_frame(fields, types, cache_aligned, session->opts.stream);
+
+			// the frame pointer stays first so that static links can be followed without knowing the frame layout
+			// (streamed frames aren't named, there would be a type for every function of the program)
 			stack_frame sf;
-			sf.t = llvm::StructType::create(TheContext, sftypes, std::string(h->get_name()) + "_frame_t");
-			if(frame_pointer_t != nullptr) // if not main
-				sf.v = Builder.CreateAlloca(sf.t, nullptr, "stack_frame");
+			sf.t = session->opts.stream ? llvm::StructType::get(session->TheContext, types)
+			                            : llvm::StructType::create(session->TheContext, types, std::string(h->get_name()) + "_frame_t");
+			const llvm::Align frame_align(cache_aligned ? cache_line : 8);
+			if(frame_pointer_t != nullptr) { // if not main
+				llvm::AllocaInst *a = session->Builder.CreateAlloca(sf.t, nullptr, "stack_frame");
+				a->setAlignment(frame_align);
+				sf.v = a;
+			}
+			else if(session->opts.reentrant) { // every call of main gets a frame of its own, on the heap (see free_frame)
+				const uint64_t size = session->TheModule->getDataLayout().getTypeAllocSize(sf.t);
+				const uint64_t align = frame_align.value();
+				llvm::PointerType* const ptr = llvm::PointerType::get(session->i8, 0);
+				llvm::Value* const p = session->Builder.CreateCall(
+					session->TheModule->getOrInsertFunction("aligned_alloc", ptr, session->i64, session->i64),
+					{c64(align), c64((size + align - 1) / align * align)}, "mains_stack_frame");
+				session->Builder.CreateMemSet(p, llvm::ConstantInt::get(session->i8, 0), size, frame_align); // (like the global one)
+				sf.v = session->Builder.CreateBitCast(p, sf.t->getPointerTo());
+			}
 			else {
 				llvm::GlobalVariable *msf = new llvm::GlobalVariable(
-					*TheModule, sf.t, false, llvm::GlobalValue::PrivateLinkage,
+					*session->TheModule, sf.t, false, llvm::GlobalValue::PrivateLinkage,
 					llvm::ConstantAggregateZero::get(sf.t), "mains_stack_frame"
 				);
-				msf->setAlignment(llvm::MaybeAlign(8));
+				msf->setAlignment(llvm::MaybeAlign(frame_align));
 				sf.v = msf; // make mains stack frame global so it's on the heap and large arrays can be used
 				            // could also do this for all non recursive functions
 			}
 			
-			llvm::Function::arg_iterator arg = f->arg_begin();
+			arg = f->arg_begin();
 			
 			// set up frame pointer
 			if(frame_pointer_t != nullptr) { // this isn't executed for main who has no frame pointer as an arg
 				arg->setName("frame_pointer");
 				// store frame pointer in the first position of the stack frame
-				llvm::Value *v = Builder.CreateStructGEP(sf.t, sf.v, 0, "frame_pointer_sf_ptr");
-				Builder.CreateStore(arg, v);
-				ll_st.new_symbol("#frame_pointer", v, frame_pointer_t, prev_stack_frame->t, 0);
+				llvm::Value *v = session->Builder.CreateStructGEP(sf.t, sf.v, 0, "frame_pointer_sf_ptr");
+				link_access(session->Builder.CreateStore(arg, v));
+				session->ll_st.new_symbol("#frame_pointer", v, frame_pointer_t, prev_stack_frame->t, 0);
 			}
 
 			// store the rest of the variables
+			for(const auto &ff : fields) {
+				const ll_ste *ste = session->ll_st.lookup(ff.name);
+				llvm::Value *v = session->Builder.CreateStructGEP(sf.t, sf.v, ff.index, ff.name + "_sf_ptr");
+				if(ff.arg != nullptr) // we need to store the actual value to the stack frame
+					data_access(session->Builder.CreateStore(ff.arg, v), ff.arg->getType());
+				if(session->debug != nullptr)
+					session->debug->variable(ff.name, ste->t, ste->base_type, ff.line, ff.arg != nullptr ? llvm::cast<llvm::Argument>(ff.arg)->getArgNo() : 0, sf.v, ff.offset);
+				session->ll_st.new_symbol(ff.name, v, ste->t, ste->base_type, ff.index); // use the sf instead
+			}
+
+			session->ll_st.new_symbol("#stack_frame", sf.v, sf.t);
+
+			if(session->opts.frame_layout) print_frame_layout(fields, padding, frame_align.value());
+		}
+
+		static std::vector<frame_field> frame_fields(const std::vector<std::string> &sfnames, const std::vector<llvm::Type*> &sftypes) {
+			std::vector<frame_field> fields;
 			for(unsigned long long i = 1; i < sfnames.size(); ++i) {
-				const ll_ste *ste = ll_st.lookup(sfnames[i]);
-				llvm::Value *v = Builder.CreateStructGEP(sf.t, sf.v, i, sfnames[i] + "_sf_ptr");
-				if(ste->v != nullptr) // if it's a formal parameter (the value has been set to something to let us know)
-					Builder.CreateStore(++arg, v); // (we need to store the actual value to the stack frame)
-				ll_st.new_symbol(sfnames[i], v, ste->t, ste->base_type, i); // use the sf instead
+				frame_field ff;
+				ff.name  = sfnames[i];
+				ff.t     = sftypes[i];
+				ff.arg   = nullptr;
+				ff.uses  = 0;
+				ff.line  = 0;
+				ff.size  = session->TheModule->getDataLayout().getTypeAllocSize(ff.t);
+				ff.align = ll_align_of(ff.t);
+				ff.index = i;
+				fields.push_back(ff);
+			}
+			return fields;
+		}
+
+		/* Orders the fields of the stack frame (after the frame pointer) and returns the bytes lost to padding.
+		 * Scalars and pointers go first, by alignment and then by static use count, so the hot ones
+		 * share a cache line with the frame pointer. Arrays go last, smallest first, and the large
+		 * ones start on a new cache line so they span as few lines as possible.
+		 * With in_order (--stream) the fields stay in the order of their definitions, so a field has the same
+		 * offset in the frame of every prefix of them.
+		 * Sets the index and offset of every field and appends the llvm types of the frame to types.
+		 */
+		static unsigned long long layout_stack_frame(std::vector<frame_field> &fields, std::vector<llvm::Type*> &types, bool &cache_aligned, const bool in_order=false) {
+			if(!in_order) std::stable_sort(fields.begin(), fields.end(), [](const frame_field &a, const frame_field &b) {
+				const bool a_arr = a.t->isArrayTy(), b_arr = b.t->isArrayTy();
+				if(a_arr != b_arr)     return b_arr;
+				if(a.align != b.align) return a.align > b.align;
+				if(a_arr && a.size != b.size) return a.size < b.size;
+				return a.uses > b.uses;
+			});
+
+			unsigned long long offset = 8, padding = 0;
+			for(auto &ff : fields) {
+				unsigned long long align = ff.align;
+				if(ff.t->isArrayTy() && ff.size >= cache_align_min_size) {
+					align = cache_line;
+					cache_aligned = true;
+				}
+				const unsigned long long pad = (align - offset % align) % align;
+				if(pad > 0 && align == cache_line) { // llvm only pads up to the natural alignment so we pad explicitly
+					types.push_back(llvm::ArrayType::get(session->i8, pad));
+					offset += pad;
+				}
+				else offset += pad;
+				padding += pad;
+				ff.index  = types.size();
+				ff.offset = offset;
+				types.push_back(ff.t);
+				offset += ff.size;
 			}
+			padding += (8 - offset % 8) % 8; // tail padding
+			return padding;
+		}
 
-			ll_st.new_symbol("#stack_frame", sf.v, sf.t);
+		void print_frame_layout(const std::vector<frame_field> &fields, const unsigned long long padding, const unsigned long long align) const {
+			unsigned long long size = 8;
+			if(!fields.empty()) size = fields.back().offset + fields.back().size;
+			size += (8 - size % 8) % 8;
+			session->diag << "frame of " << session->ll_st.get_scope_name(".") << ": size " << size << " bytes, padding "
+			          << padding << " bytes, aligned to " << align << std::endl
+			          << "\toffset\tsize\tuses\tfield" << std::endl
+			          << "\t0\t8\t-\tframe_pointer" << std::endl;
+			for(const auto &ff : fields)
+				session->diag << '\t' << ff.offset << '\t' << ff.size << '\t' << ff.uses << '\t' << ff.name << std::endl;
 		}
 
 		Header         *h;
 		Local_def_list *ldl;
 		Block          *b;
+
+		std::map<std::string, unsigned long long> uses; // static use counts of the stack frame fields (set by sem)
+		std::map<std::string, int> lines;               // and the lines they were defined in
+		const Func_def *parent = nullptr;               // the function it's defined in (set by sem)
+		const char *impure = nullptr;                   // why it isn't pure by itself (set by sem, see pure)
+		std::vector<const Func_def*> callees;           // the functions it calls
+		bool checked = false;                           // (with --stream a function may be compiled before the ones it's in are)
+		bool declared = false;                          // before it's defined (set by sem)
+		std::set<var_id> used_vars, written_vars;       // by its own code (set by sem, see promote_refs)
+		std::vector<call_site> sites;                   // its calls
+		std::vector<std::pair<bool, std::string>> promotions; // what promote_refs did (true) or didn't do with its refs, for the remarks
 };
 
 /* Expressions & Conditions */
@@ -951,6 +2463,21 @@ class Expr : public Listable {
 	public: // maybe print we are inside an expression
 		virtual bool check_type(Type* t) = 0;
 		virtual bool check_comp_with_fpt(Fpar_type* fpt) const = 0;
+		virtual bool constant(long long &v) const { v = value; return folded; } // if fold found its value
+		virtual bool eval(const_eval &ev, const_frame &frame, long long &v) const { return false; } // at compile time
+		virtual int lower_expr(bytecode &bc) const = 0; // for --interp: the register with its value
+		virtual int lower_ptr(bytecode &bc) const { // a ref to a copy of the value
+			const int v = lower_expr(bc), t = bc.temp(), p = bc.temp();
+			bc.move(t, v);
+			bc.emit(BC_ADDR, p, 0, 0, t * 8LL);
+			return p;
+		}
+		virtual bool calls() const { return false; } // a function, that may change the variables
+	protected:
+		void constant_fingerprint(std::ostream &out) const { if(folded) out << '=' << value << ' '; } // (it's compiled to the constant)
+
+		bool      folded = false;
+		long long value  = 0;
 };
 
 class Int_const : public Expr {
@@ -961,6 +2488,7 @@ class Int_const : public Expr {
 			out << ' ' << val << std::endl;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override { out << val << ' '; }
 
 		bool check_type(Type* t) override {
 			return *t == Int_t;
@@ -971,6 +2499,9 @@ class Int_const : public Expr {
 		}
 
 		llvm::Value* compile() const override { return c64(val); }
+		bool constant(long long &v) const override { v = val; return true; }
+		bool eval(const_eval &ev, const_frame &frame, long long &v) const override { return constant(v); }
+		int lower_expr(bytecode &bc) const override { return bc.constant(val); }
 
 	private:
 		unsigned long long val;
@@ -979,11 +2510,13 @@ class Int_const : public Expr {
 class Char_const : public Expr { // char is treated as a string. maybe evaluate it?
 	public:
 		Char_const(const char* chr) : ch(chr) {}
+		~Char_const() { free((void*)ch); }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Character Constant", true);
 			out << ' ' << ch << std::endl;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override { out << ch << ' '; }
 
 		bool check_type(Type* t) override {
 			return *t == Char_t;
@@ -994,6 +2527,9 @@ class Char_const : public Expr { // char is treated as a string. maybe evaluate
 		}
 
 		llvm::Value* compile() const override { return c8(parse_char(ch)); }
+		bool constant(long long &v) const override { v = parse_char(ch); return true; }
+		bool eval(const_eval &ev, const_frame &frame, long long &v) const override { return constant(v); }
+		int lower_expr(bytecode &bc) const override { return bc.constant(parse_char(ch)); }
 
 		static char parse_char(const char* const ch) {
 			if(ch[1] == '\\') { // ch[0] is '
@@ -1026,6 +2562,7 @@ class Char_const : public Expr { // char is treated as a string. maybe evaluate
 class UnOp : public Expr {
 	public:
 		UnOp(char Operator, Expr* exp) : op(Operator), e(exp) {}
+		~UnOp() { delete e; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Unary Operation");
 			out << align << "Op(" << op << ')' << std::endl;
@@ -1033,6 +2570,12 @@ class UnOp : public Expr {
 			out << *e;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << '(' << op << ' ';
+			e->fingerprint(out);
+			constant_fingerprint(out);
+			out << ") ";
+		}
 
 		void sem() override {
 			if(!e->check_type(&Int_t))
@@ -1048,16 +2591,43 @@ class UnOp : public Expr {
 			return fpt->is_comp_with_t(&Int_t);
 		}
 
+		void fold(const_eval &ev) override {
+			e->fold(ev);
+			long long v;
+			folded = e->constant(v) && apply(v, value);
+		}
+		bool eval(const_eval &ev, const_frame &frame, long long &v) const override {
+			long long x;
+			return e->eval(ev, frame, x) && apply(x, v);
+		}
+
     llvm::Value* compile() const override {
+      long long c;
+      if (constant(c)) return c64(c);
       llvm::Value* v = e->compile();
       switch (op) {
         case '+': return v;
-        case '-': return Builder.CreateNeg(v, "negtmp"); // gpt
+        case '-': return session->Builder.CreateNeg(v, "negtmp"); // gpt
       }
       return nullptr;
     }
+		int lower_expr(bytecode &bc) const override {
+			long long c;
+			if(constant(c)) return bc.constant(c);
+			const int x = e->lower_expr(bc);
+			if(op == '+') return x;
+			const int t = bc.temp();
+			bc.emit(BC_NEG, t, x);
+			return t;
+		}
+		bool calls() const override { return e->calls(); }
 
 	private:
+		bool apply(long long x, long long &v) const {
+			v = op == '-' ? -(unsigned long long)x : x; // (wraps around like the code)
+			return true;
+		}
+
 		char op;
 		Expr *e;
 };
@@ -1071,6 +2641,7 @@ class UnOp : public Expr {
 class BinOp : public Expr {
 	public:
 		BinOp(Expr* left, char Operator, Expr* right) : l(left), op(Operator), r(right) {}
+		~BinOp() { delete l; delete r; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Binary Operation");
 			out << *l
@@ -1080,15 +2651,22 @@ class BinOp : public Expr {
 		    out << *r;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << '(' << op << ' ';
+			l->fingerprint(out);
+			r->fingerprint(out);
+			constant_fingerprint(out);
+			out << ") ";
+		}
 
 		void sem() override {
 			if(!l->check_type(&Int_t)) {
 				yyerror("Sematnic Error: left argument of binary operator must be of type int. op was ");
-				std::cout << op;
+				session->diag << op;
 			}
 			if(!r->check_type(&Int_t)) {
 				yyerror("Sematnic Error: right argument of binary operator must be of type int. op was ");
-				std::cout << op;
+				session->diag << op;
 			}
 		}
 
@@ -1101,19 +2679,72 @@ class BinOp : public Expr {
 			return fpt->is_comp_with_t(&Int_t);
 		}
     
+		void fold(const_eval &ev) override {
+			l->fold(ev);
+			r->fold(ev);
+			long long x, y;
+			folded = l->constant(x) && r->constant(y) && apply(x, y, value);
+		}
+		bool eval(const_eval &ev, const_frame &frame, long long &v) const override {
+			long long x, y;
+			return l->eval(ev, frame, x) && r->eval(ev, frame, y) && apply(x, y, v);
+		}
+
 		llvm::Value* compile() const override {
+			long long c;
+			if(constant(c)) return c64(c);
 			llvm::Value* lv = l->compile();
 			llvm::Value* rv = r->compile();
 			switch (op) {
-				case '+':    return Builder.CreateAdd(lv, rv, "addtmp");
-				case '-':    return Builder.CreateSub(lv, rv, "subtmp");
-				case '*':    return Builder.CreateMul(lv, rv, "multmp");
-				case DIV_OP: return Builder.CreateSDiv(lv, rv, "divtmp");
-				case MOD_OP: return Builder.CreateSRem(lv, rv, "modtmp");
+				case '+':    return session->Builder.CreateAdd(lv, rv, "addtmp");
+				case '-':    return session->Builder.CreateSub(lv, rv, "subtmp");
+				case '*':    return session->Builder.CreateMul(lv, rv, "multmp");
+				case DIV_OP: return session->Builder.CreateSDiv(lv, rv, "divtmp");
+				case MOD_OP: return session->Builder.CreateSRem(lv, rv, "modtmp");
 			}
 			return nullptr; // should not reach here
 		}
+		int lower_expr(bytecode &bc) const override {
+			long long c, k;
+			if(constant(c)) return bc.constant(c);
+			const int x = lower_left(bc, l, r), t = bc.temp();
+			if((op == '+' || op == '-') && r->constant(k)) {
+				bc.emit(BC_ADDI, t, x, 0, op == '+' ? k : -(unsigned long long)k);
+				return t;
+			}
+			const int y = r->lower_expr(bc);
+			switch (op) {
+				case '+':    bc.emit(BC_ADD, t, x, y); break;
+				case '-':    bc.emit(BC_SUB, t, x, y); break;
+				case '*':    bc.emit(BC_MUL, t, x, y); break;
+				case DIV_OP: bc.emit(BC_DIV, t, x, y, bc.line()); break;
+				case MOD_OP: bc.emit(BC_MOD, t, x, y, bc.line()); break;
+			}
+			return t;
+		}
+		bool calls() const override { return l->calls() || r->calls(); }
+		/* the register of the left operand, a copy of the variable if the right one calls a function (that may change it) */
+		static int lower_left(bytecode &bc, const Expr* const l, const Expr* const r) {
+			const int x = l->lower_expr(bc);
+			if(bc.is_temp(x) || !r->calls()) return x;
+			const int t = bc.temp();
+			bc.emit(BC_MOV, t, x);
+			return t;
+		}
 	private:
+		/* the way the code computes it, false if it traps (or its result is undefined) */
+		bool apply(long long x, long long y, long long &v) const {
+			const unsigned long long a = x, b = y; // (wraps around)
+			switch (op) {
+				case '+': v = a + b; return true;
+				case '-': v = a - b; return true;
+				case '*': v = a * b; return true;
+			}
+			if(y == 0 || (x == LLONG_MIN && y == -1)) return false;
+			v = op == DIV_OP ? x / y : x % y;
+			return true;
+		}
+
 		Expr *l;
 		char op;
 		Expr *r;
@@ -1126,19 +2757,36 @@ class Expr_list : public Item_list {
 		}
 
 		void sem() override { for(auto const &expr : item_list) expr->sem(); }
-		void compile_exprs(std::vector<llvm::Value*> &v) const {
-			for(auto const &expr : item_list) v.push_back(expr->compile());
-		}
 };
 
 class Cond : public AST {
 	public:
 		virtual llvm::Value* compile() const override { return nullptr; }
+		// jumping code: branches to TrueBB or FalseBB instead of computing an i1
+		virtual void compile_cond(llvm::BasicBlock* TrueBB, llvm::BasicBlock* FalseBB) const = 0;
+		bool constant(bool &v) const { v = value; return folded; } // if fold found its value
+		virtual bool eval(const_eval &ev, const_frame &frame, bool &v) const { return false; } // at compile time
+		virtual void lower_branch(bytecode &bc, bool when, int target) const = 0; // for --interp: jumps to target if it's when
+	protected:
+		bool lower_constant(bytecode &bc, bool when, int target) const {
+			if(!folded) return false;
+			if(value == when) bc.jump(BC_JMP, target);
+			return true;
+		}
+		bool compile_constant(llvm::BasicBlock* TrueBB, llvm::BasicBlock* FalseBB) const { // a jump, if it's known
+			if(!folded) return false;
+			session->Builder.CreateBr(value ? TrueBB : FalseBB);
+			return true;
+		}
+		void constant_fingerprint(std::ostream &out) const { if(folded) out << '=' << value << ' '; } // (it's compiled to the jump)
+
+		bool folded = false, value = false;
 };
 
 class NotCond : public Cond {
 	public:
 		NotCond(Cond* cond) : c(cond) {}
+		~NotCond() { delete c; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Not Condtion");
 			out << align << "OP(not)" << std::endl;
@@ -1146,9 +2794,28 @@ class NotCond : public Cond {
 			out << *c;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << "(not ";
+			c->fingerprint(out);
+			constant_fingerprint(out);
+			out << ") ";
+		}
 
 		void sem() override { c->sem();	}
-		llvm::Value* compile() const override {	return Builder.CreateNot(c->compile());	}
+		void fold(const_eval &ev) override {
+			c->fold(ev);
+			bool v;
+			if(c->constant(v)) folded = true, value = !v;
+		}
+		bool eval(const_eval &ev, const_frame &frame, bool &v) const override {
+			if(!c->eval(ev, frame, v)) return false;
+			v = !v;
+			return true;
+		}
+		void compile_cond(llvm::BasicBlock* TrueBB, llvm::BasicBlock* FalseBB) const override { c->compile_cond(FalseBB, TrueBB); }
+		void lower_branch(bytecode &bc, bool when, int target) const override {
+			if(!lower_constant(bc, when, target)) c->lower_branch(bc, !when, target);
+		}
 	private:
 		Cond *c;
 };
@@ -1156,6 +2823,7 @@ class NotCond : public Cond {
 class BinCond : public Cond {
 	public:
 		BinCond(Cond* left, char Operator, Cond* right) : l(left), op(Operator), r(right) {}
+		~BinCond() { delete l; delete r; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Binary Condition");
 			out << *l
@@ -1165,37 +2833,55 @@ class BinCond : public Cond {
 			out << *r;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << '(' << op << ' ';
+			l->fingerprint(out);
+			r->fingerprint(out);
+			constant_fingerprint(out);
+			out << ") ";
+		}
 
 		void sem() override {
 			l->sem();
 			r->sem();
 		}
-
-	llvm::Value* compile() const override { // short-circuiting
-		llvm::BasicBlock *Prev = Builder.GetInsertBlock();
-		llvm::Function *TheFunction = Prev->getParent();
-		llvm::BasicBlock *Full = llvm::BasicBlock::Create(TheContext, "full evaluation", TheFunction);
-		llvm::BasicBlock *End  = llvm::BasicBlock::Create(TheContext, "short-circuit end", TheFunction);
-
-		Builder.SetInsertPoint(End);
-		llvm::PHINode *phi_res = Builder.CreatePHI(llvm::IntegerType::get(TheContext, 1), 2, "result");
-
-		Builder.SetInsertPoint(Prev);
-		llvm::Value *lv = l->compile();
-		phi_res->addIncoming(lv, Builder.GetInsertBlock()); // current block may have changed due to l->compile
-		switch (op) {
-			case AND_OP: Builder.CreateCondBr(lv, Full, End); break;
-			case OR_OP:  Builder.CreateCondBr(lv, End, Full); break;
+		void fold(const_eval &ev) override {
+			l->fold(ev);
+			r->fold(ev);
+			bool x, y;
+			if(l->constant(x) && x == (op == OR_OP)) folded = true, value = x; // (whatever the right one is)
+			else if(l->constant(x) && r->constant(y)) folded = true, value = y;
+		}
+		bool eval(const_eval &ev, const_frame &frame, bool &v) const override {
+			if(!l->eval(ev, frame, v)) return false;
+			return v == (op == OR_OP) || r->eval(ev, frame, v);
 		}
 
-		Builder.SetInsertPoint(Full);
-		llvm::Value *rv = r->compile();
-		phi_res->addIncoming(rv, Builder.GetInsertBlock());
-		Builder.CreateBr(End);
-
-		Builder.SetInsertPoint(End);
-		return phi_res;
-	}
+		void compile_cond(llvm::BasicBlock* TrueBB, llvm::BasicBlock* FalseBB) const override { // short-circuiting
+			if(compile_constant(TrueBB, FalseBB)) return;
+			llvm::Function *TheFunction = session->Builder.GetInsertBlock()->getParent();
+			llvm::BasicBlock *Full = llvm::BasicBlock::Create(session->TheContext, op == AND_OP ? "and_rhs" : "or_rhs");
+			switch (op) {
+				case AND_OP: l->compile_cond(Full, FalseBB); break;
+				case OR_OP:  l->compile_cond(TrueBB, Full);  break;
+			}
+			Full->insertInto(TheFunction);
+			session->Builder.SetInsertPoint(Full);
+			r->compile_cond(TrueBB, FalseBB);
+		}
+		void lower_branch(bytecode &bc, bool when, int target) const override {
+			if(lower_constant(bc, when, target)) return;
+			const bool decides = op == OR_OP; // the value of l that decides it
+			if(when == decides) {
+				l->lower_branch(bc, when, target);
+				r->lower_branch(bc, when, target);
+				return;
+			}
+			const int skip = bc.label();
+			l->lower_branch(bc, decides, skip);
+			r->lower_branch(bc, when, target);
+			bc.bind(skip);
+		}
 	private:
 		Cond *l;
 		char op;
@@ -1205,6 +2891,7 @@ class BinCond : public Cond {
 class BinOpCond : public Cond {
 	public:
 		BinOpCond(Expr* left, char Operator, Expr* right) : l(left), op(Operator), r(right) {}
+		~BinOpCond() { delete l; delete r; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Binary Operational Condition");
 			out << *l
@@ -1214,12 +2901,19 @@ class BinOpCond : public Cond {
 		    out << *r;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << '(' << op << ' ';
+			l->fingerprint(out);
+			r->fingerprint(out);
+			constant_fingerprint(out);
+			out << ") ";
+		}
 
 		void sem() override {
 			bool valid = l->check_type(&Int_t) && r->check_type(&Int_t)
 			          || l->check_type(&Char_t) && r->check_type(&Char_t);
 			if(!valid) {
-				std::cout << *this;
+				session->diag << *this;
 				yyerror("Semantic Error: comparison between different types");
 			}
 		}
@@ -1227,17 +2921,61 @@ class BinOpCond : public Cond {
     llvm::Value* compile() const override {
       llvm::Value *lv = l->compile(), *rv = r->compile();
       switch (op) { // gpt
-        case '=':    return Builder.CreateICmpEQ(lv, rv, "eqtmp");
-        case '#':    return Builder.CreateICmpNE(lv, rv, "netmp");
-        case '>':    return Builder.CreateICmpSGT(lv, rv, "sgttmp");
-        case '<':    return Builder.CreateICmpSLT(lv, rv, "slttmp");
-        case LEQ_OP: return Builder.CreateICmpSLE(lv, rv, "sletmp");
-        case GEQ_OP: return Builder.CreateICmpSGE(lv, rv, "sgetmp");
+        case '=':    return session->Builder.CreateICmpEQ(lv, rv, "eqtmp");
+        case '#':    return session->Builder.CreateICmpNE(lv, rv, "netmp");
+        case '>':    return session->Builder.CreateICmpSGT(lv, rv, "sgttmp");
+        case '<':    return session->Builder.CreateICmpSLT(lv, rv, "slttmp");
+        case LEQ_OP: return session->Builder.CreateICmpSLE(lv, rv, "sletmp");
+        case GEQ_OP: return session->Builder.CreateICmpSGE(lv, rv, "sgetmp");
       }
       return nullptr;
     }
+		void compile_cond(llvm::BasicBlock* TrueBB, llvm::BasicBlock* FalseBB) const override {
+			if(compile_constant(TrueBB, FalseBB)) return;
+			session->Builder.CreateCondBr(compile(), TrueBB, FalseBB);
+		}
+
+		void fold(const_eval &ev) override {
+			l->fold(ev);
+			r->fold(ev);
+			long long x, y;
+			if(l->constant(x) && r->constant(y)) folded = true, value = compare(x, y);
+		}
+		void lower_branch(bytecode &bc, bool when, int target) const override {
+			if(lower_constant(bc, when, target)) return;
+			static const std::map<char, std::pair<bc_op, bc_op>> jumps = { // (with a register, with an immediate)
+				{'=', {BC_JEQ, BC_JEQI}}, {'#', {BC_JNE, BC_JNEI}}, {'<', {BC_JLT, BC_JLTI}},
+				{'>', {BC_JGT, BC_JGTI}}, {LEQ_OP, {BC_JLE, BC_JLEI}}, {GEQ_OP, {BC_JGE, BC_JGEI}},
+			};
+			static const std::map<char, char> negation = {
+				{'=', '#'}, {'#', '='}, {'<', GEQ_OP}, {'>', LEQ_OP}, {LEQ_OP, '>'}, {GEQ_OP, '<'},
+			};
+			const std::pair<bc_op, bc_op> &j = jumps.at(when ? op : negation.at(op));
+			const int x = BinOp::lower_left(bc, l, r);
+			long long k;
+			if(r->constant(k) && k == (int)k) bc.jump(j.second, target, x, k);
+			else                              bc.jump(j.first, target, x, r->lower_expr(bc));
+		}
+		bool eval(const_eval &ev, const_frame &frame, bool &v) const override {
+			long long x, y;
+			if(!l->eval(ev, frame, x) || !r->eval(ev, frame, y)) return false;
+			v = compare(x, y);
+			return true;
+		}
 
 	private:
+		bool compare(long long x, long long y) const { // (chars are signed too)
+			switch (op) {
+				case '=':    return x == y;
+				case '#':    return x != y;
+				case '>':    return x > y;
+				case '<':    return x < y;
+				case LEQ_OP: return x <= y;
+				case GEQ_OP: return x >= y;
+			}
+			return false;
+		}
+
 		Expr *l;
 		char op;
 		Expr *r;
@@ -1247,6 +2985,7 @@ class BinOpCond : public Cond {
 class L_value : public Expr {
 	public:
 		L_value(Id* identifier, const char* str_literal, L_value* l_value, Expr* expr) : id(identifier), str(str_literal), lv(l_value), e(expr) {}
+		~L_value() { delete id; free((void*)str); delete lv; delete e; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "L Value");
 			if(lv != nullptr)
@@ -1262,15 +3001,33 @@ class L_value : public Expr {
 				out << align << str << std::endl;;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << "(lvalue ";
+			if(lv != nullptr) lv->fingerprint(out);
+			if(e != nullptr)       e->fingerprint(out);
+			else if(id != nullptr) id->fingerprint(out);
+			else                   out << str << ' ';
+			constant_fingerprint(out);
+			out << ") ";
+		}
 
 		Type* get_type(bool &del_after) const {
 			if(id != nullptr) {
 				del_after = false;
-				stentry *ste = st.lookup(id->get_name());
+				stentry *ste = session->st.lookup(id->get_name());
 				if(ste->t == nullptr) {
-					std::cout << *id;
+					session->diag << *id;
 					yyerror("Sematnic error: this identifier belongs to a function not an lvalue (did you forget to put parenthesis?)");
 				}
+				if(!counted) { // get_type may be called more than once per use
+					++ste->uses;
+					counted = true;
+					var = {session->st.owner(id->get_name()), id->get_name()};
+					session->st.get_scope_owner()->used.insert(var);
+					const auto local = session->st.get_current_symbols().find(id->get_name());
+					if(local == session->st.get_current_symbols().end() || local->second != ste)
+						session->st.get_scope_owner()->impure = "it uses a variable of a function it's in";
+				}
 				return ste->t;
 			}
 			if(str != nullptr) { del_after = true; return new Str_type(strlen(str) - 1); } // to prevent memory leak // len of str is - 2 beacause of "" + 1 because of \0
@@ -1299,45 +3056,62 @@ class L_value : public Expr {
 			return res;
 		}
 
+		void fold(const_eval &ev) override {
+			if(lv != nullptr) lv->fold(ev);
+			if(e != nullptr)  e->fold(ev);
+		}
+		bool eval(const_eval &ev, const_frame &frame, long long &v) const override {
+			const_var *var;
+			unsigned long long i;
+			if(!locate(ev, frame, var, i) || !var->set[i]) return false;
+			v = var->cells[i];
+			return true;
+		}
+		/* the cell of a variable of the evaluation it is (false if it isn't one, or the index is out of bounds) */
+		bool locate(const_eval &ev, const_frame &frame, const_var* &var, unsigned long long &i) const {
+			unsigned long long dims;
+			return place(ev, frame, var, i, dims) && dims == var->sizes.size();
+		}
+
 		llvm::Value* compile() const override {
 			if(str != nullptr) {
 				std::string s = "";
 				parse_str(str, s);
-				return llvm::ConstantDataArray::getString(TheContext, s, true);
+				return llvm::ConstantDataArray::getString(session->TheContext, s, true);
 			}
 			llvm::Type  *t;
 			llvm::Value *v = this->create_llvm_pointer_to(t);
-			if(id != nullptr) return Builder.CreateLoad(t, v, id->get_name());
-			else              return Builder.CreateLoad(t, v, "array_elem_val");
+			if(id != nullptr) return data_access(session->Builder.CreateLoad(t, v, id->get_name()), t);
+			else              return data_access(session->Builder.CreateLoad(t, v, "array_elem_val"), t);
 		}
 		llvm::Value* create_llvm_pointer_to(llvm::Type* &t) const override {
 			if(id != nullptr) {
 				const char* const name = id->get_name();
-				const ll_ste* ste = ll_st.lookup(name);
+				const ll_ste* ste = session->ll_st.lookup(name);
 				if(ste == nullptr) {
-					std::cerr << name << std::endl;
+					session->diag << name << std::endl;
 					yyerror("Compiler bug: Use of unknown variable"); 
 				}
 
 				llvm::Value *v = ste->v;
-				unsigned long long scope = ll_st.get_current_scope_no();
+				unsigned long long scope = session->ll_st.get_current_scope_no();
 				if(scope > ste->scope_no) { // if non local
-					const ll_ste *fpe = ll_st.lookup("#frame_pointer", scope);
+					const ll_ste *fpe = session->ll_st.lookup("#frame_pointer", scope);
 					if(fpe == nullptr) yyerror("Compiler Bug: Couldn't find frame pointer");
 					llvm::Value *fpp = fpe->v, *fp;
 					while(--scope > ste->scope_no) {
-						fp  = Builder.CreateLoad(fpe->t, fpp, "prev_frame_ptr");
-						fpp = Builder.CreateStructGEP(fpe->base_type, fp, 0, "prev_frame_ptr_ptr");
-						fpe = ll_st.lookup("#frame_pointer", scope);
+						fp  = link_access(session->Builder.CreateLoad(fpe->t, fpp, "prev_frame_ptr"));
+						fpp = session->Builder.CreateStructGEP(fpe->base_type, fp, 0, "prev_frame_ptr_ptr");
+						fpe = session->ll_st.lookup("#frame_pointer", scope);
 					}
 
-					fp = Builder.CreateLoad(fpe->t, fpp, "frame_ptr");
-					v  = Builder.CreateStructGEP(fpe->base_type, fp, ste->frame_no, "non_local_v_ptr");
+					fp = link_access(session->Builder.CreateLoad(fpe->t, fpp, "frame_ptr"));
+					v  = session->Builder.CreateStructGEP(fpe->base_type, fp, ste->frame_no, "non_local_v_ptr");
 				}
 
 				if(ste->base_type != nullptr) { // if passed by reference
 					t = ste->base_type;
-					return Builder.CreateLoad(ste->t, v, "ref");
+					return data_access(session->Builder.CreateLoad(ste->t, v, "ref"), ste->t);
 				}
 
 				// else passed by value
@@ -1347,9 +3121,9 @@ class L_value : public Expr {
 			else if(str != nullptr) {
 				std::string s = "";
 				parse_str(str, s);
-				llvm::Value *p = Builder.CreateAlloca(i8, c64(s.length() + 1), "str_ptr");
-				llvm::Constant *v = llvm::ConstantDataArray::getString(TheContext, s, true);
-				Builder.CreateStore(v, p);
+				llvm::Value *p = session->Builder.CreateAlloca(session->i8, c64(s.length() + 1), "str_ptr");
+				llvm::Constant *v = llvm::ConstantDataArray::getString(session->TheContext, s, true);
+				session->Builder.CreateStore(v, p);
 				t = v->getType();
 				return p;
 			}
@@ -1357,14 +3131,58 @@ class L_value : public Expr {
 				llvm::Value *arr = lv->create_llvm_pointer_to(t), *ev = e->compile();
 				/*
 				if(t->isArrayTy()) t = t->getArrayElementType();
-				return Builder.CreateGEP(t, arr, { ev }, "arr_elem_ptr", true);
+				return session->Builder.CreateGEP(t, arr, { ev }, "arr_elem_ptr", true);
 				*/
 				// sometimes gives slightly better optimization in ir
-				llvm::Value *ptr = Builder.CreateGEP(t, arr, {c64(0), ev}, "arr_elem_ptr", true);
+				llvm::Value *ptr = session->Builder.CreateGEP(t, arr, {c64(0), ev}, "arr_elem_ptr", true);
 				t = t->getArrayElementType();
 				return ptr;
 			}
 		}
+
+		int lower_expr(bytecode &bc) const override {
+			if(id != nullptr) {
+				const bc_name* const v = bc.lookup(id->get_name());
+				if(v->level == bc.level() && !v->ref) { // a register of the frame
+					if(!v->is_char) return v->index;
+					const int t = bc.temp();
+					bc.emit(BC_SEXT8, t, v->index);
+					return t;
+				}
+			}
+			const bc_name *v;
+			unsigned dims;
+			const int p = place(bc, v, dims), t = bc.temp();
+			bc.emit(v->is_char ? BC_LD8 : BC_LD64, t, p);
+			return t;
+		}
+		int lower_ptr(bytecode &bc) const override {
+			const bc_name *v;
+			unsigned dims;
+			return place(bc, v, dims);
+		}
+		void lower_store(bytecode &bc, const int value) const {
+			if(id != nullptr) {
+				const bc_name* const v = bc.lookup(id->get_name());
+				if(v->level == bc.level() && !v->ref) { bc.move(v->index, value); return; }
+			}
+			const bc_name *v;
+			unsigned dims;
+			const int p = place(bc, v, dims);
+			bc.emit(v->is_char ? BC_ST8 : BC_ST64, p, value);
+		}
+		bool calls() const override { return e != nullptr && (lv->calls() || e->calls()); }
+		var_id variable() const { // the variable it is or is an element of (after sem)
+			if(id != nullptr) return var;
+			if(str != nullptr) return var_id();
+			return lv->variable();
+		}
+		bool literal(std::string &s) const { // a string literal, s is its value
+			if(str == nullptr) return false;
+			parse_str(str, s);
+			return true;
+		}
+
 		static void parse_str(const char* const str, std::string &s) {
 			unsigned long long i = 0;
 			while(str[++i] != '\0') { // str[0] is "
@@ -1390,10 +3208,54 @@ class L_value : public Expr {
 		}
 
 	private:
+		/* the register with a pointer to the variable, the element or the part of the array it is (in dims) */
+		int place(bytecode &bc, const bc_name* &v, unsigned &dims) const {
+			static const bc_name literal{false, 0, 0, true, false, {0}}; // (a string is an array of chars)
+			dims = 0;
+			if(str != nullptr) {
+				std::string s = "";
+				parse_str(str, s);
+				v = &literal;
+				return bc.string(s);
+			}
+			if(id != nullptr) {
+				v = bc.lookup(id->get_name());
+				const unsigned depth = bc.level() - v->level;
+				if(depth == 0 && v->ref) return v->index; // (the pointer it holds)
+				const int t = bc.temp();
+				if(depth == 0) bc.emit(BC_ADDR, t, 0, 0, v->index * 8LL);
+				else           bc.emit(BC_ADDRUP, t, depth, 0, v->index * 8LL);
+				if(depth > 0 && v->ref) bc.emit(BC_LD64, t, t);
+				return t;
+			}
+			const int p = lv->place(bc, v, dims), i = e->lower_expr(bc), t = bc.temp();
+			long long stride = v->is_char ? 1 : 8;
+			for(unsigned d = dims + 1; d < v->sizes.size(); ++d) stride *= v->sizes[d];
+			bc.emit(BC_INDEX, t, p, i, stride);
+			++dims;
+			return t;
+		}
+		bool place(const_eval &ev, const_frame &frame, const_var* &var, unsigned long long &i, unsigned long long &dims) const {
+			if(id != nullptr) {
+				var  = frame.lookup(id->get_name());
+				i    = 0;
+				dims = 0;
+				return var != nullptr;
+			}
+			long long x;
+			if(str != nullptr || !lv->place(ev, frame, var, i, dims) || !e->eval(ev, frame, x)) return false;
+			if(dims == var->sizes.size() || x < 0 || (unsigned long long)x >= var->sizes[dims]) return false;
+			i = i * var->sizes[dims++] + x;
+			return true;
+		}
+
 		Id         *id;
 		const char *str;
 		L_value    *lv;
 		Expr       *e;
+
+		mutable bool counted = false;
+		mutable var_id var;
 };
 
 /* Statements */
@@ -1405,11 +3267,14 @@ class Empty_stmt : public Stmt {
 			align.begin(out, "; (empty statement)");
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override { out << "; "; }
+		const_eval::outcome exec(const_eval &ev, const_frame &frame) const override { return const_eval::NEXT; }
 };
 
 class Assign : public Stmt {
 	public:
 		Assign(L_value* l_value, Expr* expr) : lv(l_value), e(expr) {}
+		~Assign() { delete lv; delete e; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Assign Statement");
 			out << *lv
@@ -1418,6 +3283,12 @@ class Assign : public Stmt {
 			out	<< *e;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << "(<- ";
+			lv->fingerprint(out);
+			e->fingerprint(out);
+			out << ") ";
+		}
 
 		void sem() override {
 			bool del_after;
@@ -1425,18 +3296,34 @@ class Assign : public Stmt {
 			if(t->atd != nullptr)
 				yyerror("Semantic Error: Assignement to and from array types is not allowed");
 			if(!e->check_type(t)) {
-				std::cout << *lv << *t << *e;
+				session->diag << *lv << *t << *e;
 				yyerror("Semantic Error: Trying to assign expression to lvalue of different type. lvalue is of type: ");
 			}
 			if(del_after) delete t;
+			session->st.get_scope_owner()->written.insert(lv->variable());
+		}
+
+		void fold(const_eval &ev) override {
+			lv->fold(ev);
+			e->fold(ev);
+		}
+		const_eval::outcome exec(const_eval &ev, const_frame &frame) const override {
+			long long x;
+			const_var *v;
+			unsigned long long i;
+			if(!e->eval(ev, frame, x) || !lv->locate(ev, frame, v, i)) return const_eval::GIVE_UP; // (in the order of the code)
+			v->cells[i] = x;
+			v->set[i]   = true;
+			return const_eval::NEXT;
 		}
 
 		llvm::Value* compile() const override {
 			llvm::Type  *t;
 			llvm::Value *ev = e->compile(), *v = lv->create_llvm_pointer_to(t);
-			Builder.CreateStore(ev, v);
+			data_access(session->Builder.CreateStore(ev, v), ev->getType());
 			return nullptr;
 		}
+		void lower_stmt(bytecode &bc) const override { lv->lower_store(bc, e->lower_expr(bc)); }
 	private:
 		L_value *lv;
 		Expr    *e;
@@ -1445,6 +3332,8 @@ class Assign : public Stmt {
 class Func_call : public Stmt, public Expr {
 	public:
 		Func_call(Id* identifier, Expr_list* exp_list) : id(identifier), e_list(exp_list) {}
+		void locate(const int l, const int c) { Stmt::locate(l, c); Expr::locate(l, c); } // it's both
+		~Func_call() { delete id; delete e_list; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Function Call");
 			if(e_list == nullptr) align.no_line(); // factor ifs better?
@@ -1456,18 +3345,34 @@ class Func_call : public Stmt, public Expr {
 			}
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << "(call ";
+			id->fingerprint(out);
+			if(e_list != nullptr) e_list->fingerprint(out);
+			if(evaluated) out << "evaluated "; // (so the fingerprint of the caller changes with the callee)
+			constant_fingerprint(out);
+			out << ") ";
+		}
 
 		void sem() override {
-			stentry *e = st.lookup(id->get_name());
+			stentry *e = session->st.lookup(id->get_name());
+			callee  = e->def;
+			runtime = e->def == nullptr && session->st.is_runtime_lib(id->get_name(), e);
+			nothing = e->rt != nullptr && e->rt->is_nothing();
+			stentry* const caller = session->st.get_scope_owner(); // (for -fauto-memo, see Func_def::pure)
+			if(runtime && (!strncmp(id->get_name(), "read", 4) || !strncmp(id->get_name(), "write", 5))) caller->impure = "it does i/o";
+			else if(!runtime && callee == nullptr) caller->impure = "it calls a function before it's defined";
+			else if(!runtime && std::find(caller->calls.begin(), caller->calls.end(), callee) == caller->calls.end()) caller->calls.push_back(callee);
 			if(e->rt == nullptr) {
-				std::cout << *id;
+				session->diag << *id;
 				yyerror("Semantic error: this identifier belongs to an lvalue not a function (did you accidentally put parenthesis?)");
 			}
 			if(e_list == nullptr) {
 				if(!e->fpars->empty()) {
 					yyerror("Semantic Error: formal parameter missmatch in function call. No paramters given when function expects formal parameters");
-					std::cout << id->get_name() << std::endl;
+					session->diag << id->get_name() << std::endl;
 				}
+				if(!runtime) caller->sites.push_back({callee, {}, Stmt::line});
 
 				return;
 			}
@@ -1478,67 +3383,253 @@ class Func_call : public Stmt, public Expr {
 					if(it == e_list->item_list.end())
 						yyerror("Semantic Error: formal parameter missmatch in function call. Less parameters supplied");
 					if(!(*it)->check_comp_with_fpt(fp.fpt)) {
-						std::cout << *(fp.fpt) << **it;
+						session->diag << *(fp.fpt) << **it;
 						yyerror("Semantic Error: formal parameter type missmatch in function call. Formal parameter is ");
 					}
 					++it;
 				}
 			if(it != e_list->item_list.end())
 				yyerror("Semantic Error: formal parameter missmatch in function call. More parameters given than accepted by function");
+			call_site site{callee, {}, Stmt::line};
+			for(auto const &a : e_list->item_list) {
+				const L_value* const l = dynamic_cast<const L_value*>(a);
+				site.args.push_back(l != nullptr ? l->variable() : var_id());
+			}
+			if(!runtime) caller->sites.push_back(site);
+			else if(!strcmp(id->get_name(), "readString") && site.args.size() == 2) caller->written.insert(site.args[1]); // (what the runtime lib writes)
+			else if((!strcmp(id->get_name(), "strcpy") || !strcmp(id->get_name(), "strcat")) && !site.args.empty()) caller->written.insert(site.args[0]);
 		}
 
 		bool check_type(Type* t) override {
 			sem();
-			return st.lookup(id->get_name())->rt->check_eq_with_t(t);
+			return session->st.lookup(id->get_name())->rt->check_eq_with_t(t);
 		}
 		
 		bool check_comp_with_fpt(Fpar_type* fpt) const override {
-			return st.lookup(id->get_name())->rt->check_comp_with_fpt(fpt);
+			return session->st.lookup(id->get_name())->rt->check_comp_with_fpt(fpt);
+		}
+
+		/* with constant arguments the call may be evaluated: if it returns something, it's replaced by what it
+		 * returned, and if it doesn't, it does nothing (and is dropped)
+		 */
+		void fold(const_eval &ev) override {
+			std::vector<long long> args;
+			if(e_list != nullptr)
+				for(auto const &a : e_list->item_list) {
+					a->fold(ev);
+					long long v;
+					if(static_cast<const Expr*>(a)->constant(v)) args.push_back(v);
+				}
+			if(args.size() != (e_list == nullptr ? 0 : e_list->item_list.size())) return;
+			if(callee == nullptr) {
+				evaluated = folded = runtime_lib(args, value);
+				return;
+			}
+			auto done = ev.done.find({callee, args});
+			if(done == ev.done.end()) {
+				long long result;
+				ev.begin();
+				const bool could = callee->call(ev, nullptr, args, result);
+				done = ev.done.emplace(std::make_pair(callee, args), std::make_pair(could, result)).first;
+			}
+			evaluated = done->second.first;
+			folded    = evaluated && !nothing;
+			value     = done->second.second;
+		}
+		bool eval(const_eval &ev, const_frame &frame, long long &v) const override {
+			if(evaluated) { v = value; return true; }
+			std::vector<long long> args;
+			if(e_list != nullptr)
+				for(auto const &a : e_list->item_list) {
+					long long x;
+					if(!static_cast<const Expr*>(a)->eval(ev, frame, x)) return false;
+					args.push_back(x);
+				}
+			if(callee == nullptr) return runtime_lib(args, v);
+			const_frame *link = &frame; // the frame of the function the callee is in
+			while(link != nullptr && link->f != callee->get_parent()) link = link->parent;
+			return callee->call(ev, link, args, v);
+		}
+		const_eval::outcome exec(const_eval &ev, const_frame &frame) const override {
+			long long v;
+			return eval(ev, frame, v) ? const_eval::NEXT : const_eval::GIVE_UP;
 		}
 
 		llvm::Value* compile() const override {
-			const ll_ste* ste = ll_st.lookup(id->get_name());
+			const ll_ste* ste = session->ll_st.lookup(id->get_name());
 			if(ste == nullptr) {
-				std::cerr << id->get_name() << " -> ";
+				session->diag << id->get_name() << " -> ";
 				yyerror("Compiler Bug: call to non existing function");
 			}
+			if(evaluated) return folded ? llvm::ConstantInt::get(ste->f->getReturnType(), value, true) : nullptr;
 			const bool is_rtf = ste->is_rtf;
 			std::vector<llvm::Value*> args;
 			// do not pass frame pointer if it's a library function
 			if(!is_rtf) {
 				// the correct fp is pointing to the sf of the function
 				// (scope) containing the def of the function called
-				unsigned long long i = ll_st.get_current_scope_no();
-				llvm::Value* v = ll_st.lookup("#stack_frame", i)->v;
+				unsigned long long i = session->ll_st.get_current_scope_no();
+				llvm::Value* v = session->ll_st.lookup("#stack_frame", i)->v;
 				while(i-- > ste->scope_no) {
-					llvm::Type  *t = ll_st.lookup("#stack_frame", i)->t;
-					llvm::Value *p = Builder.CreateStructGEP(t, v, 0, "fp_ptr_for_call");
-					v = Builder.CreateLoad(t->getPointerTo(), p, "fp_for call"); 
+					llvm::Type  *t = session->ll_st.lookup("#stack_frame", i)->t;
+					llvm::Value *p = session->Builder.CreateStructGEP(t, v, 0, "fp_ptr_for_call");
+					v = link_access(session->Builder.CreateLoad(t->getPointerTo(), p, "fp_for call"));
 				}
 				args.push_back(v);
 			}
-			if(e_list != nullptr) e_list->compile_exprs(args);
+			const std::vector<Fpar_def::passing> passing = callee != nullptr ? callee->passing() : std::vector<Fpar_def::passing>();
+			std::vector<std::pair<llvm::Value*, llvm::Type*>> results; // where the values passed by value-result go back to
 			llvm::Function::arg_iterator arg = ste->f->arg_begin();
-			unsigned long long i = 0;
-			if(!is_rtf) { ++arg; ++i; } // because first argument is the frame pointer
-			// FIX: REQUIRES TESTING
-			while(arg != ste->f->arg_end()) {
-				if(arg->getType()->isPointerTy() && !args[i]->getType()->isPointerTy()) { // if ref but not already passed by ref
+			if(!is_rtf) ++arg; // because first argument is the frame pointer
+			if(e_list != nullptr) // (in order, the address of an l-value is taken once, before the arguments after it run)
+				for(size_t i = 0; i < e_list->item_list.size(); ++i, ++arg) {
 					llvm::Type *t;
-					args[i] = e_list->item_list[is_rtf ? i : i - 1]->create_llvm_pointer_to(t);
+					if(arg->getType()->isPointerTy()) // by ref
+						args.push_back(e_list->item_list[i]->create_llvm_pointer_to(t));
+					else if(!passing.empty() && passing[i] == Fpar_def::BY_VALUE_RESULT) { // read from where it goes back to
+						llvm::Value* const p = e_list->item_list[i]->create_llvm_pointer_to(t);
+						args.push_back(data_access(session->Builder.CreateLoad(t, p, "value_result"), t));
+						results.emplace_back(p, t);
+					}
+					else args.push_back(e_list->item_list[i]->compile());
 				}
-				++arg; ++i;
+			llvm::CallInst* const call = session->Builder.CreateCall(ste->f, args);
+			if(results.empty()) return call;
+			const unsigned first = nothing ? 0 : 1;
+			for(unsigned r = 0; r < results.size(); ++r)
+				data_access(session->Builder.CreateStore(session->Builder.CreateExtractValue(call, first + r), results[r].first), results[r].second);
+			return nothing ? nullptr : session->Builder.CreateExtractValue(call, 0);
+		}
+		int lower_expr(bytecode &bc) const override {
+			long long c;
+			if(constant(c)) return bc.constant(c);
+			return lower_call(bc);
+		}
+		void lower_stmt(bytecode &bc) const override { if(!evaluated) lower_call(bc); }
+		bool calls() const override { return !evaluated; }
+
+		/* a write of the runtime lib adds its piece to the format of __grc_writef (libgrc/src/writef.c): a constant
+		 * integer, character or string literal is text (with % doubled, and a string up to its first \0), anything
+		 * else is %d, %c or %s and an argument. An argument that calls a function ends the run (the function may
+		 * write too, and the arguments are computed before anything is written)
+		 */
+		bool write(std::string &format, std::vector<const Expr*> &args) const override {
+			if(!runtime || e_list == nullptr) return false;
+			const char* const name = id->get_name();
+			const Expr* const a = static_cast<const Expr*>(e_list->item_list[0]);
+			if(a->calls()) return false;
+			long long v;
+			std::string text;
+			if(!strcmp(name, "writeInteger")) {
+				if(!a->constant(v)) return format += "%d", args.push_back(a), true;
+				text = std::to_string(v);
+			}
+			else if(!strcmp(name, "writeChar")) {
+				if(!a->constant(v)) return format += "%c", args.push_back(a), true;
+				text = std::string(1, (char)v);
 			}
-			return Builder.CreateCall(ste->f, args);
+			else if(!strcmp(name, "writeString")) {
+				const L_value* const l = dynamic_cast<const L_value*>(a);
+				if(l == nullptr || !l->literal(text)) return format += "%s", args.push_back(a), true;
+				text.resize(strlen(text.c_str()));
+			}
+			else return false;
+			for(const char c : text) {
+				format += c;
+				if(c == '%') format += '%';
+			}
+			return true;
 		}
 	private:
+		/* the static link and the arguments go to a block of registers the callee's frame starts with a copy of */
+		int lower_call(bytecode &bc) const {
+			std::vector<const Expr*> args;
+			if(e_list != nullptr)
+				for(auto const &a : e_list->item_list) args.push_back(static_cast<const Expr*>(a));
+			const bc_name* const f = bc.lookup(id->get_name());
+			if(f == nullptr) return lower_runtime_lib(bc, args);
+			const bc_function &bf = bc.function(f->index);
+			const int base = bc.temp(1 + args.size());
+			bc.emit(BC_FRAMEUP, base, bc.level() - f->level);
+			for(size_t i = 0; i < args.size(); ++i)
+				bc.move(base + 1 + i, bf.ref[i] ? args[i]->lower_ptr(bc) : args[i]->lower_expr(bc));
+			const int result = bf.value ? bc.temp() : -1;
+			bc.emit(BC_CALL, base, f->index, result);
+			return result;
+		}
+		int lower_runtime_lib(bytecode &bc, const std::vector<const Expr*> &args) const {
+			const std::string name = id->get_name();
+			if(name == "ascii") return args[0]->lower_expr(bc); // (chars are signed)
+			if(name == "writeInteger") { bc.emit(BC_WRITEI, args[0]->lower_expr(bc)); return -1; }
+			if(name == "writeChar")    { bc.emit(BC_WRITEC, args[0]->lower_expr(bc)); return -1; }
+			if(name == "writeString")  { bc.emit(BC_WRITES, args[0]->lower_ptr(bc));  return -1; }
+			if(name == "readString") {
+				const int n = args[0]->lower_expr(bc);
+				bc.emit(BC_READS, n, args[1]->lower_ptr(bc));
+				return -1;
+			}
+			if(name == "strcpy" || name == "strcat") {
+				const int to = args[0]->lower_ptr(bc);
+				bc.emit(name == "strcpy" ? BC_STRCPY : BC_STRCAT, to, args[1]->lower_ptr(bc));
+				return -1;
+			}
+			const int t = bc.temp();
+			if(name == "readInteger")  bc.emit(BC_READI, t);
+			else if(name == "readChar") bc.emit(BC_READC, t);
+			else if(name == "chr")     bc.emit(BC_SEXT8, t, args[0]->lower_expr(bc));
+			else if(name == "strlen")  bc.emit(BC_STRLEN, t, args[0]->lower_ptr(bc));
+			else if(name == "strcmp") {
+				const int a = args[0]->lower_ptr(bc);
+				bc.emit(BC_STRCMP, t, a, args[1]->lower_ptr(bc));
+			}
+			return t;
+		}
+
+		/* the functions of the runtime lib that are evaluated: the ones that only compute something */
+		bool runtime_lib(const std::vector<long long> &args, long long &v) const {
+			if(!runtime) return false;
+			const char* const name = id->get_name();
+			if(!strcmp(name, "ascii")) { v = args[0];               return true; } // (chars are signed)
+			if(!strcmp(name, "chr"))   { v = (signed char)args[0]; return true; }
+			return false;
+		}
+
 		Id        *id;
 		Expr_list *e_list;
+
+		const Func_def *callee   = nullptr; // its definition, if it's known when it's called (set by sem)
+		bool           runtime   = false;   // a function of the runtime lib
+		bool           nothing   = false;   // it returns nothing
+		bool           evaluated = false;   // at compile time (see fold)
 };
 
+inline void Stmt_list::compile_writes(const std::string &format, const std::vector<const Expr*> &args) {
+	llvm::GlobalVariable* const text = new llvm::GlobalVariable(*session->TheModule, llvm::ArrayType::get(session->i8, format.size()), true,
+		llvm::GlobalValue::PrivateLinkage, llvm::ConstantDataArray::getString(session->TheContext, format, false),
+		"writes." + session->Builder.GetInsertBlock()->getParent()->getName()); // (unique, --stream prints them with the function)
+	text->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+	text->setAlignment(llvm::Align(1));
+	std::vector<llvm::Value*> values = {text, c64(format.size())};
+	size_t a = 0;
+	for(size_t i = 0; i + 1 < format.size(); ++i) {
+		if(format[i] != '%') continue;
+		switch(format[++i]) {
+			case 'd': values.push_back(args[a++]->compile()); break;
+			case 'c': values.push_back(session->Builder.CreateSExt(args[a++]->compile(), session->i64)); break; // (varargs are words)
+			case 's': {
+				llvm::Type *t;
+				values.push_back(args[a++]->create_llvm_pointer_to(t));
+				break;
+			}
+		}
+	}
+	session->Builder.CreateCall(session->TheModule->getFunction("__grc_writef"), values);
+}
+
 class If : public Stmt {
 	public:
 		If(Cond* cond, Stmt* Then_stmt, Stmt* Else_stmt) : c(cond), Then(Then_stmt), Else(Else_stmt) {}
+		~If() { delete c; delete Then; delete Else; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "If Statement");
 			out << align << " IF" << std::endl
@@ -1553,12 +3644,31 @@ class If : public Stmt {
 			}
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << "(if ";
+			c->fingerprint(out);
+			Then->fingerprint(out);
+			if(Else != nullptr) Else->fingerprint(out);
+			out << ") ";
+		}
 
 		void sem() override {
 			c->sem();
 			Then->sem();
 			if(Else != nullptr) Else->sem();
 		}
+		void fold(const_eval &ev) override {
+			c->fold(ev);
+			Then->fold(ev);
+			if(Else != nullptr) Else->fold(ev);
+		}
+		const_eval::outcome exec(const_eval &ev, const_frame &frame) const override {
+			bool v;
+			if(!c->eval(ev, frame, v)) return const_eval::GIVE_UP;
+			if(v)               return Then->exec(ev, frame);
+			if(Else != nullptr) return Else->exec(ev, frame);
+			return const_eval::NEXT;
+		}
 
     llvm::Value* compile() const override {
 /*
@@ -1566,40 +3676,68 @@ class If : public Stmt {
 
     BB:
       ...
-      %v = compile condition
-      %if_cond = icmp ne i32 %v, i32 0
-      br $if_cond, label %L1, label %L2
+      compile condition (jumping to L1 or L2)
 
     L1:
       s1
       br label L3
 
-    L2:
+    L2:                       (only if there is an else, otherwise the condition jumps to L3)
       s2
       br label L3
 
-    L3:
+    L3:                       (only if reachable, i.e. s1 or s2 don't both return)
       ...
 */
-    llvm::Value *v = c->compile();
-    llvm::Function *TheFunction = Builder.GetInsertBlock()->getParent();
+    bool taken;
+    if (c->constant(taken)) { // only the branch that is taken
+      const Stmt* const s = taken ? Then : Else;
+      if (s != nullptr) s->compile_stmt();
+      return nullptr;
+    }
+    // blocks are inserted in the function when their code is generated so they stay in source order
+    llvm::Function *TheFunction = session->Builder.GetInsertBlock()->getParent();
     llvm::BasicBlock *ThenBB =
-      llvm::BasicBlock::Create(TheContext, "then", TheFunction);
-    llvm::BasicBlock *ElseBB =
-      llvm::BasicBlock::Create(TheContext, "else", TheFunction);
+      llvm::BasicBlock::Create(session->TheContext, "then");
+    llvm::BasicBlock *ElseBB = Else == nullptr ? nullptr :
+      llvm::BasicBlock::Create(session->TheContext, "else");
     llvm::BasicBlock *AfterBB =
-      llvm::BasicBlock::Create(TheContext, "endif", TheFunction);
-    Builder.CreateCondBr(v, ThenBB, ElseBB);
-    Builder.SetInsertPoint(ThenBB);
-    Then->compile();
-    Builder.CreateBr(AfterBB);
-    Builder.SetInsertPoint(ElseBB);
-    if (Else != nullptr) Else->compile();
-    Builder.CreateBr(AfterBB);
-    Builder.SetInsertPoint(AfterBB);
+      llvm::BasicBlock::Create(session->TheContext, "endif");
+    c->compile_cond(ThenBB, Else == nullptr ? AfterBB : ElseBB);
+    ThenBB->insertInto(TheFunction);
+    session->Builder.SetInsertPoint(ThenBB);
+    Then->compile_stmt();
+    if (!block_terminated()) branch_to(AfterBB);
+    if (Else != nullptr) {
+      ElseBB->insertInto(TheFunction);
+      session->Builder.SetInsertPoint(ElseBB);
+      Else->compile_stmt();
+      if (!block_terminated()) branch_to(AfterBB);
+    }
+    if (llvm::pred_empty(AfterBB)) delete AfterBB; // both branches returned, leave the builder in a terminated block
+    else {
+      AfterBB->insertInto(TheFunction);
+      session->Builder.SetInsertPoint(AfterBB);
+    }
     return nullptr;
   }
 
+		void lower_stmt(bytecode &bc) const override {
+			bool taken;
+			if(c->constant(taken)) {
+				const Stmt* const s = taken ? Then : Else;
+				if(s != nullptr) s->lower_at(bc);
+				return;
+			}
+			const int otherwise = bc.label(), after = bc.label();
+			c->lower_branch(bc, false, otherwise);
+			Then->lower_at(bc);
+			if(Else != nullptr) bc.jump(BC_JMP, after);
+			bc.bind(otherwise);
+			if(Else != nullptr) Else->lower_at(bc);
+			bc.bind(after);
+		}
+
   private:
 		Cond *c;
 		Stmt *Then;
@@ -1609,6 +3747,7 @@ class If : public Stmt {
 class While : public Stmt {
 	public:
 		While(Cond* cond, Stmt* stmt) : c(cond), s(stmt) {}
+		~While() { delete c; delete s; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "While Statement");
 			out << *c;
@@ -1616,31 +3755,67 @@ class While : public Stmt {
 			out << *s;
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << "(while ";
+			c->fingerprint(out);
+			s->fingerprint(out);
+			out << ") ";
+		}
 
 		void sem() override {
 			c->sem();
 			s->sem();
 		}
+		void fold(const_eval &ev) override {
+			c->fold(ev);
+			s->fold(ev);
+		}
+		const_eval::outcome exec(const_eval &ev, const_frame &frame) const override {
+			for(bool v; ev.step(); ) {
+				if(!c->eval(ev, frame, v)) break;
+				if(!v) return const_eval::NEXT;
+				const const_eval::outcome o = s->exec(ev, frame);
+				if(o != const_eval::NEXT) return o;
+			}
+			return const_eval::GIVE_UP;
+		}
 
     llvm::Value* compile() const override {
-      // c->compile
-      llvm::Function *TheFunction = Builder.GetInsertBlock()->getParent();
-      llvm::BasicBlock* loopHeader = llvm::BasicBlock::Create(TheContext, "loop_header", TheFunction);
-      llvm::BasicBlock* loopBody = llvm::BasicBlock::Create(TheContext, "loop_body", TheFunction);
-      llvm::BasicBlock* loopEnd = llvm::BasicBlock::Create(TheContext, "loop_end", TheFunction);
-
-      Builder.CreateBr(loopHeader);
-      Builder.SetInsertPoint(loopHeader);
-      llvm::Value *cond = c->compile();
-      Builder.CreateCondBr(cond, loopBody, loopEnd);
-      
-      Builder.SetInsertPoint(loopBody);
-      s->compile();
-      Builder.CreateBr(loopHeader);
+      bool enters;
+      if (c->constant(enters) && !enters) return nullptr;
+      llvm::Function *TheFunction = session->Builder.GetInsertBlock()->getParent();
+      llvm::BasicBlock* loopHeader = session->Builder.GetInsertBlock();
+      if (!loopHeader->empty() || loopHeader == &TheFunction->getEntryBlock()) { // an empty block (e.g. an endif) can be the header itself
+        loopHeader = llvm::BasicBlock::Create(session->TheContext, "loop_header", TheFunction);
+        session->Builder.CreateBr(loopHeader);
+        session->Builder.SetInsertPoint(loopHeader);
+      }
+      llvm::BasicBlock* loopBody = llvm::BasicBlock::Create(session->TheContext, "loop_body");
+      llvm::BasicBlock* loopEnd = llvm::BasicBlock::Create(session->TheContext, "loop_end");
 
-      Builder.SetInsertPoint(loopEnd);
+      c->compile_cond(loopBody, loopEnd);
+      
+      loopBody->insertInto(TheFunction);
+      session->Builder.SetInsertPoint(loopBody);
+      s->compile_stmt();
+      if (session->debug != nullptr) session->debug->at(line, column); // the jump back belongs to the loop
+      if (!block_terminated()) branch_to(loopHeader);
+      loopEnd->insertInto(TheFunction);
+
+      session->Builder.SetInsertPoint(loopEnd);
 	  return nullptr;
     }
+		void lower_stmt(bytecode &bc) const override { // (the condition is tested at the bottom)
+			bool enters;
+			if(c->constant(enters) && !enters) return;
+			const int test = bc.label(), body = bc.label();
+			bc.jump(BC_JMP, test);
+			bc.bind(body);
+			s->lower_at(bc);
+			bc.bind(test);
+			bc.at(line);
+			c->lower_branch(bc, true, body);
+		}
 	private:
 		Cond *c;
 		Stmt *s;
@@ -1649,6 +3824,7 @@ class While : public Stmt {
 class Return : public Stmt {
 	public:
 		Return(Expr* expr) : e(expr) {}
+		~Return() { delete e; }
 		void print(std::ostream &out) const override {
 			align.begin(out, "Return Statement");
 			if(e != nullptr) {
@@ -1657,9 +3833,14 @@ class Return : public Stmt {
 			}
 			align.end(out);
 		}
+		void fingerprint(std::ostream &out) const override {
+			out << "(return ";
+			if(e != nullptr) e->fingerprint(out);
+			out << ") ";
+		}
 
 		void sem() override {
-			const Ret_type *rt = st.get_scope_owner_rtype();
+			const Ret_type *rt = session->st.get_scope_owner_rtype();
 			if(e == nullptr)
 				if(rt->is_nothing())
 					return;
@@ -1674,19 +3855,20 @@ class Return : public Stmt {
 			else
 				yyerror("Semantic Error: Type missmatch in return statement, function has a different return type than that of returned expression");
 		}
+		void fold(const_eval &ev) override { if(e != nullptr) e->fold(ev); }
+		const_eval::outcome exec(const_eval &ev, const_frame &frame) const override {
+			if(e != nullptr && !e->eval(ev, frame, frame.result)) return const_eval::GIVE_UP;
+			return const_eval::RETURNED;
+		}
 		
 		llvm::Value* compile() const override {
-			if(e != nullptr)                           Builder.CreateRet(e->compile());
-			else if(ll_st.get_current_scope_no() == 2) Builder.CreateRet(c64(0)); // if main, return 0 to the OS (because grace main is void and would return random values)
-			else                                       Builder.CreateRetVoid();
-
-			// Because a basic block must end after a ret, we place everything that might come after
-			// and would have been in the same block into a block (chain) that will get deleted
-			llvm::Function *TheFunction = Builder.GetInsertBlock()->getParent();
-			llvm::BasicBlock* Dump = llvm::BasicBlock::Create(TheContext, "dump", TheFunction);
-			Builder.SetInsertPoint(Dump);
+			if(e != nullptr)                           session->Builder.CreateRet(e->compile());
+			else if(session->ll_st.get_current_scope_no() == 2) session->Builder.CreateRet(c64(0)); // if main, return 0 to the OS (because grace main is void and would return random values)
+			else                                       session->Builder.CreateRetVoid();
+			// the block is now terminated, so whoever compiles the enclosing statements stops here
 			return nullptr;
 		}
+		void lower_stmt(bytecode &bc) const override { bc.ret(e != nullptr ? e->lower_expr(bc) : -1); }
 	
 	private:
 		Expr *e;
@@ -0,0 +1,89 @@
+#ifndef __BATCH_HPP__
+#define __BATCH_HPP__
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "driver.hpp"
+#include "pool.hpp"
+#include "session.hpp"
+
+/* the output of a unit is written in the current directory and named like grc.py names it */
+inline std::string batch_output_name(const std::string &file, const compile_options &opts) {
+	std::string name = file.substr(file.find_last_of('/') + 1);
+	name = name.substr(0, name.find('.'));
+	if(opts.exe) return name;
+	switch(opts.emit) {
+		case EMIT_IR:  return name + ".ll";
+		case EMIT_ASM: return name + ".s";
+		case EMIT_OBJ: return name + ".o";
+	}
+	return name;
+}
+
+inline void read_manifest(const char* const manifest, std::vector<std::string> &files) { // one file per line
+	std::ifstream in(manifest);
+	if(!in) std::cerr << "can't open manifest " << manifest << std::endl;
+	std::string line;
+	while(std::getline(in, line))
+		if(!line.empty()) files.push_back(line);
+}
+
+/* Compiles every file in its own session. The diagnostics of a file are printed (to stderr) all
+ * together once it's done, followed by a "<file> <exit status>" line on stdout.
+ * Files that would write the same output (a/sol.grc and b/sol.grc) aren't compiled, they fail.
+ * Returns the worst exit status.
+ */
+inline int compile_batch(const std::vector<std::string> &files, const compile_options &opts, const unsigned jobs, compile_cache* const cache=nullptr) {
+	std::vector<int> status(files.size(), 0);
+	std::map<std::string, std::vector<size_t>> writers; // of every output
+	for(size_t i = 0; i < files.size(); ++i) writers[batch_output_name(files[i], opts)].push_back(i);
+	std::mutex print_lock;
+	work_stealing_pool::run(files.size(), jobs, [&](const unsigned long long i) {
+		std::string code;
+		std::ostringstream diag;
+		const std::vector<size_t> &same = writers.at(batch_output_name(files[i], opts));
+		std::ifstream in(files[i], std::ios::binary);
+		if(same.size() > 1) {
+			diag << batch_output_name(files[i], opts) << " would be the output of";
+			for(const size_t j : same) diag << ' ' << files[j];
+			diag << std::endl;
+			status[i] = 1;
+		}
+		else if(!in) {
+			diag << "can't open " << files[i] << std::endl;
+			status[i] = 1;
+		}
+		else {
+			std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+			compile_options file_opts = opts;
+			file_opts.file = files[i]; // for -g
+			status[i] = compile_source(source, file_opts, code, diag, cache);
+		}
+		if(status[i] == 0) {
+			const std::string name = batch_output_name(files[i], opts);
+			std::ofstream f(name, std::ios::binary);
+			f << code;
+			f.close();
+			if(!f) {
+				diag << "can't write " << name << std::endl;
+				status[i] = 1;
+			}
+			else if(opts.exe) chmod(name.c_str(), 0755);
+		}
+
+		std::lock_guard<std::mutex> lock(print_lock);
+		if(!diag.str().empty()) std::cerr << files[i] << ":\n" << diag.str() << std::flush;
+		std::cout << files[i] << ' ' << status[i] << std::endl;
+	});
+	return files.empty() ? 0 : *std::max_element(status.begin(), status.end());
+}
+
+#endif
@@ -0,0 +1,61 @@
+#!/bin/sh
+# The run time of naive recursive programs (fib, binomial coefficients, partitions) and of bench/programs/typical.grc
+# compiled with -O and with -O -fauto-memo, and what -fauto-memo reported for them. The outputs are compared.
+# usage: bench/auto_memo.sh [runs]
+cd "$(dirname "$0")/.."
+grc="$PWD/grc"
+. "$PWD/bench/timing.sh"
+typical="$PWD/bench/programs/typical.grc"
+runs=${1:-3}
+tmp=$(mktemp -d)
+cd "$tmp"
+
+cat > fib.grc << 'EOF'
+fun main () : nothing
+  fun fib (n : int) : int {
+    if n < 2 then return n;
+    return fib(n - 1) + fib(n - 2);
+  }
+{
+  writeInteger(fib(readInteger())); writeChar('\n');
+}
+EOF
+echo 38 > fib.in
+cat > binomial.grc << 'EOF'
+fun main () : nothing
+  fun c (n, k : int) : int {
+    if k = 0 or k = n then return 1;
+    return c(n - 1, k - 1) + c(n - 1, k);
+  }
+{
+  writeInteger(c(readInteger(), 15)); writeChar('\n');
+}
+EOF
+echo 32 > binomial.in
+cat > partitions.grc << 'EOF'
+fun main () : nothing
+  fun p (n, m : int) : int { $ the partitions of n in parts of at most m
+    if n = 0 then return 1;
+    if n < 0 or m = 0 then return 0;
+    return p(n - m, m) + p(n, m - 1);
+  }
+{
+  writeInteger(p(readInteger(), 60)); writeChar('\n');
+}
+EOF
+echo 90 > partitions.in
+cp "$typical" typical.grc
+: > typical.in
+
+printf "%-12s %10s %16s %9s\n" program "-O ms" "-fauto-memo ms" speedup
+for program in fib binomial partitions typical; do
+	"$grc" -O --exe < $program.grc > plain 2> /dev/null && "$grc" -O -fauto-memo --exe < $program.grc > memo 2> $program.report || exit 1
+	chmod +x plain memo
+	plain=$(ms "./plain < $program.in > plain.out")
+	memo=$(ms "./memo < $program.in > memo.out")
+	cmp -s plain.out memo.out || echo "the outputs of $program differ"
+	printf "%-12s %10s %16s %8sx\n" $program $plain $memo $(awk -v a=$plain -v b=$memo 'BEGIN { printf "%.1f", a / b }')
+done
+cat *.report
+
+rm -rf "$tmp"
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Files per second (and per second per thread) of grc --batch for 1, 2, 4, ... threads up to the number of cores.
+# usage: bench/batch_throughput.sh [program.grc] [files]
+cd "$(dirname "$0")/.."
+grc="$PWD/grc"
+prog="$PWD/${1:-bench/programs/typical.grc}"
+files=${2:-256}
+tmp=$(mktemp -d)
+cd "$tmp"
+
+i=0
+while [ $i -lt $files ]; do
+	cp "$prog" "unit$i.grc"
+	echo "unit$i.grc" >> manifest
+	i=$((i + 1))
+done
+
+cores=$(nproc)
+jobs=1
+while [ $jobs -le $cores ]; do
+	start=$(date +%s%N)
+	$grc --batch --jobs=$jobs -O -c @manifest > /dev/null || exit 1
+	end=$(date +%s%N)
+	awk -v j=$jobs -v t=$((end - start)) -v n=$files 'BEGIN { f = n / (t / 1e9); printf "%3d threads %9.1f files/s %9.1f files/s/thread\n", j, f, f / j }'
+	[ $jobs -lt $cores ] && [ $((jobs * 2)) -gt $cores ] && jobs=$cores || jobs=$((jobs * 2))
+done
+
+rm -rf "$tmp"
@@ -0,0 +1,75 @@
+#!/bin/sh
+# The cost of --budget: a loop heavy, a call heavy and a nested loops program are compiled with -O and with
+# -O --budget and both executables are timed. Each metered one also runs with a budget too small for it, to
+# check that it stops with the exit code of an exhausted budget (152).
+# usage: bench/budget_overhead.sh [runs]
+cd "$(dirname "$0")/.."
+grc="$PWD/grc"
+. "$PWD/bench/timing.sh"
+runs=${1:-5}
+tmp=$(mktemp -d)
+cd "$tmp"
+
+cat > collatz.grc << 'EOF2'
+fun main () : nothing
+  var i, n, steps : int;
+{
+  i <- 1; steps <- 0;
+  while i < 1000000 do {
+    n <- i;
+    while n # 1 do {
+      if n mod 2 = 0 then n <- n div 2; else n <- 3 * n + 1;
+      steps <- steps + 1;
+    }
+    i <- i + 1;
+  }
+  writeInteger(steps); writeChar('\n');
+}
+EOF2
+cat > fib.grc << 'EOF2'
+fun main () : nothing
+  fun fib (n : int) : int {
+    if n < 2 then return n;
+    return fib(n - 1) + fib(n - 2);
+  }
+{
+  writeInteger(fib(32)); writeChar('\n');
+}
+EOF2
+cat > sieve.grc << 'EOF2'
+fun main () : nothing
+  var composite : int[10000000];
+  var i, j, primes, round : int;
+{
+  round <- 0;
+  while round < 2 do {
+    i <- 0;
+    while i < 10000000 do { composite[i] <- 0; i <- i + 1; }
+    primes <- 0; i <- 2;
+    while i < 10000000 do {
+      if composite[i] = 0 then {
+        primes <- primes + 1;
+        j <- i + i;
+        while j < 10000000 do { composite[j] <- 1; j <- j + i; }
+      }
+      i <- i + 1;
+    }
+    round <- round + 1;
+  }
+  writeInteger(primes); writeChar('\n');
+}
+EOF2
+
+printf "%-10s %10s %16s %9s %10s\n" program "-O ms" "-O --budget ms" slowdown exhausted
+for program in collatz fib sieve; do
+	"$grc" -O --exe < $program.grc > plain && "$grc" -O --budget --exe < $program.grc > metered && chmod +x plain metered || exit 1
+	plain=$(ms ./plain)
+	metered=$(ms ./metered)
+	GRC_BUDGET=1000 ./metered > /dev/null 2>&1
+	status=$?
+	awk -v p=$program -v a=$plain -v b=$metered -v s=$status 'BEGIN {
+		printf "%-10s %10.1f %16.1f %8.2fx %10s\n", p, a, b, b / a, s == 152 ? "152" : s " (wrong)"
+	}'
+done
+
+rm -rf "$tmp"
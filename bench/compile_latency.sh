@@ -0,0 +1,22 @@
+#!/bin/sh
+# End to end compile latency of grc.py (source to executable) for each optimization mode.
+# usage: bench/compile_latency.sh [program.grc] [runs]
+cd "$(dirname "$0")/.."
+grc="$PWD/grc.py"
+prog="$PWD/${1:-bench/programs/typical.grc}"
+runs=${2:-20}
+tmp=$(mktemp -d)
+cd "$tmp"
+
+for mode in -O0 "" -O; do
+	start=$(date +%s%N)
+	i=0
+	while [ $i -lt $runs ]; do
+		$grc $mode "$prog" > /dev/null || exit 1
+		i=$((i + 1))
+	done
+	end=$(date +%s%N)
+	awk -v m="${mode:-default}" -v t=$((end - start)) -v n=$runs 'BEGIN { printf "%-8s %8.2f ms/compile\n", m, t / n / 1000000 }'
+done
+
+rm -rf "$tmp"
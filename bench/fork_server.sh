@@ -0,0 +1,49 @@
+#!/bin/bash
+# The cost of a run per test case: an executable started once per input against the same executable compiled with
+# --fork-server, started once and asked to run every input (see libgrc/src/fork.c). The program does next to
+# nothing, so the times are the overhead. The outputs are compared and the status lines of the server are summed up.
+# usage: bench/fork_server.sh [inputs]
+cd "$(dirname "$0")/.."
+grc="$PWD/grc"
+inputs=${1:-1000}
+tmp=$(mktemp -d)
+cd "$tmp"
+
+cat > echo.grc << 'EOF'
+fun main () : nothing {
+  writeInteger(readInteger() + 1); writeChar('\n');
+}
+EOF
+"$grc" -O --exe < echo.grc > plain && "$grc" -O --fork-server --exe < echo.grc > server && chmod +x plain server || exit 1
+i=0
+while [ $i -lt $inputs ]; do
+	echo $i > in$i
+	i=$((i + 1))
+done
+
+start=$(date +%s%N)
+for ((i = 0; i < inputs; ++i)); do ./plain < in$i > exec$i; done
+end=$(date +%s%N)
+exec_us=$(( (end - start) / inputs / 1000 ))
+
+mkfifo control status
+GRC_FORK_SERVER=3,4 ./server 3< control 4> status &
+exec 5> control 6< status
+start=$(date +%s%N)
+user=0 sys=0
+for ((i = 0; i < inputs; ++i)); do
+	echo "in$i out$i" >&5
+	read code u s rss <&6
+	[ "$code" = 0 ] || echo "in$i: exit status $code"
+	user=$((user + u)) sys=$((sys + s))
+done
+end=$(date +%s%N)
+exec 5>&- 6<&-
+wait
+server_us=$(( (end - start) / inputs / 1000 ))
+
+for ((i = 0; i < inputs; ++i)); do cmp -s exec$i out$i || echo "the outputs of in$i differ"; done
+echo "$inputs inputs: $exec_us us per run with an exec, $server_us us with the fork server" \
+     "(the children took $((user / inputs)) us of user and $((sys / inputs)) us of system time each)"
+
+rm -rf "$tmp"
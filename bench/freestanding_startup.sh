@@ -0,0 +1,39 @@
+#!/bin/sh
+# Startup of a short run: the same program (it writes a line) compiled as usual (linked dynamically
+# with libgrc and libc) and with --freestanding (linked statically with libgrc/freestanding and no libc), measured
+# with perf stat over many runs: the time, the page faults and the instructions, most of them the dynamic linker's
+# and libc's initialization in the first case. Without perf the runs are only timed. The outputs are compared.
+# usage: bench/freestanding_startup.sh [runs]
+cd "$(dirname "$0")/.."
+grc="$PWD/grc"
+runs=${1:-1000}
+tmp=$(mktemp -d)
+cd "$tmp"
+
+cat > hello.grc << 'EOF'
+fun main () : nothing {
+  writeString("hello world\n");
+}
+EOF
+"$grc" -O --exe < hello.grc > dynamic && "$grc" -O --freestanding --exe < hello.grc > freestanding || exit 1
+chmod +x dynamic freestanding
+./dynamic > dynamic.out && ./freestanding > freestanding.out && cmp -s dynamic.out freestanding.out || echo "the outputs differ"
+ls -l dynamic freestanding | awk '{ print $NF ": " $5 " bytes" }'
+
+for exe in dynamic freestanding; do
+	echo "$exe:"
+	if command -v perf > /dev/null 2>&1; then
+		perf stat -r $runs -e task-clock,page-faults,instructions:u -- ./$exe 2>&1 > /dev/null | grep -E 'task-clock|page-faults|instructions|elapsed'
+	else
+		start=$(date +%s%N)
+		i=0
+		while [ $i -lt $runs ]; do
+			./$exe > /dev/null
+			i=$((i + 1))
+		done
+		end=$(date +%s%N)
+		echo "  $(( (end - start) / runs / 1000 )) us per run (no perf)"
+	fi
+done
+
+rm -rf "$tmp"
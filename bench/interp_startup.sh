@@ -0,0 +1,44 @@
+#!/bin/sh
+# Time to the output of a program with grc --interp and with the native code (compiled with -O0 and -O, then run),
+# on short runs and on a long one. The first line is grc --interp with an empty program: the start of grc itself
+# (mostly loading llvm's shared libraries), the rest of a short run is checking, lowering and running the program.
+# usage: bench/interp_startup.sh [runs]
+cd "$(dirname "$0")/.."
+grc="$PWD/grc"
+. "$PWD/bench/timing.sh"
+typical="$PWD/bench/programs/typical.grc"
+runs=${1:-20}
+tmp=$(mktemp -d)
+cd "$tmp"
+
+cat > empty.grc << 'EOF'
+fun main () : nothing { }
+EOF
+cat > hello.grc << 'EOF'
+fun main () : nothing {
+  writeString("hello world\n");
+}
+EOF
+cat > fib.grc << 'EOF'
+fun main () : nothing
+  fun fib (n : int) : int {
+    if n < 2 then return n;
+    return fib(n - 1) + fib(n - 2);
+  }
+{
+  writeInteger(fib(30)); writeChar('\n');
+}
+EOF
+cp "$typical" typical.grc
+
+printf "%-10s %12s %16s %14s\n" program "--interp ms" "-O0 + run ms" "-O + run ms"
+printf "%-10s %12s\n" empty $(ms "$grc --interp empty.grc")
+for program in hello typical fib; do
+	interp=$(ms "$grc --interp $program.grc")
+	o0=$(ms "$grc -O0 --exe < $program.grc > o0 && chmod +x o0 && ./o0")
+	o=$(ms "$grc -O --exe < $program.grc > o && chmod +x o && ./o")
+	printf "%-10s %12s %16s %14s\n" $program $interp $o0 $o
+done
+"$grc" --interp fib.grc > interp.out && ./o > native.out && cmp -s interp.out native.out || echo "the outputs of fib differ"
+
+rm -rf "$tmp"
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Time of grc -O -c with -j1, -j2, -j4, ... up to the number of cores on a generated program with
+# many nested functions, and a check that every thread count produces the same object.
+# usage: bench/parallel_codegen.sh [functions] [runs]
+cd "$(dirname "$0")/.."
+grc="$PWD/grc"
+functions=${1:-2000}
+runs=${2:-3}
+tmp=$(mktemp -d)
+cd "$tmp"
+
+awk -v n=$functions 'BEGIN {
+	print "fun main () : nothing"
+	print "  var s : int;"
+	for (f = 0; f < n; ++f) {
+		printf "  fun f%d (n : int) : int\n", f
+		print  "    var i, t : int;"
+		print  "    fun step (x : int) : int { if x mod 3 = 0 then return x div 3; return x * 2 + n; }"
+		printf "  { i <- 0; t <- %d; while i < n do { t <- (t + step(i)) mod 1000003; i <- i + 1; } return t; }\n", f
+	}
+	print "{"
+	print "  s <- 0;"
+	for (f = 0; f < n; ++f) printf "  s <- (s + f%d(%d)) mod 1000003;\n", f, f % 10
+	print "  writeInteger(s);"
+	print "}"
+}' > big.grc
+
+cores=$(nproc)
+jobs=1
+while [ $jobs -le $cores ]; do
+	start=$(date +%s%N)
+	i=0
+	while [ $i -lt $runs ]; do
+		"$grc" -O -c -j$jobs < big.grc > big$jobs.o || exit 1
+		i=$((i + 1))
+	done
+	end=$(date +%s%N)
+	awk -v j=$jobs -v t=$((end - start)) -v n=$runs 'BEGIN { printf "-j%-3d %9.1f ms/compile\n", j, t / n / 1000000 }'
+	cmp -s big1.o big$jobs.o || echo "-j$jobs produced a different object"
+	[ $jobs -lt $cores ] && [ $((jobs * 2)) -gt $cores ] && jobs=$cores || jobs=$((jobs * 2))
+done
+start=$(date +%s%N)
+"$grc" -O -c < big.grc > /dev/null || exit 1
+end=$(date +%s%N)
+awk -v t=$((end - start)) 'BEGIN { printf "no -j %9.1f ms/compile\n", t / 1000000 }'
+
+rm -rf "$tmp"
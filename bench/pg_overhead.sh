@@ -0,0 +1,62 @@
+#!/bin/sh
+# The cost of -pg on call heavy recursive programs: each one is compiled with -O and with -O -pg and both
+# executables are timed. The overhead is reported as a slowdown and per call (the calls come from the profile).
+# usage: bench/pg_overhead.sh [runs]
+cd "$(dirname "$0")/.."
+grc="$PWD/grc"
+. "$PWD/bench/timing.sh"
+runs=${1:-5}
+tmp=$(mktemp -d)
+cd "$tmp"
+
+cat > fib.grc << 'EOF'
+fun main () : nothing
+  fun fib (n : int) : int {
+    if n < 2 then return n;
+    return fib(n - 1) + fib(n - 2);
+  }
+{
+  writeInteger(fib(32)); writeChar('\n');
+}
+EOF
+cat > ackermann.grc << 'EOF'
+fun main () : nothing
+  fun ack (m, n : int) : int {
+    if m = 0 then return n + 1;
+    if n = 0 then return ack(m - 1, 1);
+    return ack(m - 1, ack(m, n - 1));
+  }
+{
+  writeInteger(ack(2, 2000)); writeChar('\n');
+}
+EOF
+cat > hanoi.grc << 'EOF'
+fun main () : nothing
+  var moves : int;
+  fun move (n, from, to, via : int) : nothing
+    fun count () : nothing { moves <- moves + 1; }
+  {
+    if n = 0 then return;
+    move(n - 1, from, via, to);
+    count();
+    move(n - 1, via, to, from);
+  }
+{
+  moves <- 0;
+  move(22, 1, 3, 2);
+  writeInteger(moves); writeChar('\n');
+}
+EOF
+
+printf "%-10s %10s %10s %9s %13s %9s\n" program "-O ms" "-O -pg ms" slowdown calls "ns/call"
+for program in fib ackermann hanoi; do
+	"$grc" -O --exe < $program.grc > plain && "$grc" -O -pg --exe < $program.grc > pg && chmod +x plain pg || exit 1
+	plain=$(ms ./plain)
+	pg=$(ms ./pg)
+	calls=$(awk '/^call graph/ { exit } $4 ~ /^[0-9]+$/ && NF == 7 { c += $4 } END { print c }' grcprof.out)
+	awk -v p=$program -v a=$plain -v b=$pg -v c=$calls 'BEGIN {
+		printf "%-10s %10.1f %10.1f %8.1fx %13d %9.1f\n", p, a, b, b / a, c, (b - a) * 1000000 / c
+	}'
+done
+
+rm -rf "$tmp"
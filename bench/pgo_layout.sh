@@ -0,0 +1,65 @@
+#!/bin/sh
+# Profile guided optimization end to end: a program with a branch that is almost never taken is compiled
+# with -fprofile-generate, run, and compiled again with -fprofile-use. The layout of main (its labels,
+# jumps and calls) is printed before and after, and the run times of both executables are compared.
+# Fails if the profile didn't change the layout.
+# usage: bench/pgo_layout.sh [runs]
+cd "$(dirname "$0")/.."
+grc="$PWD/grc"
+runs=${1:-5}
+tmp=$(mktemp -d)
+cd "$tmp"
+
+cat > branch.grc << 'EOF'
+fun main () : nothing
+  var i, s, r : int;
+  fun rare (x : int) : nothing {
+    writeChar('!'); writeInteger(x); writeChar('\n');
+  }
+  fun step (x : int) : int {
+    if x mod 3 = 0 then return x div 3;
+    return x * 2 + 1;
+  }
+{
+  i <- 0; s <- 0; r <- 0;
+  while i < 100000000 do {
+    if i mod 10000000 = 7 then { r <- r + 1; rare(i); }
+    else s <- (s + step(i)) mod 1000003;
+    i <- i + 1;
+  }
+  writeInteger(s); writeChar('\n');
+}
+EOF
+
+layout() { # the labels, jumps, calls and returns of main
+	awk '/^main:/ { on = 1 } on && /^\.Lfunc_end/ { exit } on && (/^[.A-Za-z_][^:]*:/ || /^\t(j|call|ret)/) { print }' "$1"
+}
+
+"$grc" -O -S < branch.grc > plain.s &&
+"$grc" -O --exe < branch.grc > plain &&
+"$grc" -O -fprofile-generate="$tmp/branch.proftext" --exe < branch.grc > instrumented &&
+chmod +x plain instrumented && ./instrumented > /dev/null &&
+"$grc" -O -S -fprofile-use=branch.proftext < branch.grc > pgo.s &&
+"$grc" -O --exe -fprofile-use=branch.proftext < branch.grc > pgo && chmod +x pgo || exit 1
+
+layout plain.s > plain.layout
+layout pgo.s > pgo.layout
+echo "layout of main with -O (left) and with -O -fprofile-use (right):"
+diff -y -W 80 plain.layout pgo.layout
+grep -q 'cold' pgo.s && echo "cold code split out: $(grep -c '^main\.cold\.[0-9]*:' pgo.s) function(s) in .text.unlikely"
+
+for exe in plain pgo; do
+	start=$(date +%s%N)
+	i=0
+	while [ $i -lt $runs ]; do
+		./$exe > /dev/null || exit 1
+		i=$((i + 1))
+	done
+	end=$(date +%s%N)
+	awk -v e=$exe -v t=$((end - start)) -v n=$runs 'BEGIN { printf "%-6s %8.1f ms/run\n", e, t / n / 1000000 }'
+done
+
+changed=1
+cmp -s plain.layout pgo.layout && changed=0
+rm -rf "$tmp"
+[ $changed = 1 ] || { echo "the profile didn't change the layout"; exit 1; }
@@ -0,0 +1,38 @@
+#!/bin/sh
+# Re-compile latency of grc -O after a one line change in one function, with the unchanged functions
+# taken from the cache (--cache), next to a compilation from scratch and a cache hit.
+# Every run changes the first "+ 1" in the given line to a different constant.
+# usage: bench/recompile_latency.sh [program.grc] [line] [runs]
+cd "$(dirname "$0")/.."
+grc="$PWD/grc"
+prog="$PWD/${1:-bench/programs/typical.grc}"
+line=${2:-141}
+runs=${3:-20}
+tmp=$(mktemp -d)
+cd "$tmp"
+
+time_ms() { # command, runs
+	start=$(date +%s%N)
+	i=0
+	while [ $i -lt $2 ]; do
+		eval "$1" > /dev/null || exit 1
+		i=$((i + 1))
+	done
+	end=$(date +%s%N)
+	awk -v t=$((end - start)) -v n=$2 'BEGIN { printf "%8.2f ms/compile\n", t / n / 1000000 }'
+}
+
+printf "from scratch  "; time_ms "$grc -O -c < '$prog'" $runs
+"$grc" -O -c --cache="$tmp/cache" < "$prog" > /dev/null
+printf "cache hit     "; time_ms "$grc -O -c --cache='$tmp/cache' < '$prog'" $runs
+
+i=0
+while [ $i -lt $runs ]; do
+	sed "${line}s/+ 1/+ $((i + 2))/" "$prog" > "edit$i.grc"
+	i=$((i + 1))
+done
+n=0
+printf "one line edit "; time_ms '$grc -O -c --cache="$tmp/cache" < edit$n.grc; n=$((n + 1))' $runs
+"$grc" --cache="$tmp/cache" --cache-stats | tail -1
+
+rm -rf "$tmp"
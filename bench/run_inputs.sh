@@ -0,0 +1,50 @@
+#!/bin/sh
+# A program run on many inputs: grc -O --run-inputs (one compilation, all the runs in one process) against
+# grc -O --exe once and the executable once per input. Both include the compilation, and the outputs are compared.
+# usage: bench/run_inputs.sh [inputs]
+cd "$(dirname "$0")/.."
+grc="$PWD/grc"
+inputs=${1:-200}
+tmp=$(mktemp -d)
+cd "$tmp"
+
+cat > sum.grc << 'EOF'
+fun main () : nothing
+  var n, i, s : int;
+  var a : int[100000];
+{
+  n <- readInteger();
+  i <- 0; s <- 0;
+  while i < n do { a[i] <- i * i mod 1000; s <- s + a[i]; i <- i + 1; }
+  writeInteger(s); writeChar('\n');
+}
+EOF
+i=0
+while [ $i -lt $inputs ]; do
+	echo $((i * 97 % 100000)) > in$i
+	i=$((i + 1))
+done
+
+start=$(date +%s%N)
+"$grc" -O --exe < sum.grc > sum && chmod +x sum || exit 1
+i=0
+while [ $i -lt $inputs ]; do
+	./sum < in$i > exe$i || exit 1
+	i=$((i + 1))
+done
+end=$(date +%s%N)
+exec_ms=$(( (end - start) / 1000000 ))
+
+start=$(date +%s%N)
+"$grc" -O --run-inputs sum.grc in* > /dev/null || exit 1
+end=$(date +%s%N)
+jit_ms=$(( (end - start) / 1000000 ))
+
+i=0
+while [ $i -lt $inputs ]; do
+	cmp -s exe$i in$i.out || echo "the outputs of in$i differ"
+	i=$((i + 1))
+done
+echo "$inputs inputs: $exec_ms ms with an exec per input, $jit_ms ms with --run-inputs"
+
+rm -rf "$tmp"
@@ -0,0 +1,35 @@
+#!/bin/sh
+# Source to executable latency through a warm grc --serve (and grc-client) next to a cold grc.py run,
+# with the p50/p99 the server measured for its own part.
+# usage: bench/serve_latency.sh [program.grc] [runs]
+cd "$(dirname "$0")/.."
+root="$PWD"
+prog="$PWD/${1:-bench/programs/typical.grc}"
+runs=${2:-100}
+tmp=$(mktemp -d)
+sock="$tmp/grc.sock"
+cd "$tmp"
+
+"$root/grc" --serve "$sock" 2> /dev/null &
+server=$!
+while [ ! -S "$sock" ]; do sleep 0.1; done
+
+for mode in -O0 -O; do
+	start=$(date +%s%N)
+	$root/grc.py $mode "$prog" > /dev/null || exit 1
+	end=$(date +%s%N)
+	awk -v m="$mode" -v t=$((end - start)) 'BEGIN { printf "%-4s grc.py     %8.2f ms/compile\n", m, t / 1000000 }'
+
+	start=$(date +%s%N)
+	i=0
+	while [ $i -lt $runs ]; do
+		"$root/grc-client" "$sock" $mode "$prog" || exit 1
+		i=$((i + 1))
+	done
+	end=$(date +%s%N)
+	awk -v m="$mode" -v t=$((end - start)) -v n=$runs 'BEGIN { printf "%-4s grc-client %8.2f ms/compile\n", m, t / n / 1000000 }'
+done
+"$root/grc-client" "$sock" --stats
+
+kill $server
+rm -rf "$tmp"
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Peak memory of grc with and without --stream on generated programs with more and more functions.
+# The functions are nested 100 to a group, so the biggest function stays the same size as the program grows.
+# usage: bench/stream_memory.sh [flags] (-O by default, -O -c for objects)
+cd "$(dirname "$0")/.."
+grc="$PWD/grc"
+flags=${*:--O}
+tmp=$(mktemp -d)
+cd "$tmp"
+
+for functions in 2000 8000 32000; do
+	awk -v n=$functions 'BEGIN {
+		groups = int((n + 99) / 100)
+		print "fun main () : nothing"
+		print "  var s : int;"
+		for (g = 0; g < groups; ++g) {
+			printf "  fun g%d (n : int) : int\n", g
+			print  "    var s : int;"
+			for (f = 0; f < 100; ++f) {
+				printf "    fun f%d (n : int) : int\n", f
+				print  "      var i, t : int;"
+				print  "      fun step (x : int) : int { if x mod 3 = 0 then return x div 3; return x * 2 + n; }"
+				printf "    { i <- 0; t <- %d; while i < n do { t <- (t + step(i)) mod 1000003; i <- i + 1; } return t; }\n", f + g
+			}
+			print "  {"
+			print "    s <- 0;"
+			for (f = 0; f < 100; ++f) printf "    s <- (s + f%d(n + %d)) mod 1000003;\n", f, f % 10
+			print "    return s;"
+			print "  }"
+		}
+		print "{"
+		print "  s <- 0;"
+		for (g = 0; g < groups; ++g) printf "  s <- (s + g%d(%d)) mod 1000003;\n", g, g % 10
+		print "  writeInteger(s);"
+		print "}"
+	}' > big.grc
+	for stream in "" --stream; do
+		python3 -c '
+import resource, subprocess, sys, time
+start = time.time()
+if subprocess.run(sys.argv[1], shell=True).returncode != 0: sys.exit(1)
+print("%6s functions %-9s %6d MB %8.1f s" % (sys.argv[2], sys.argv[3], resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss // 1024, time.time() - start))
+' "\"$grc\" $flags $stream < big.grc > /dev/null" $functions "${stream:-}" || exit 1
+	done
+done
+
+rm -rf "$tmp"
@@ -0,0 +1,13 @@
+# sourced by the benchmarks that time runs of a program
+# ms command: the average wall clock time of $runs runs of the command (its output is dropped, its input is empty
+# unless it redirects them) in milliseconds, with two decimals. A run that fails stops the benchmark.
+ms() {
+	start=$(date +%s%N)
+	i=0
+	while [ $i -lt $runs ]; do
+		eval "$1" > /dev/null < /dev/null || exit 1
+		i=$((i + 1))
+	done
+	end=$(date +%s%N)
+	awk -v t=$((end - start)) -v n=$runs 'BEGIN { printf "%.2f", t / n / 1000000 }'
+}
@@ -0,0 +1,64 @@
+#!/bin/sh
+# The array loops of functions nested in main, bounded by a variable of main (in the same frame as the arrays, so
+# without alias information every store to an array may change the bound and the loops can't be vectorized).
+# The IR of grc -O has to show them vectorized: the add of two int arrays because its refs are noalias, the
+# fill of a char array (whose ref isn't) because the tbaa tags keep its stores apart from the int bound. The
+# remarks of the refs and of the vectorizer are printed, and the outputs with and without -O are compared.
+# usage: bench/vectorize.sh [n] (at most 10000, the length of the arrays)
+cd "$(dirname "$0")/.."
+grc="$PWD/grc"
+n=${1:-10000}
+tmp=$(mktemp -d)
+cd "$tmp"
+
+cat > arrays.grc << 'EOF'
+fun main () : nothing
+  var n, i, s : int;
+  var x, y : int[10000];
+  var t : char[10000];
+
+  fun fill (ref u : char[]; c : char) : nothing; $ (declared first, so its ref isn't noalias)
+
+  fun add (ref a, b : int[]) : nothing
+    var i : int;
+  {
+    i <- 0;
+    while i < n do { a[i] <- a[i] + 3 * b[i]; i <- i + 1; }
+  }
+
+  fun fill (ref u : char[]; c : char) : nothing
+    var i : int;
+  {
+    i <- 0;
+    while i < n do { u[i] <- c; i <- i + 1; }
+  }
+{
+  n <- readInteger();
+  i <- 0;
+  while i < n do { x[i] <- i; y[i] <- i mod 7; i <- i + 1; }
+  i <- 0;
+  while i < 100 do { add(x, y); i <- i + 1; }
+  fill(t, 'a');
+  s <- 0; i <- 0;
+  while i < n do { s <- s + x[i] + ascii(t[i]); i <- i + 1; }
+  writeInteger(s); writeChar('\n');
+}
+EOF
+echo $n > arrays.in
+
+"$grc" -O '-Rpass=loop-vectorize|promote-refs' -Rpass-missed=promote-refs < arrays.grc > arrays.ll || exit 1
+status=0
+vectorized() { # the function $1 has vectors of $2 in the IR
+	sed -n "/^define internal void @main\.$1(/,/^}/p" arrays.ll > $1.ll
+	if grep -q "x $2>" $1.ll; then echo "$1: vectorized"; else echo "$1: not vectorized"; status=1; fi
+}
+grep -q '^define internal void @main\.add(.*noalias.*noalias' arrays.ll || { echo "add: its refs aren't noalias"; status=1; }
+vectorized add i64
+vectorized fill i8
+
+"$grc" --exe < arrays.grc > plain && "$grc" -O --exe < arrays.grc > optimized && chmod +x plain optimized || exit 1
+./plain < arrays.in > plain.out && ./optimized < arrays.in > optimized.out || exit 1
+cmp -s plain.out optimized.out || { echo "the outputs differ"; status=1; }
+
+rm -rf "$tmp"
+exit $status
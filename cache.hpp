@@ -0,0 +1,235 @@
+#ifndef __CACHE_HPP__
+#define __CACHE_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/SHA1.h>
+
+#include "session.hpp"
+
+inline std::string grc_directory() { // libgrc is next to grc
+	char path[4096];
+	const ssize_t n = readlink("/proc/self/exe", path, sizeof(path) - 1);
+	if(n <= 0) return "";
+	const std::string p(path, n);
+	return p.substr(0, p.find_last_of('/') + 1);
+}
+
+/* --cache[=dir]: a content addressed cache of compiled programs (IR, assembly, objects and executables)
+ * An entry is named after the hash of the normalized source, the options, the compiler (grc and llvm)
+ * and, for executables, libgrc. A hit skips the whole compilation.
+ * With -O the optimized functions are kept too, named after the hash of their fingerprint.
+ * Entries are written to a temporary file and renamed, so processes sharing the cache never see half
+ * written ones, and the least recently used entries are evicted once the cache outgrows its size.
+ */
+class compile_cache {
+	public:
+		compile_cache(const std::string &directory, const unsigned long long max_size)
+		: dir(directory), max_bytes(max_size), hits(0), misses(0) {
+			llvm::sys::fs::create_directories(dir);
+		}
+
+		static std::string default_directory() {
+			if(const char *d = getenv("GRC_CACHE_DIR")) return d;
+			if(const char *d = getenv("XDG_CACHE_HOME")) return std::string(d) + "/grc";
+			if(const char *d = getenv("HOME")) return std::string(d) + "/.cache/grc";
+			return "/tmp/grc-cache";
+		}
+
+		/* The same program always gets the same source, whatever its comments and its spacing.
+		 * Newlines stay where they are (after the single line comments they end, in place of the ones in
+		 * multiline comments) so line numbers don't change.
+		 */
+		static std::string normalize(const std::string &source) {
+			std::string n;
+			n.reserve(source.size());
+			bool space = false; // a run of spaces (written as one unless it's at the start or the end of a line)
+			for(size_t i = 0; i < source.size(); ) {
+				const char c = source[i];
+				if(c == ' ' || c == '\t' || c == '\r') { space = true; ++i; continue; }
+				if(c == '$' && i + 1 < source.size() && source[i + 1] == '$') { // multiline comment
+					const size_t end = source.find("$$", i + 2);
+					if(end == std::string::npos) { n.append(source, i, std::string::npos); break; } // a lexer error anyway
+					n.append(std::count(source.begin() + i, source.begin() + end, '\n'), '\n');
+					i = end + 2;
+					space = true;
+					continue;
+				}
+				if(c == '$') { // single line comment
+					i = source.find('\n', i);
+					if(i == std::string::npos) break;
+					continue;
+				}
+				if(c == '\n') { n += '\n'; space = false; ++i; continue; }
+				if(space && !n.empty() && n.back() != '\n') n += ' ';
+				space = false;
+				if(c == '"' || c == '\'') { // literals are kept as they are
+					size_t j = i + 1;
+					while(j < source.size() && source[j] != c && source[j] != '\n')
+						j += source[j] == '\\' ? 2 : 1;
+					j = std::min(j + 1, source.size());
+					n.append(source, i, j - i);
+					i = j;
+					continue;
+				}
+				n += c;
+				++i;
+			}
+			return n;
+		}
+
+		std::string key(const std::string &source, const compile_options &opts) const {
+			std::ostringstream k;
+			k << compiler_version() << '\0'
+			  << opts.optimize << opts.fast << opts.emit << opts.exe << (opts.threads > 0) << opts.stream << opts.debug << opts.profile_calls << opts.reentrant << opts.fork_server << opts.freestanding << opts.auto_memo << '\0' << opts.budget << '\0';
+			if(opts.exe) k << libgrc_version(opts.freestanding) << '\0';
+			k << opts.profile_generate << '\0';
+			if(!opts.profile_use.empty()) k << file_version(opts.profile_use) << '\0';
+			if(opts.debug != DEBUG_NONE) k << opts.file << '\0' << source; // the debug info has the columns too
+			else                         k << normalize(source);
+			return hash(k.str());
+		}
+		std::string function_key(const std::string &fingerprint, const compile_options &opts) const { // see Func_def::compile
+			std::ostringstream k;
+			k << compiler_version() << '\0'
+			  << opts.optimize << opts.fast << opts.emit << opts.profile_calls << (opts.budget != 0) << opts.auto_memo << '\0'
+			  << "function\0" << fingerprint;
+			return hash(k.str());
+		}
+
+		bool fetch(const std::string &k, std::string &out, const bool count_miss=true) { // (not if another lookup follows)
+			const std::string path = dir + '/' + k;
+			std::ifstream f(path, std::ios::binary);
+			if(!f) {
+				if(count_miss) count(false);
+				return false;
+			}
+			out.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+			utimensat(AT_FDCWD, path.c_str(), nullptr, 0); // recently used
+			count(true);
+			return true;
+		}
+
+		void store(const std::string &k, const std::string &data) {
+			std::string tmp = dir + "/tmp.XXXXXX";
+			const int fd = mkstemp(&tmp[0]);
+			if(fd < 0) return;
+			const bool written = write(fd, data.data(), data.size()) == (ssize_t)data.size();
+			close(fd);
+			if(!written || rename(tmp.c_str(), (dir + '/' + k).c_str()) != 0) {
+				unlink(tmp.c_str());
+				return;
+			}
+			evict();
+		}
+
+		/* the hits and misses of this process, then those of the cache since it was created and its size */
+		std::string report() {
+			unsigned long long total_hits = 0, total_misses = 0, size = 0;
+			const std::vector<entry> e = entries(size);
+			read_counters(total_hits, total_misses);
+			std::ostringstream r;
+			r << "cache: hits " << hits << " misses " << misses << '\n'
+			  << "cache " << dir << ": hits " << total_hits << " misses " << total_misses
+			  << " entries " << e.size() << " size " << size << " bytes\n";
+			return r.str();
+		}
+	private:
+		static std::string hash(const std::string &s) {
+			return llvm::toHex(llvm::SHA1::hash(llvm::ArrayRef<uint8_t>((const uint8_t*)s.data(), s.size())), true);
+		}
+
+		struct entry {
+			std::string path;
+			time_t used;
+			unsigned long long size;
+		};
+
+		std::vector<entry> entries(unsigned long long &size) const {
+			std::vector<entry> e;
+			size = 0;
+			DIR *d = opendir(dir.c_str());
+			if(d == nullptr) return e;
+			while(const dirent *f = readdir(d)) {
+				struct stat s;
+				const std::string path = dir + '/' + f->d_name;
+				if(strlen(f->d_name) != 40 || stat(path.c_str(), &s) != 0) continue; // only entries (named by their hash)
+				e.push_back({path, s.st_mtime, (unsigned long long)s.st_size});
+				size += s.st_size;
+			}
+			closedir(d);
+			return e;
+		}
+
+		void evict() {
+			unsigned long long size;
+			std::vector<entry> e = entries(size);
+			if(size <= max_bytes) return;
+			std::sort(e.begin(), e.end(), [](const entry &a, const entry &b) { return a.used < b.used; });
+			for(const entry &old : e) {
+				if(size <= max_bytes) break;
+				if(unlink(old.path.c_str()) == 0) size -= old.size; // or another process evicted it first
+			}
+		}
+
+		void count(const bool hit) { // in the stats file of the cache too, under a lock since many processes can share it
+			++(hit ? hits : misses);
+			const int fd = open((dir + "/stats").c_str(), O_RDWR | O_CREAT, 0644);
+			if(fd < 0) return;
+			flock(fd, LOCK_EX);
+			unsigned long long c[2] = {0, 0};
+			if(pread(fd, c, sizeof(c), 0) != sizeof(c)) c[0] = c[1] = 0;
+			++c[hit ? 0 : 1];
+			pwrite(fd, c, sizeof(c), 0);
+			flock(fd, LOCK_UN);
+			close(fd);
+		}
+		void read_counters(unsigned long long &h, unsigned long long &m) const {
+			const int fd = open((dir + "/stats").c_str(), O_RDONLY);
+			unsigned long long c[2] = {0, 0};
+			if(fd >= 0) {
+				flock(fd, LOCK_SH);
+				if(pread(fd, c, sizeof(c), 0) != sizeof(c)) c[0] = c[1] = 0;
+				flock(fd, LOCK_UN);
+				close(fd);
+			}
+			h = c[0];
+			m = c[1];
+		}
+
+		static std::string file_version(const std::string &path) { // a rebuilt file is a new version
+			struct stat s;
+			if(stat(path.c_str(), &s) != 0) return path;
+			return path + ' ' + std::to_string(s.st_size) + ' ' + std::to_string(s.st_mtim.tv_sec) + '.' + std::to_string(s.st_mtim.tv_nsec);
+		}
+		static const std::string &compiler_version() {
+			static const std::string v = file_version("/proc/self/exe") + " llvm " LLVM_VERSION_STRING;
+			return v;
+		}
+		static const std::string &libgrc_version(const bool freestanding) {
+			static const std::string v = file_version(grc_directory() + "libgrc/libgrc.a"), f = file_version(grc_directory() + "libgrc/libgrc-freestanding.a");
+			return freestanding ? f : v;
+		}
+
+		const std::string dir;
+		const unsigned long long max_bytes;
+		std::atomic<unsigned long long> hits, misses;
+};
+
+#endif
@@ -0,0 +1,132 @@
+/* grc-client: thin client of grc --serve, for callers that can't afford starting grc.py (and grc) per program
+ *
+ *   grc-client <socket> [-O | -O0 | -Og] [-g] [-i | -f] [--frame-layout] program.grc
+ *   grc-client <socket> --stats
+ *
+ * Like grc.py: -i prints the IR, -f the assembly, otherwise the executable is written in the current directory.
+ * Diagnostics go to stderr and the exit status is the one of the compilation.
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static void fail(const char *msg) {
+	perror(msg);
+	exit(1);
+}
+
+static void send_all(int fd, const char *buf, size_t n) {
+	while(n > 0) {
+		ssize_t k = write(fd, buf, n);
+		if(k <= 0) fail("send");
+		buf += k;
+		n   -= k;
+	}
+}
+
+static void recv_all(int fd, char *buf, size_t n) {
+	while(n > 0) {
+		ssize_t k = read(fd, buf, n);
+		if(k <= 0) fail("receive");
+		buf += k;
+		n   -= k;
+	}
+}
+
+static char *read_file(const char *path, size_t *size) {
+	FILE *f = fopen(path, "rb");
+	if(f == NULL) fail(path);
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	rewind(f);
+	char *buf = malloc(*size + 1);
+	if(fread(buf, 1, *size, f) != *size) fail(path);
+	fclose(f);
+	return buf;
+}
+
+int main(int argc, char **argv) {
+	if(argc < 3) {
+		fprintf(stderr, "usage: %s <socket> [flags] program.grc | --stats\n", argv[0]);
+		return 1;
+	}
+
+	char options[PATH_MAX + 256] = "";
+	const char *input = NULL;
+	char profile[PATH_MAX];
+	int ir = 0, assembly = 0;
+	for(int i = 2; i < argc; ++i) {
+		const char *opt = argv[i];
+		if(!strcmp(opt, "-i"))      ir       = 1;
+		else if(!strcmp(opt, "-f")) assembly = 1;
+		else if(opt[0] != '-')      input    = opt;
+		else if(!strncmp(opt, "-fprofile-use=", 14) && realpath(opt + 14, profile) != NULL
+		        && strlen(options) + strlen(profile) + 24 < sizeof(options)) { // the server reads it from its own directory
+			strcat(options, " -fprofile-use=");
+			strcat(options, profile);
+		}
+		else if(strlen(options) + strlen(opt) + 8 < sizeof(options)) { // passed to grc as they are
+			strcat(options, " ");
+			strcat(options, opt);
+		}
+	}
+	const int stats = strstr(options, "--stats") != NULL;
+	if(!stats && input == NULL) {
+		fprintf(stderr, "no input file\n");
+		return 1;
+	}
+	if(!stats) strcat(options, ir ? "" : assembly ? " -S" : " --exe");
+	char path[PATH_MAX];
+	if(!stats && (strstr(options, " -g") != NULL || strstr(options, " -R") != NULL || strstr(options, " -fsave-optimization-record") != NULL)
+	   && realpath(input, path) != NULL && strlen(options) + strlen(path) + 8 < sizeof(options)) {
+		strcat(options, " --file="); // the server only gets the source (and the records go next to it)
+		strcat(options, path);
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	strncpy(addr.sun_path, argv[1], sizeof(addr.sun_path) - 1);
+	if(fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) fail(argv[1]);
+
+	size_t size = 0;
+	char *source = stats ? NULL : read_file(input, &size);
+	char header[sizeof(options) + 64];
+	int n = snprintf(header, sizeof(header), "%s\n%zu\n", stats ? "--stats" : options + (options[0] == ' '), size);
+	send_all(fd, header, n);
+	send_all(fd, source, size);
+
+	// "<status> <output size> <diagnostics size>\n"
+	int status;
+	size_t output_size, diag_size, got = 0;
+	char line[64];
+	do recv_all(fd, line + got, 1); while(line[got++] != '\n' && got < sizeof(line) - 1);
+	line[got] = '\0';
+	if(sscanf(line, "%d %zu %zu", &status, &output_size, &diag_size) != 3) {
+		fprintf(stderr, "bad response from grc\n");
+		return 1;
+	}
+	char *output = malloc(output_size + 1), *diag = malloc(diag_size + 1);
+	recv_all(fd, output, output_size);
+	recv_all(fd, diag,   diag_size);
+	close(fd);
+	fwrite(diag, 1, diag_size, stderr);
+
+	if(stats || ir || assembly) fwrite(output, 1, output_size, stdout);
+	else if(status == 0) { // named like grc.py names it
+		const char *base = strrchr(input, '/');
+		char name[256];
+		snprintf(name, sizeof(name), "%s", base == NULL ? input : base + 1);
+		char *dot = strchr(name, '.');
+		if(dot != NULL) *dot = '\0';
+		FILE *f = fopen(name, "wb");
+		if(f == NULL || fwrite(output, 1, output_size, f) != output_size) fail(name);
+		fclose(f);
+		chmod(name, 0755);
+	}
+	return status;
+}
@@ -0,0 +1,124 @@
+#ifndef __DEBUG_HPP__
+#define __DEBUG_HPP__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/BinaryFormat/Dwarf.h>
+#include <llvm/IR/DIBuilder.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+
+#include "session.hpp"
+
+/* -g: DWARF for the Grace source, so gdb, perf and llvm-cov see Grace functions and lines instead of addresses.
+ * Every function is a subprogram (with its Grace name, the dotted llvm name is its linkage name), the code of
+ * every statement gets the line and column the statement starts at and every nested block is a lexical block.
+ * Variables and parameters live in the stack frame, so they are described as an offset in it (the ones of
+ * main are static variables of main, since its frame is mains_stack_frame).
+ * -gline-tables-only leaves out the variables, the types and the blocks, it only maps the code to lines.
+ * Without -g the remarks (see remarks.hpp) still need the lines: the compile unit then emits no DWARF at all.
+ */
+class debug_info {
+	public:
+		debug_info(llvm::Module &m, const compile_options &opts) : builder(m), full(opts.debug == DEBUG_FULL) {
+			llvm::SmallString<256> path(opts.file);
+			if(opts.file != "<stdin>") llvm::sys::fs::make_absolute(path);
+			file = builder.createFile(llvm::sys::path::filename(path), llvm::sys::path::parent_path(path));
+			unit = builder.createCompileUnit(llvm::dwarf::DW_LANG_Pascal83, file, "grc", opts.optimize, "", 0, "",
+				full ? llvm::DICompileUnit::FullDebug : opts.debug == DEBUG_LINES ? llvm::DICompileUnit::LineTablesOnly : llvm::DICompileUnit::NoDebug);
+			add_flags(m);
+		}
+
+		/* for a module other than the one the debug info is built in (the chunks of --stream) */
+		void add_to(llvm::Module &m) const {
+			m.getOrInsertNamedMetadata("llvm.dbg.cu")->addOperand(unit);
+			add_flags(m);
+		}
+
+		void begin_function(llvm::Function* const f, const char* const name, const int line, const int column, const int body_line) {
+			llvm::DISubprogram::DISPFlags flags = llvm::DISubprogram::SPFlagDefinition;
+			if(f->hasLocalLinkage())       flags |= llvm::DISubprogram::SPFlagLocalToUnit;
+			if(unit->isOptimized())        flags |= llvm::DISubprogram::SPFlagOptimized;
+			const llvm::StringRef linkage = f->getName() == name ? "" : f->getName();
+			llvm::Type* const rt = f->getReturnType();
+			llvm::DIType* const ret = full && !rt->isVoidTy() ? type(rt) : nullptr;
+			llvm::DISubprogram* const sp = builder.createFunction(file, name, linkage, file, line,
+				builder.createSubroutineType(builder.getOrCreateTypeArray({ret})), body_line, llvm::DINode::FlagPrototyped, flags);
+			f->setSubprogram(sp);
+			scopes.push_back(sp);
+			at(line, column); // the prologue (the stack frame) is at the header
+		}
+		void end_function(llvm::Function* const f) {
+			builder.finalizeSubprogram(f->getSubprogram());
+			scopes.pop_back();
+			session->Builder.SetCurrentDebugLocation(llvm::DebugLoc());
+		}
+
+		void begin_block(const int line, const int column) { if(full) scopes.push_back(builder.createLexicalBlock(scopes.back(), file, line, column)); }
+		void end_block() { if(full) scopes.pop_back(); }
+
+		/* the code generated from now on comes from line:column */
+		void at(const int line, const int column) {
+			session->Builder.SetCurrentDebugLocation(llvm::DILocation::get(session->TheContext, line, column, scopes.back()));
+		}
+
+		/* a field of the stack frame frame, arg is its number if it's a parameter (0 otherwise) */
+		void variable(const std::string &name, llvm::Type* const t, llvm::Type* const base_type, const int line, const unsigned arg,
+		              llvm::Value* const frame, const unsigned long long offset) {
+			if(!full) return;
+			llvm::DIScope* const scope = scopes.back();
+			llvm::DIExpression* const in_frame = builder.createExpression(llvm::SmallVector<uint64_t, 2>{llvm::dwarf::DW_OP_plus_uconst, offset});
+			if(llvm::GlobalVariable* const msf = llvm::dyn_cast<llvm::GlobalVariable>(frame)) {
+				msf->addDebugInfo(builder.createGlobalVariableExpression(scope, name, "", file, line, type(t, base_type), true, true, in_frame));
+				return;
+			}
+			llvm::DILocalVariable* const v = arg > 0 ? builder.createParameterVariable(scope, name, arg, file, line, type(t, base_type), true)
+			                                         : builder.createAutoVariable(scope, name, file, line, type(t, base_type), true);
+			builder.insertDeclare(frame, v, in_frame, llvm::DILocation::get(session->TheContext, line, 0, scope), session->Builder.GetInsertBlock());
+		}
+
+		void finalize() { builder.finalize(); }
+	private:
+		void add_flags(llvm::Module &m) const {
+			if(m.getModuleFlag("Debug Info Version") != nullptr) return;
+			m.addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+			m.addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+		}
+
+		/* base_type is what a reference (a ref parameter) points to. int[] parameters are references
+		 * to arrays of one element (see Fpar_def::make_args) so that's what they look like.
+		 */
+		llvm::DIType* type(llvm::Type* const t, llvm::Type* const base_type=nullptr) {
+			if(base_type != nullptr) return builder.createReferenceType(llvm::dwarf::DW_TAG_reference_type, type(base_type), 64);
+			llvm::DIType *&d = types[t];
+			if(d != nullptr) return d;
+			if(t->isArrayTy()) { // one array type with a subrange for every dimension
+				std::vector<llvm::Metadata*> subscripts;
+				llvm::Type *e = t;
+				for(; e->isArrayTy(); e = e->getArrayElementType())
+					subscripts.push_back(builder.getOrCreateSubrange(0, e->getArrayNumElements()));
+				const uint64_t bits = e->getPrimitiveSizeInBits();
+				uint64_t size = bits;
+				for(llvm::Type *a = t; a->isArrayTy(); a = a->getArrayElementType()) size *= a->getArrayNumElements();
+				d = builder.createArrayType(size, bits, type(e), builder.getOrCreateArray(subscripts));
+			}
+			else if(t == session->i8) d = builder.createBasicType("char", 8,  llvm::dwarf::DW_ATE_signed_char);
+			else                      d = builder.createBasicType("int",  64, llvm::dwarf::DW_ATE_signed);
+			return d;
+		}
+
+		llvm::DIBuilder                    builder;
+		const bool                         full;
+		llvm::DIFile                       *file;
+		llvm::DICompileUnit                *unit;
+		std::vector<llvm::DIScope*>        scopes; // the function (and the blocks in it) the code is generated for
+		std::map<llvm::Type*, llvm::DIType*> types;
+};
+
+#endif
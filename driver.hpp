@@ -0,0 +1,164 @@
+#ifndef __DRIVER_HPP__
+#define __DRIVER_HPP__
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "cache.hpp"
+#include "session.hpp"
+
+/* writes data to a new temporary file named /tmp/grc-XXXXXX<suffix>, returns its name ("" if it can't) */
+inline std::string write_temporary(const std::string &data, const char* const suffix) {
+	std::string path = std::string("/tmp/grc-XXXXXX") + suffix;
+	const int fd = mkstemps(&path[0], strlen(suffix));
+	if(fd < 0) return "";
+	const bool written = write(fd, data.data(), data.size()) == (ssize_t)data.size();
+	close(fd);
+	if(written) return path;
+	unlink(path.c_str());
+	return "";
+}
+
+/* runs "linker -o output <the files> rest" */
+inline int link_files(const std::string &linker, const std::vector<std::string> &files, const std::string &rest,
+                      const std::string &output, std::ostream &diag) {
+	std::string cmd = linker + " -o " + output;
+	for(const std::string &f : files) cmd += ' ' + f;
+	if(output.empty() || system((cmd + ' ' + rest).c_str()) != 0 || access(output.c_str(), R_OK) != 0) {
+		diag << "linking failed" << std::endl;
+		unlink(output.c_str());
+		return 1;
+	}
+	return 0;
+}
+
+/* runs "linker -o output <the objects> rest" and replaces code with the output */
+inline int link_with(const std::string &linker, const std::vector<std::string> &objects, const std::string &rest,
+                     const std::string &output, std::string &code, std::ostream &diag) {
+	std::vector<std::string> files;
+	for(const std::string &o : objects) {
+		files.push_back(write_temporary(o, ".o"));
+		if(files.back().empty()) {
+			diag << "can't create a temporary file" << std::endl;
+			break;
+		}
+	}
+	const int status = files.back().empty() ? 1 : link_files(linker, files, rest, output, diag);
+	for(const std::string &f : files) if(!f.empty()) unlink(f.c_str());
+	if(status != 0) return status;
+	std::ifstream f(output, std::ios::binary);
+	code.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+	unlink(output.c_str());
+	return 0;
+}
+
+/* writes the file to out a block at a time and removes it */
+inline void copy_out(const std::string &path, llvm::raw_ostream &out) {
+	std::ifstream f(path, std::ios::binary);
+	char block[1 << 16];
+	while(f.read(block, sizeof(block)) || f.gcount() > 0) out.write(block, f.gcount());
+	unlink(path.c_str());
+}
+
+/* how an executable is linked: with libgrc and libc (dynamically), or with --freestanding statically with the
+ * runtime of libgrc/freestanding alone, which has its own _start */
+inline const char *exe_linker(const compile_options &opts) { return opts.freestanding ? "clang -Wall -static -nostdlib" : "clang -Wall"; }
+inline std::string runtime_lib(const compile_options &opts) {
+	return grc_directory() + (opts.freestanding ? "libgrc/libgrc-freestanding.a" : "libgrc/libgrc.a");
+}
+
+/* the object in code is replaced by the executable */
+inline int link_executable(std::string &code, const compile_options &opts, std::ostream &diag) {
+	const std::string exe = write_temporary("", "");
+	return link_with(exe_linker(opts), {code}, runtime_lib(opts), exe, code, diag);
+}
+
+/* the objects (the partitions of a module) are linked into one, in their order, and their hidden symbols become local again */
+inline int link_relocatable(const std::vector<std::string> &objects, std::string &code, std::ostream &diag) {
+	const std::string obj = write_temporary("", ".o");
+	return link_with("ld -r", objects, "&& objcopy --localize-hidden " + obj, obj, code, diag);
+}
+
+/* --stream from in to out (stdin and stdout): neither the program nor what it's compiled to is ever kept in memory */
+inline int compile_stream(compile_options opts, FILE* const in, llvm::raw_ostream &out, std::ostream &diag) {
+	if(!opts.exe) {
+		compiler_session s(opts, out, diag);
+		return s.compile(in);
+	}
+	opts.emit = EMIT_OBJ;
+	const std::string object = write_temporary("", ".o"), exe = write_temporary("", "");
+	int status = 1;
+	if(!object.empty()) {
+		std::error_code error;
+		llvm::raw_fd_ostream o(object, error);
+		compiler_session s(opts, o, diag);
+		status = error ? 1 : s.compile(in);
+	}
+	if(status == 0) status = link_files(exe_linker(opts), {object}, runtime_lib(opts), exe, diag);
+	if(status == 0) copy_out(exe, out);
+	unlink(object.c_str());
+	unlink(exe.c_str());
+	return status;
+}
+
+/* --interp: the program (the first of files, or stdin) is checked and run right away, with grc's stdin as its input */
+inline int interpret_program(compile_options opts, const std::vector<std::string> &files, std::ostream &diag) {
+	FILE* const in = files.empty() ? stdin : fopen(files[0].c_str(), "r");
+	if(in == nullptr) {
+		diag << "can't read " << files[0] << ": " << strerror(errno) << std::endl;
+		return 1;
+	}
+	if(!files.empty() && opts.file == "<stdin>") opts.file = files[0];
+	opts.stream = false;
+	compiler_session s(opts, llvm::nulls(), diag);
+	const int status = s.compile(in);
+	if(in != stdin) fclose(in);
+	return status;
+}
+
+/* Compiles source (a whole program) to output and returns the exit status, like grc does with stdin and stdout.
+ * With a cache, a hit skips everything and a miss stores what it produced: an executable is stored
+ * together with its object, so compiling the same program to an object (or linking it again) hits too.
+ * On a miss the functions that didn't change are still taken from the cache (see Func_def::compile).
+ * A compile is one hit or one miss in the stats, whichever of the keys it looked up.
+ * target is a target machine to lend to the session (see --serve).
+ */
+inline int compile_source(std::string &source, compile_options opts, std::string &output, std::ostream &diag,
+                          compile_cache* const cache=nullptr, llvm::TargetMachine* const target=nullptr) {
+	if(opts.exe) opts.emit = EMIT_OBJ;
+	const bool cached = cache != nullptr && !opts.frame_layout && !opts.remarks(); // a hit wouldn't print the report (or the remarks)
+	std::string key;
+	if(cached) {
+		key = cache->key(source, opts);
+		if(cache->fetch(key, output, !opts.exe)) return 0; // (an executable looks up its object next)
+	}
+
+	compile_options object_opts = opts;
+	object_opts.exe = false;
+	const std::string object_key = cached && opts.exe ? cache->key(source, object_opts) : "";
+	int status = 0;
+	if(object_key.empty() || !cache->fetch(object_key, output)) {
+		if(source.empty()) source = "\n"; // fmemopen doesn't take empty buffers
+		FILE *in = fmemopen(&source[0], source.size(), "r");
+		llvm::raw_string_ostream out(output);
+		compiler_session s(opts, out, diag);
+		s.target = target;
+		s.cache  = cached ? cache : nullptr;
+		status = s.compile(in);
+		fclose(in);
+		out.flush();
+		if(status == 0 && !object_key.empty()) cache->store(object_key, output);
+	}
+	if(status == 0 && opts.exe) status = link_executable(output, opts, diag);
+	if(status == 0 && cached) cache->store(key, output);
+	return status;
+}
+
+#endif
@@ -6,21 +6,90 @@ flags = {
     'O': '',
     'i': '',
     'f': '',
+    'j': '', # -jN: objects are generated on N threads
+    'g': '', # -g or -gline-tables-only: debug info
+    'p': '', # -pg: call counts and times
 }
+long_flags = '' # passed to grc as they are
+profile    = '' # -fprofile-generate[=file] or -fprofile-use=file
+remarks    = '' # -Rpass*=regex, -fsave-optimization-record[=format] and -foptimization-record-file=file
+optimise   = '' # -fauto-memo
+inputs     = []
 
 for arg in argv[1:]:
-    if arg[0] == '-': flags[arg[1]] = arg
-    else:                input_file = arg
+    if   arg[:2] == '--': long_flags += ' ' + arg
+    elif arg.startswith('-fprofile-'): profile = arg
+    elif arg.startswith('-R') or arg.startswith('-fsave-optimization-record') or arg.startswith('-foptimization-record-file='): remarks += ' ' + arg
+    elif arg == '-fauto-memo': optimise += ' ' + arg
+    elif arg[0]  == '-':  flags[arg[1]] = arg
+    else:                 inputs.append(arg)
+
+def absolute(f): return f if f[0] == '/' else getcwd() + '/' + f
+
+grc_flags = flags['O'] + (' ' + flags['j'] if flags['j'] != '' else '') + (' ' + flags['p'] if flags['p'] != '' else '')
+if flags['g'] != '': grc_flags += ' ' + flags['g']
+grc_flags += remarks + optimise
+if (flags['g'] != '' or remarks != '') and inputs and '--batch' not in long_flags:
+    grc_flags += ' --file=' + absolute(inputs[-1]) # grc reads it from stdin (the records go next to it)
+
+if profile.startswith('-fprofile-use='): # (the file the instrumented program writes is relative to where it runs)
+    grc_flags += ' -fprofile-use=' + absolute(profile[14:])
+elif profile != '':
+    grc_flags += ' ' + profile
+
+# with --cache grc links the executables itself so they can be cached too
+cached = '--cache' in long_flags
+
+# with --freestanding the executables are linked statically with a runtime without libc (and its own _start)
+link    = 'clang -Wall -static -nostdlib' if '--freestanding' in long_flags else 'clang -Wall'
+runtime = 'libgrc/libgrc-freestanding.a' if '--freestanding' in long_flags else 'libgrc/libgrc.a'
+
+if '--batch' in long_flags: # one grc compiles all the files (or @manifests) on many threads
+    from subprocess         import run, PIPE
+    from concurrent.futures import ThreadPoolExecutor
+    grc_dir = absolute(__file__)[:-6]
+    files   = ' '.join('@' + absolute(f[1:]) if f[0] == '@' else absolute(f) for f in inputs)
+    emit    = '' if flags['i'] != '' else ' -S' if flags['f'] != '' else ' --exe' if cached else ' -c' # to name.ll, name.s, name or name.o in the callers directory
+    grc     = run(f"{grc_dir}grc {grc_flags}{long_flags}{emit} {files}", shell=True, stdout=PIPE, text=True)
+    results = [line.rsplit(' ', 1) for line in grc.stdout.splitlines()]
+
+    def link(result):
+        file, status = result[0], int(result[1])
+        if status == 0 and emit == ' -c':
+            name   = file.split('/')[-1].split('.')[0]
+            status = system(f"{link} -o {name} {name}.o {grc_dir}{runtime}; e=$?; rm -f {name}.o; exit $e") >> 8
+        return file, status
+
+    worst = 0
+    with ThreadPoolExecutor() as pool:
+        for file, status in pool.map(link, results):
+            print(f"{file}: {status}")
+            worst = max(worst, status)
+    exit(worst)
+
+if '--interp' in long_flags: # grc runs the program itself, in the callers directory and with its stdin
+    if not inputs: exit('usage: grc.py --interp [flags] program.grc (the program reads the input of grc.py)')
+    exit(system(f"{absolute(__file__)[:-6]}grc{long_flags} {absolute(inputs[-1])}") >> 8)
+if '--run-inputs' in long_flags: # the program is the first file, the outputs go next to the inputs
+    exit(system(f"{absolute(__file__)[:-6]}grc {grc_flags}{long_flags} {' '.join(absolute(f) for f in inputs)}") >> 8)
 
 # can be called from any directory
-cmd = f"cd {__file__[:-6]}; ./grc {flags['O']}"
+cmd = f"cd {__file__[:-6]}; ./grc {grc_flags}{long_flags}"
+
+# -O0 and -Og compile fast: grc generates the final code itself so no .ll or .s files are written
+fast = flags['O'] in ('-O0', '-Og')
 
 if   flags['i'] != '': pass
-elif flags['f'] != '': cmd += ' | llc'
+elif flags['f'] != '': cmd += ' -S' if fast else ' | llc'
 else: # input file can be in any directory and output file will be in the callers directory
+    input_file = inputs[-1]
     name = getcwd() + '/' + input_file.split('/')[-1].split('.')[0]
-    if input_file[0] != '/': input_file = getcwd() + '/' + input_file
-    cmd += f" < {input_file} > {name}.ll; clang -S {name}.ll -o {name}.s; clang -Wall -o {name} {name}.s libgrc/libgrc.a"
+    input_file = absolute(input_file)
+    if cached: cmd += f" --exe < {input_file} > {name}; e=$?; [ $e = 0 ] && chmod +x {name} || rm -f {name}; exit $e"
+    elif fast: cmd += f" -c < {input_file} > {name}.o && {link} -o {name} {name}.o {runtime}; e=$?; rm -f {name}.o; exit $e"
+    else: # (with a profile the backend lays out the blocks after it)
+        llc = 'clang -O2 -S' if profile.startswith('-fprofile-use=') else 'clang -S'
+        cmd += f" < {input_file} > {name}.ll; {llc} {name}.ll -o {name}.s; {link} -o {name} {name}.s {runtime}"
 
 # perserve the exit code
 exit(system(cmd) >> 8)
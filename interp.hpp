@@ -0,0 +1,360 @@
+#ifndef __INTERP_HPP__
+#define __INTERP_HPP__
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sys/mman.h>
+
+/* grc --interp: the checked tree is lowered to the bytecode of a register machine (see the lower methods of the
+ * nodes) and run right away by the threaded interpreter below, without llvm. Every call gets a frame laid out
+ * like the stack frame of the compiled code (see Func_def::generate_stack_frame): the static link, then the
+ * parameters and the variables (with the arrays in place), and the temporaries of the function after them.
+ * The slots of the frame are the registers of the instructions, 8 bytes each (chars are sign extended, and their
+ * low byte is the one a ref or a nested function sees). The runtime lib is libgrc itself, which grc is linked with.
+ * A division where the compiled code would trap (by zero) stops the program with the line of its statement.
+ */
+
+extern "C" {
+	void writeInteger(long long n);
+	void writeChar(char c);
+	void writeString(const char *s);
+	long long readInteger(void);
+	char readChar(void);
+	void readString(long long n, char *s);
+}
+
+enum bc_op {
+	BC_MOVI, BC_MOV, BC_ADD, BC_ADDI, BC_SUB, BC_MUL, BC_DIV, BC_MOD, BC_NEG, BC_SEXT8,
+	BC_ADDR, BC_ADDRUP, BC_FRAMEUP, BC_INDEX, BC_LD8, BC_LD64, BC_ST8, BC_ST64, BC_STR,
+	BC_JMP, BC_JEQ, BC_JNE, BC_JLT, BC_JLE, BC_JGT, BC_JGE, BC_JEQI, BC_JNEI, BC_JLTI, BC_JLEI, BC_JGTI, BC_JGEI,
+	BC_CALL, BC_RET, BC_RETV, BC_HALT,
+	BC_WRITEI, BC_WRITEC, BC_WRITES, BC_READI, BC_READC, BC_READS, BC_STRLEN, BC_STRCMP, BC_STRCPY, BC_STRCAT,
+	BC_OPS
+};
+
+struct bc_insn {
+	union {
+		long       op;
+		const void *handler; // (once the program is prepared)
+	};
+	int       a, b, c; // registers (a jump with an immediate compares a with b)
+	long long k;       // an immediate, or what a jump, call or string refers to (an index, then a pointer)
+};
+
+struct bc_function {
+	std::vector<bc_insn> code;
+	unsigned          regs   = 1; // the size of its frame, in slots (the static link is the first)
+	unsigned          params = 0;
+	std::vector<bool> ref;        // which parameters are passed by reference
+	bool              value;      // whether it returns one
+};
+
+/* a name the code being lowered can see */
+struct bc_name {
+	bool     fun;
+	unsigned level; // of the function a variable belongs to, or a function is defined in
+	int      index; // the register of a variable, the bc_function of a function
+	bool     is_char = false, ref = false;
+	std::vector<unsigned long long> sizes; // of an array (the first is 0 if it's unknown)
+};
+
+class bytecode {
+	public:
+		/* lowering: functions, then what's in them */
+		int declare_function(const char* const name, const std::vector<bool> &ref, const bool value) {
+			auto f = scopes.back().find(name);
+			if(f != scopes.back().end() && f->second.fun) return f->second.index; // (it was declared)
+			functions.emplace_back();
+			bc_function &bf = functions.back();
+			bf.params = ref.size();
+			bf.ref    = ref;
+			bf.value  = value;
+			scopes.back()[name] = bc_name{true, level(), (int)functions.size() - 1, false, false, {}};
+			return functions.size() - 1;
+		}
+		void begin_function(const char* const name, const std::vector<bool> &ref, const bool value) {
+			const int f = declare_function(name, ref, value);
+			open.push_back({f, 1, 1, 1, {}, {}});
+			scopes.emplace_back();
+		}
+		void end_function() {
+			open_function &o = open.back();
+			if(o.index == 0) emit(BC_HALT);
+			else if(!functions[o.index].value) emit(BC_RETV);
+			else emit(BC_RET, constant(0)); // (see create_default_ret)
+			bc_function &f = functions[o.index];
+			for(const auto &j : o.jumps) f.code[j.first].k = o.labels[j.second];
+			f.regs = o.regs;
+			open.pop_back();
+			scopes.pop_back();
+		}
+		void variable(const char* const name, const bool is_char, const bool ref, std::vector<unsigned long long> sizes) {
+			unsigned long long slots = 1;
+			if(!ref && !sizes.empty()) {
+				unsigned long long bytes = is_char ? 1 : 8;
+				for(const auto &n : sizes) bytes *= n;
+				slots = (bytes + 7) / 8;
+			}
+			open_function &o = open.back();
+			scopes.back()[name] = bc_name{false, level(), (int)o.top, is_char, ref, std::move(sizes)};
+			o.top  += slots;
+			o.regs  = std::max(o.regs, o.top);
+		}
+		const bc_name* lookup(const char* const name) const {
+			for(auto s = scopes.rbegin(); s != scopes.rend(); ++s) {
+				auto n = s->find(name);
+				if(n != s->end()) return &n->second;
+			}
+			return nullptr; // (the runtime lib)
+		}
+		unsigned level() const { return open.size(); }
+		const bc_function& function(const int index) const { return functions[index]; }
+
+		/* temporaries are taken after the variables, and given back after every statement */
+		int temp(const unsigned n = 1) {
+			open_function &o = open.back();
+			const int t = o.top;
+			o.top += n;
+			o.regs = std::max(o.regs, o.top);
+			return t;
+		}
+		unsigned temps() const { return open.back().top; }
+		void release(const unsigned top) { open.back().top = top; }
+		bool is_temp(const int reg) const { return reg >= (int)open.back().vars; }
+		void end_variables() { open.back().vars = open.back().top; }
+
+		int label() {
+			open.back().labels.push_back(-1);
+			return open.back().labels.size() - 1;
+		}
+		void bind(const int l) { open.back().labels[l] = functions[open.back().index].code.size(); }
+
+		/* the line of the statement being lowered, that a division keeps for its runtime error */
+		void at(const int l) { current_line = l; }
+		int line() const { return current_line; }
+
+		void emit(const bc_op op, const int a = 0, const int b = 0, const int c = 0, const long long k = 0) {
+			bc_insn i;
+			i.op = op;
+			i.a = a; i.b = b; i.c = c; i.k = k;
+			functions[open.back().index].code.push_back(i);
+		}
+		void jump(const bc_op op, const int l, const int a = 0, const int b = 0) {
+			open.back().jumps.emplace_back(functions[open.back().index].code.size(), l);
+			emit(op, a, b);
+		}
+		void move(const int dst, const int src) { // (the instruction that computed a temporary can write dst itself)
+			std::vector<bc_insn> &code = functions[open.back().index].code;
+			const open_function &o = open.back();
+			if(is_temp(src) && !code.empty() && code.back().a == src && writes_a(code.back().op)
+			   && std::find(o.labels.begin(), o.labels.end(), (long)code.size()) == o.labels.end()) {
+				code.back().a = dst;
+				return;
+			}
+			emit(BC_MOV, dst, src);
+		}
+		int constant(const long long v) {
+			const int t = temp();
+			emit(BC_MOVI, t, 0, 0, v);
+			return t;
+		}
+		int string(const std::string &s) { // a copy of it in the frame, like the compiled code makes
+			strings.push_back(s);
+			const int t = temp(), copy = temp((s.size() + 8) / 8);
+			emit(BC_STR, t, copy, 0, strings.size() - 1);
+			return t;
+		}
+		void ret(const int reg) {
+			if(open.back().index == 0) emit(BC_HALT); // (main)
+			else if(reg < 0)           emit(BC_RETV);
+			else                       emit(BC_RET, reg);
+		}
+
+		/* runs the program (its main is the first function), returns its exit status */
+		int run() {
+			const size_t words = size_t(1) << 27; // 1 GiB, only what's used is ever mapped
+			void* const stack = mmap(nullptr, words * 8, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+			if(stack == MAP_FAILED) {
+				perror("grc --interp");
+				return 1;
+			}
+			const int status = execute((long long*)stack, (long long*)stack + words);
+			munmap(stack, words * 8);
+			fflush(stdout);
+			return status;
+		}
+
+	private:
+		struct open_function {
+			int              index;
+			unsigned         top;  // the first free register
+			unsigned         vars; // the first one after the variables
+			unsigned         regs; // the most it used
+			std::vector<long> labels;
+			std::vector<std::pair<size_t, int>> jumps; // (to the labels, patched at the end)
+		};
+		static bool writes_a(const long op) {
+			return (BC_MOVI <= op && op <= BC_LD64) || op == BC_READI || op == BC_READC || op == BC_STRLEN || op == BC_STRCMP;
+		}
+		static bool trap(const long long x, const long long y) { // where the division of the compiled code traps
+			return y == 0 || (y == -1 && x == LLONG_MIN);
+		}
+		struct call_record { // the caller of a running call
+			const bc_insn     *ip;
+			long long         *fp;
+			const bc_function *f;
+		};
+
+		/* threaded code: every instruction jumps straight to the handler of the next one */
+		int execute(long long* const stack, long long* const end) {
+			static const void* const handlers[BC_OPS] = {
+				&&movi, &&mov, &&add, &&addi, &&sub, &&mul, &&div, &&mod, &&neg, &&sext8,
+				&&addr, &&addrup, &&frameup, &&index, &&ld8, &&ld64, &&st8, &&st64, &&str,
+				&&jmp, &&jeq, &&jne, &&jlt, &&jle, &&jgt, &&jge, &&jeqi, &&jnei, &&jlti, &&jlei, &&jgti, &&jgei,
+				&&call, &&ret, &&retv, &&halt,
+				&&writei, &&writec, &&writes, &&readi, &&readc, &&reads, &&strlen_, &&strcmp_, &&strcpy_, &&strcat_,
+			};
+			for(bc_function &f : functions)
+				for(bc_insn &i : f.code) {
+					const long op = i.op;
+					i.handler = handlers[op];
+					if(BC_JMP <= op && op <= BC_JGEI) i.k = (long long)&f.code[i.k];
+					else if(op == BC_CALL)            i.k = (long long)&functions[i.b];
+					else if(op == BC_STR)             i.k = (long long)&strings[i.k];
+				}
+			std::vector<call_record> calls;
+			calls.reserve(1024);
+			const bc_function *f = &functions[0];
+			const bc_insn *ip = f->code.data();
+			long long *fp = stack;
+			fp[0] = 0;
+
+			#define R(x)      fp[x]
+			#define DISPATCH  goto *ip->handler
+			#define NEXT      do { ++ip; DISPATCH; } while(0)
+			#define JUMP_IF(c) do { ip = (c) ? (const bc_insn*)ip->k : ip + 1; DISPATCH; } while(0)
+			DISPATCH;
+
+			movi:    R(ip->a) = ip->k;                                    NEXT;
+			mov:     R(ip->a) = R(ip->b);                                 NEXT;
+			add:     R(ip->a) = (unsigned long long)R(ip->b) + R(ip->c);  NEXT; // (wraps around like the code)
+			addi:    R(ip->a) = (unsigned long long)R(ip->b) + ip->k;     NEXT;
+			sub:     R(ip->a) = (unsigned long long)R(ip->b) - R(ip->c);  NEXT;
+			mul:     R(ip->a) = (unsigned long long)R(ip->b) * R(ip->c);  NEXT;
+			div:     if(trap(R(ip->b), R(ip->c))) goto arithmetic_error;
+			         R(ip->a) = R(ip->b) / R(ip->c);                      NEXT;
+			mod:     if(trap(R(ip->b), R(ip->c))) goto arithmetic_error;
+			         R(ip->a) = R(ip->b) % R(ip->c);                      NEXT;
+			neg:     R(ip->a) = -(unsigned long long)R(ip->b);            NEXT;
+			sext8:   R(ip->a) = (signed char)R(ip->b);                    NEXT;
+			addr:    R(ip->a) = (long long)((char*)fp + ip->k);           NEXT;
+			addrup: {
+				long long *p = fp;
+				for(int d = ip->b; d > 0; --d) p = (long long*)p[0];
+				R(ip->a) = (long long)((char*)p + ip->k);
+				NEXT;
+			}
+			frameup: {
+				long long *p = fp;
+				for(int d = ip->b; d > 0; --d) p = (long long*)p[0];
+				R(ip->a) = (long long)p;
+				NEXT;
+			}
+			index:   R(ip->a) = R(ip->b) + R(ip->c) * ip->k;              NEXT;
+			ld8:     R(ip->a) = *(signed char*)R(ip->b);                  NEXT;
+			ld64:    R(ip->a) = *(long long*)R(ip->b);                    NEXT;
+			st8:     *(char*)R(ip->a) = R(ip->b);                         NEXT;
+			st64:    *(long long*)R(ip->a) = R(ip->b);                    NEXT;
+			str: {
+				const std::string &s = *(const std::string*)ip->k;
+				char* const copy = (char*)&R(ip->b);
+				memcpy(copy, s.c_str(), s.size() + 1);
+				R(ip->a) = (long long)copy;
+				NEXT;
+			}
+
+			jmp:     ip = (const bc_insn*)ip->k;                          DISPATCH;
+			jeq:     JUMP_IF(R(ip->a) == R(ip->b));
+			jne:     JUMP_IF(R(ip->a) != R(ip->b));
+			jlt:     JUMP_IF(R(ip->a) <  R(ip->b));
+			jle:     JUMP_IF(R(ip->a) <= R(ip->b));
+			jgt:     JUMP_IF(R(ip->a) >  R(ip->b));
+			jge:     JUMP_IF(R(ip->a) >= R(ip->b));
+			jeqi:    JUMP_IF(R(ip->a) == ip->b);
+			jnei:    JUMP_IF(R(ip->a) != ip->b);
+			jlti:    JUMP_IF(R(ip->a) <  ip->b);
+			jlei:    JUMP_IF(R(ip->a) <= ip->b);
+			jgti:    JUMP_IF(R(ip->a) >  ip->b);
+			jgei:    JUMP_IF(R(ip->a) >= ip->b);
+
+			call: { // the static link and the arguments are in the registers from a on, the result goes to c
+				const bc_function* const callee = (const bc_function*)ip->k;
+				long long* const callee_fp = fp + f->regs;
+				if(callee_fp + callee->regs > end) {
+					fflush(stdout);
+					fputs("grc --interp: stack overflow\n", stderr);
+					return 139; // (what the shell says about the segmentation fault of a compiled program)
+				}
+				memcpy(callee_fp, &R(ip->a), (callee->params + 1) * sizeof(long long));
+				calls.push_back({ip, fp, f});
+				f  = callee;
+				fp = callee_fp;
+				ip = f->code.data();
+				DISPATCH;
+			}
+			ret: {
+				const long long v = R(ip->a);
+				const call_record &c = calls.back();
+				ip = c.ip;
+				fp = c.fp;
+				f  = c.f;
+				calls.pop_back();
+				R(ip->c) = v;
+				NEXT;
+			}
+			retv: {
+				const call_record &c = calls.back();
+				ip = c.ip;
+				fp = c.fp;
+				f  = c.f;
+				calls.pop_back();
+				NEXT;
+			}
+			halt: return 0;
+
+			writei:  writeInteger(R(ip->a));                              NEXT;
+			writec:  writeChar(R(ip->a));                                 NEXT;
+			writes:  writeString((const char*)R(ip->a));                  NEXT;
+			readi:   R(ip->a) = readInteger();                            NEXT;
+			readc:   R(ip->a) = (signed char)readChar();                  NEXT;
+			reads:   readString(R(ip->a), (char*)R(ip->b));               NEXT;
+			strlen_: R(ip->a) = strlen((const char*)R(ip->b));            NEXT;
+			strcmp_: R(ip->a) = strcmp((const char*)R(ip->b), (const char*)R(ip->c)); NEXT;
+			strcpy_: strcpy((char*)R(ip->a), (const char*)R(ip->b));      NEXT;
+			strcat_: strcat((char*)R(ip->a), (const char*)R(ip->b));      NEXT;
+
+			arithmetic_error: // (k of a division is its line)
+				fflush(stdout);
+				fprintf(stderr, "grc --interp: line %lld: %s\n", ip->k, R(ip->c) == 0 ? "division by zero" : "integer overflow");
+				return 136; // (what the shell says about the floating point exception of a compiled program)
+			#undef R
+			#undef DISPATCH
+			#undef NEXT
+			#undef JUMP_IF
+		}
+
+		std::vector<bc_function> functions;
+		std::vector<std::string> strings;
+		std::vector<open_function> open;
+		std::vector<std::map<std::string, bc_name>> scopes = {{}};
+		int current_line = 0;
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef __JIT_HPP__
+#define __JIT_HPP__
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include "driver.hpp"
+#include "libgrc/grc.h"
+#include "session.hpp"
+
+extern "C" { // the runtime lib grc is linked with
+	void writeInteger(long long n);
+	void writeChar(char c);
+	void writeString(const char *s);
+	long long readInteger(void);
+	char readChar(void);
+	void readString(long long n, char *s);
+	long long ascii(char c);
+	char chr(long long n);
+	void __grc_writef(const char *format, long long size, ...);
+	void __grc_budget_init(long long budget);
+	void __grc_budget_exhausted(void);
+	long long *__grc_budget_slot(void);
+}
+
+/* the jit can't link a thread local of grc, so the functions of m find the thread's __grc_budget (see Func_def::meter)
+ * with a call of __grc_budget_slot on entry
+ */
+inline void jit_budget_slot(llvm::Module &m) {
+	llvm::GlobalVariable* const left = m.getGlobalVariable("__grc_budget");
+	if(left == nullptr) return;
+	llvm::FunctionCallee slot = m.getOrInsertFunction("__grc_budget_slot", left->getType());
+	std::map<llvm::Function*, llvm::Value*> slot_of;
+	while(!left->use_empty()) {
+		llvm::Use &u = *left->use_begin();
+		llvm::Function* const f = llvm::cast<llvm::Instruction>(u.getUser())->getFunction();
+		llvm::Value* &s = slot_of[f];
+		if(s == nullptr) {
+			llvm::BasicBlock::iterator entry = f->getEntryBlock().begin(); // after the frame, its alloca must stay in the entry block
+			while(llvm::isa<llvm::AllocaInst>(*entry)) ++entry;
+			s = llvm::IRBuilder<>(&*entry).CreateCall(slot, {}, "budget_slot");
+		}
+		u.set(s);
+	}
+	left->eraseFromParent();
+}
+
+/* --run-inputs: the program (the first of files) is compiled with --reentrant and jit compiled once, then its main
+ * runs on every other file as its input, on jobs threads at once (see libgrc/grc.h). What it writes goes to
+ * input.out and every input gets a "<input> <main's exit status>" line, like --batch. Every run has a --budget
+ * of its own.
+ * The runs share the process: a program that traps (or runs out of its --budget) stops all of them.
+ */
+inline int run_inputs(compile_options opts, const std::vector<std::string> &files, const unsigned jobs, std::ostream &diag) {
+	if(files.empty()) {
+		diag << "--run-inputs needs a program" << std::endl;
+		return 1;
+	}
+	std::ifstream in(files[0], std::ios::binary);
+	if(!in) {
+		diag << "can't open " << files[0] << std::endl;
+		return 1;
+	}
+	std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>()), ir;
+	opts.reentrant = true;
+	opts.emit      = EMIT_IR;
+	opts.exe       = opts.stream = false;
+	opts.file      = files[0];
+	int status = compile_source(source, opts, ir, diag);
+	if(status != 0) return status;
+
+	auto context = std::make_unique<llvm::LLVMContext>();
+	llvm::SMDiagnostic error;
+	std::unique_ptr<llvm::Module> m = llvm::parseIR(llvm::MemoryBufferRef(ir, files[0]), error, *context);
+	if(m == nullptr) {
+		diag << "can't jit compile " << files[0] << ": " << error.getMessage().str() << std::endl;
+		return 1;
+	}
+	llvm::InitializeNativeTarget(); // (the IR didn't need one)
+	llvm::InitializeNativeTargetAsmPrinter();
+	llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> jit = llvm::orc::LLJITBuilder().create();
+	if(!jit) {
+		diag << "can't jit compile " << files[0] << ": " << llvm::toString(jit.takeError()) << std::endl;
+		return 1;
+	}
+	llvm::orc::MangleAndInterner mangle((*jit)->getExecutionSession(), (*jit)->getDataLayout());
+	llvm::orc::SymbolMap runtime;
+	auto define = [&](const char* const name, auto* const f) {
+		runtime[mangle(name)] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(f), llvm::JITSymbolFlags::Exported);
+	};
+	define("writeInteger", writeInteger); define("writeChar", writeChar); define("writeString", writeString);
+	define("readInteger", readInteger);   define("readChar", readChar);   define("readString", readString);
+	define("ascii", ascii);               define("chr", chr);
+	define("__grc_writef", __grc_writef);
+	define("__grc_budget_init", __grc_budget_init); define("__grc_budget_exhausted", __grc_budget_exhausted); // (and links them in grc)
+	define("__grc_budget_slot", __grc_budget_slot);
+	llvm::orc::JITDylib &lib = (*jit)->getMainJITDylib();
+	llvm::cantFail(lib.define(llvm::orc::absoluteSymbols(std::move(runtime))));
+	lib.addGenerator(llvm::cantFail(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix()))); // libc
+	jit_budget_slot(*m);
+	m->setDataLayout((*jit)->getDataLayout());
+	if(llvm::Error e = (*jit)->addIRModule(llvm::orc::ThreadSafeModule(std::move(m), std::move(context)))) {
+		diag << "can't jit compile " << files[0] << ": " << llvm::toString(std::move(e)) << std::endl;
+		return 1;
+	}
+	llvm::Expected<llvm::JITEvaluatedSymbol> main = (*jit)->lookup("main"); // (compiles it)
+	if(!main) {
+		diag << "can't jit compile " << files[0] << ": " << llvm::toString(main.takeError()) << std::endl;
+		return 1;
+	}
+
+	const std::vector<std::string> inputs(files.begin() + 1, files.end());
+	std::vector<std::string> data(inputs.size());
+	std::vector<struct grc_run> runs;
+	std::vector<size_t> run_of(inputs.size(), SIZE_MAX); // (an input that can't be opened isn't run)
+	for(size_t i = 0; i < inputs.size(); ++i) {
+		std::ifstream f(inputs[i], std::ios::binary);
+		if(!f) {
+			diag << "can't open " << inputs[i] << std::endl;
+			status = 1;
+			continue;
+		}
+		data[i].assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+		run_of[i] = runs.size();
+		runs.push_back({data[i].data(), data[i].size(), nullptr, 0, 0});
+	}
+	grc_run_all(llvm::jitTargetAddressToPointer<long long (*)(void)>(main->getAddress()), runs.data(), runs.size(), jobs);
+
+	for(size_t i = 0; i < inputs.size(); ++i) {
+		if(run_of[i] == SIZE_MAX) continue;
+		const struct grc_run &r = runs[run_of[i]];
+		std::ofstream out(inputs[i] + ".out", std::ios::binary);
+		out.write(r.output, r.output_size);
+		free(r.output);
+		out.close();
+		if(!out) {
+			diag << "can't write " << inputs[i] << ".out" << std::endl;
+			status = 1;
+		}
+		std::cout << inputs[i] << ' ' << r.status << std::endl;
+	}
+	return status;
+}
+
+#endif
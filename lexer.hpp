@@ -1,3 +1,20 @@
-int yylex();
+#ifndef __LEXER_HPP__
+#define __LEXER_HPP__
+
+#include <cstdio>
+
+/* the scanner is reentrant, all of its state is in a yyscan_t (and its extra data is the session) */
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
+
+class compiler_session;
+
+int  yylex_init_extra(compiler_session* session, yyscan_t* scanner);
+void yyset_in(FILE* in, yyscan_t scanner);
+int  yylex_destroy(yyscan_t scanner);
+
 void yyerror(const char* msg);
-extern int lineno;
+
+#endif
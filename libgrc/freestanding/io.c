@@ -0,0 +1,43 @@
+#include "sys.h"
+
+/* stdin and stdout with a buffer each: output is written when its buffer is full, before reading (so a prompt is
+ * seen before the program waits for an answer) and at the end of main (see start.c) */
+
+static char out[1 << 16], in[1 << 16];
+static size_t out_size, in_pos, in_size;
+
+void __grc_flush(void) {
+  for (size_t i = 0; i < out_size;) {
+    const long n = __grc_write(1, out + i, out_size - i);
+    if (n < 0 && n != -4) break; // (-EINTR is retried, anything else loses the output like a failed fflush)
+    if (n > 0) i += n;
+  }
+  out_size = 0;
+}
+
+void __grc_out(const char *s, size_t n) {
+  if (out_size + n > sizeof(out)) {
+    __grc_flush();
+    if (n > sizeof(out)) { // (it would only be copied to be written)
+      for (long w; n > 0; s += w, n -= w)
+        if ((w = __grc_write(1, s, n)) <= 0) return;
+      return;
+    }
+  }
+  memcpy(out + out_size, s, n);
+  out_size += n;
+}
+
+int __grc_getc(void) {
+  if (in_pos == in_size) {
+    __grc_flush();
+    long n;
+    while ((n = __grc_read(0, in, sizeof(in))) == -4) continue;
+    if (n <= 0) return -1;
+    in_pos = 0;
+    in_size = n;
+  }
+  return (unsigned char)in[in_pos++];
+}
+
+void __grc_ungetc(void) { --in_pos; } // (only after a __grc_getc that didn't return -1)
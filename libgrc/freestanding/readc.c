@@ -0,0 +1,3 @@
+#include "sys.h"
+
+char readChar(void) { return __grc_getc(); }
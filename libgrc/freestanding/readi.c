@@ -0,0 +1,12 @@
+#include "sys.h"
+
+long long readInteger(void) { // like scanf("%lld")
+  int c;
+  while ((c = __grc_getc()) == ' ' || (c >= '\t' && c <= '\r')) continue;
+  const int negative = c == '-';
+  if (c == '-' || c == '+') c = __grc_getc();
+  unsigned long long n = 0;
+  for (; c >= '0' && c <= '9'; c = __grc_getc()) n = n * 10 + (c - '0');
+  if (c != -1) __grc_ungetc();
+  return negative ? -n : n;
+}
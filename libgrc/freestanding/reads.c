@@ -0,0 +1,8 @@
+#include "sys.h"
+
+void readString(const long long n, char* const s) { // like fgets
+  long long i = 0;
+  int c = 0;
+  while (i < n - 1 && c != '\n' && (c = __grc_getc()) != -1) s[i++] = c;
+  if (i > 0 || n == 1) s[i] = '\0';
+}
@@ -0,0 +1,22 @@
+#include "sys.h"
+
+/* the entry point of a --freestanding executable: the kernel jumps here with the stack pointer 16 byte aligned,
+ * there's nothing to set up (no dynamic linker, relocations, tls or constructors), so main is called right away and
+ * its return value is the exit status once the output has been written */
+
+long long main(void);
+
+_Noreturn void __grc_start(void) {
+  const long long status = main();
+  __grc_flush();
+  __grc_exit_group(status);
+}
+
+__asm__(".text\n"
+        ".globl _start\n"
+        ".type _start, @function\n"
+        "_start:\n"
+        "  xor %ebp, %ebp\n" // the outermost frame
+        "  and $-16, %rsp\n"
+        "  call __grc_start\n"
+        "  hlt\n");
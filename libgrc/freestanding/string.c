@@ -0,0 +1,77 @@
+#include <stdint.h>
+
+#include "sys.h"
+
+/* the string routines the programs call (and memcpy, memmove and memset, which llvm emits for its intrinsics), a
+ * word at a time: an aligned load of 8 bytes never crosses a page, so reading past the end of a string is safe once
+ * the pointer is aligned. A word has a zero byte iff (w - ONES) & ~w & HIGHS != 0 (the lowest one is exact) */
+
+#define ONES 0x0101010101010101ull
+#define HIGHS 0x8080808080808080ull
+
+typedef uint64_t __attribute__((may_alias)) word;
+
+static inline uint64_t zeros(uint64_t w) { return (w - ONES) & ~w & HIGHS; }
+
+size_t strlen(const char *s) {
+  const char *p = s;
+  for (; (uintptr_t)p % 8 != 0; ++p)
+    if (*p == '\0') return p - s;
+  const word *w = (const word *)p;
+  uint64_t z;
+  while ((z = zeros(*w)) == 0) ++w;
+  return (const char *)w - s + __builtin_ctzll(z) / 8;
+}
+
+long long strcmp(const char *a, const char *b) { // (grc's declaration returns an int64)
+  if ((uintptr_t)a % 8 == (uintptr_t)b % 8) { // the equal words of equal alignment are skipped
+    for (; (uintptr_t)a % 8 != 0; ++a, ++b)
+      if (*a != *b || *a == '\0') return (unsigned char)*a - (unsigned char)*b;
+    const word *x = (const word *)a, *y = (const word *)b;
+    while (*x == *y && zeros(*x) == 0) ++x, ++y;
+    a = (const char *)x;
+    b = (const char *)y;
+  }
+  while (*a == *b && *a != '\0') ++a, ++b;
+  return (unsigned char)*a - (unsigned char)*b;
+}
+
+void *memcpy(void *restrict d, const void *restrict s, size_t n) {
+  char *p = d;
+  const char *q = s;
+  for (; n >= 8; n -= 8, p += 8, q += 8) *(word *)p = *(const word *)q; // (unaligned loads and stores are cheap)
+  while (n-- > 0) *p++ = *q++;
+  return d;
+}
+
+void *memmove(void *d, const void *s, size_t n) {
+  char *p = d;
+  const char *q = s;
+  if (p <= q || p >= q + n) {
+    for (; n >= 8; n -= 8, p += 8, q += 8) *(word *)p = *(const word *)q; // (copying forwards a word at a time is safe when d is before s)
+    while (n-- > 0) *p++ = *q++;
+  } else {
+    for (p += n, q += n; n >= 8; n -= 8) {
+      p -= 8;
+      q -= 8;
+      *(word *)p = *(const word *)q;
+    }
+    while (n-- > 0) *--p = *--q;
+  }
+  return d;
+}
+
+void *memset(void *d, int c, size_t n) {
+  char *p = d;
+  const uint64_t w = (unsigned char)c * ONES;
+  for (; n >= 8; n -= 8, p += 8) *(word *)p = w;
+  while (n-- > 0) *p++ = c;
+  return d;
+}
+
+char *strcpy(char *restrict d, const char *restrict s) { return memcpy(d, s, strlen(s) + 1); }
+
+char *strcat(char *restrict d, const char *restrict s) {
+  strcpy(d + strlen(d), s);
+  return d;
+}
@@ -0,0 +1,30 @@
+#ifndef GRC_SYS_H
+#define GRC_SYS_H
+
+#include <stddef.h>
+
+/* the runtime of grc --freestanding: no libc at all, the few system calls a program needs are made directly
+ * (x86-64 linux: the number in rax, the arguments in rdi, rsi and rdx, rcx and r11 are clobbered) */
+
+static inline long __grc_syscall3(long n, long a, long b, long c) {
+  long r;
+  __asm__ volatile("syscall" : "=a"(r) : "a"(n), "D"(a), "S"(b), "d"(c) : "rcx", "r11", "memory");
+  return r;
+}
+
+static inline long __grc_read(int fd, void *buffer, size_t n) { return __grc_syscall3(0, fd, (long)buffer, n); }
+static inline long __grc_write(int fd, const void *buffer, size_t n) { return __grc_syscall3(1, fd, (long)buffer, n); }
+static inline _Noreturn void __grc_exit_group(int status) {
+  for (;;) __grc_syscall3(231, status, 0, 0);
+}
+
+/* the buffered stdin and stdout (see io.c) */
+void __grc_out(const char *s, size_t n);
+void __grc_flush(void);
+int __grc_getc(void); // -1 at the end of the input
+void __grc_ungetc(void);
+
+size_t strlen(const char *s);
+void *memcpy(void *restrict d, const void *restrict s, size_t n);
+
+#endif
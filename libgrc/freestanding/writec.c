@@ -0,0 +1,3 @@
+#include "sys.h"
+
+void writeChar(const char c) { __grc_out(&c, 1); }
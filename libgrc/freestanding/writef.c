@@ -0,0 +1,35 @@
+#include <stdarg.h>
+
+#include "sys.h"
+
+/* the runs of writes grc merges (see libgrc/src/writef.c), into the output buffer */
+
+void writeInteger(long long n);
+
+void __grc_writef(const char *format, const long long size, ...) {
+  const char *const end = format + size;
+  va_list args;
+  va_start(args, size);
+  while (format < end) {
+    const char *percent = format;
+    while (percent < end && *percent != '%') ++percent;
+    __grc_out(format, percent - format);
+    if (percent == end) break;
+    switch (percent[1]) {
+      case 'd': writeInteger(va_arg(args, long long)); break;
+      case 'c': {
+        const char c = va_arg(args, long long);
+        __grc_out(&c, 1);
+        break;
+      }
+      case 's': {
+        const char *const string = va_arg(args, const char *);
+        __grc_out(string, strlen(string));
+        break;
+      }
+      default: __grc_out(percent, 1); // %%
+    }
+    format = percent + 2;
+  }
+  va_end(args);
+}
@@ -0,0 +1,11 @@
+#include "sys.h"
+
+void writeInteger(const long long n) {
+  char s[20];
+  char *p = s + sizeof(s);
+  unsigned long long u = n < 0 ? -(unsigned long long)n : (unsigned long long)n;
+  do *--p = '0' + u % 10;
+  while ((u /= 10) != 0);
+  if (n < 0) *--p = '-';
+  __grc_out(p, s + sizeof(s) - p);
+}
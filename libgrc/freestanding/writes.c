@@ -0,0 +1,3 @@
+#include "sys.h"
+
+void writeString(const char* const s) { __grc_out(s, strlen(s)); }
@@ -0,0 +1,29 @@
+#ifndef GRC_H
+#define GRC_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the host api of libgrc: runs the main of a grace program compiled with grc --reentrant (linked with the host or
+ * jit compiled in it, like grc --run-inputs does) on inputs in memory instead of stdin and stdout, many at once */
+struct grc_run {
+  const char *input; // what the program reads
+  size_t input_size;
+  char *output;      // what it wrote (malloced, the host frees it)
+  size_t output_size;
+  long long status;  // what main returned
+};
+
+/* on the calling thread */
+void grc_run(long long (*main)(void), struct grc_run *run);
+/* on threads threads with big stacks, the calling one waits for them */
+void grc_run_all(long long (*main)(void), struct grc_run *runs, size_t n, unsigned threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
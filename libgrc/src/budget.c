@@ -0,0 +1,27 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+/* the runtime of grc --budget: the program charges the instructions it runs to __grc_budget (see
+ * Func_def::meter) and calls __grc_budget_exhausted when it goes below zero. The budget is the one
+ * the program was compiled with, or GRC_BUDGET if it's set.
+ */
+
+#define BUDGET_EXHAUSTED 152 /* what a shell reports for SIGXCPU, the signal of a cpu time limit */
+
+__thread long long __grc_budget;
+
+void __grc_budget_init(long long budget) {
+  const char *b = getenv("GRC_BUDGET");
+  __grc_budget = b != NULL ? strtoll(b, NULL, 10) : budget;
+}
+
+/* the budget of the calling thread, for the programs grc --run-inputs jit compiles (they can't address a thread local) */
+long long *__grc_budget_slot(void) {
+  return &__grc_budget;
+}
+
+void __grc_budget_exhausted(void) {
+  fflush(stdout);
+  fputs("instruction budget exhausted\n", stderr);
+  exit(BUDGET_EXHAUSTED);
+}
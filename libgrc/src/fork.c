@@ -0,0 +1,62 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* the runtime of grc --fork-server: main calls __grc_fork_server before anything else. If GRC_FORK_SERVER is
+ * "control,status" (two file descriptors the program was started with) the process becomes a fork server, like
+ * the one of AFL: it has been loaded and linked once, and for every "input output\n" line it reads from control it
+ * forks a child that goes on to run main with input as its stdin and output as its stdout. When the child is done
+ * "exit_status user_us system_us max_rss_kb\n" is written to status (the exit status is 128 + the signal if it was
+ * killed, like a shell reports it). The server exits when control is closed.
+ * Without GRC_FORK_SERVER the program just runs.
+ */
+
+static void child(int control, int status, const char *input, const char *output) {
+  close(control);
+  close(status);
+  const int in = open(input, O_RDONLY);
+  const int out = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (in < 0 || out < 0) {
+    perror(in < 0 ? input : output);
+    _exit(1);
+  }
+  dup2(in, 0);
+  dup2(out, 1);
+  close(in);
+  close(out);
+}
+
+void __grc_fork_server(void) {
+  const char *fds = getenv("GRC_FORK_SERVER");
+  int control, status;
+  if (fds == NULL || sscanf(fds, "%d,%d", &control, &status) != 2) return;
+  unsetenv("GRC_FORK_SERVER"); // (not for the children)
+  FILE *requests = fdopen(control, "r");
+  if (requests == NULL) {
+    perror("grc fork server");
+    exit(1);
+  }
+  char input[4096], output[4096];
+  while (fscanf(requests, "%4095s %4095s", input, output) == 2) {
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (pid == 0) {
+      child(control, status, input, output);
+      return; // main goes on
+    }
+    int s = 1;
+    struct rusage usage;
+    memset(&usage, 0, sizeof(usage));
+    if (pid < 0) perror("grc fork server");
+    else if (wait4(pid, &s, 0, &usage) < 0) perror("grc fork server");
+    else s = WIFSIGNALED(s) ? 128 + WTERMSIG(s) : WEXITSTATUS(s);
+    dprintf(status, "%d %lld %lld %ld\n", s,
+            usage.ru_utime.tv_sec * 1000000LL + usage.ru_utime.tv_usec,
+            usage.ru_stime.tv_sec * 1000000LL + usage.ru_stime.tv_usec, usage.ru_maxrss);
+  }
+  exit(0);
+}
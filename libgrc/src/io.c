@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+
+__thread struct grc_io *__grc_io;
+
+void __grc_io_write(const char *s, size_t n) {
+  struct grc_io *io = __grc_io;
+  if (io->out_size + n > io->out_capacity) {
+    size_t capacity = io->out_capacity ? io->out_capacity * 2 : 4096;
+    while (capacity < io->out_size + n) capacity *= 2;
+    char *out = realloc(io->out, capacity);
+    if (out == NULL) {
+      perror("grc");
+      exit(1);
+    }
+    io->out = out;
+    io->out_capacity = capacity;
+  }
+  memcpy(io->out + io->out_size, s, n);
+  io->out_size += n;
+}
+
+int __grc_io_getc(void) {
+  struct grc_io *io = __grc_io;
+  return io->in_pos < io->in_size ? (unsigned char)io->in[io->in_pos++] : EOF;
+}
+
+void __grc_io_ungetc(void) { --__grc_io->in_pos; }
@@ -0,0 +1,21 @@
+#ifndef GRC_IO_H
+#define GRC_IO_H
+
+#include <stddef.h>
+
+/* the memory backend of the i/o functions: while a thread has one (see grc_run) the program it runs reads its
+ * input from a buffer and appends its output to another one, instead of using stdin and stdout */
+struct grc_io {
+  const char *in;
+  size_t in_size, in_pos;
+  char *out;
+  size_t out_size, out_capacity;
+};
+
+extern __thread struct grc_io *__grc_io;
+
+void __grc_io_write(const char *s, size_t n);
+int __grc_io_getc(void); // EOF at the end of the input
+void __grc_io_ungetc(void);
+
+#endif
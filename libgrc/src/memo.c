@@ -0,0 +1,39 @@
+/* -fauto-memo: a memoized function (see Func_def::memoize) has a table of the results it returned before, zeroed
+ * and 48 << 14 bytes big, that it looks its arguments up in. It's direct mapped: the arguments hash to one slot and
+ * a result replaces what was there, so a miss only costs recomputing it. Nothing here uses libc (it's also a part of
+ * the runtime of --freestanding).
+ */
+
+#define SLOTS (1 << 14)
+
+struct slot {
+  long long args[4];
+  long long value;
+  long long full;
+};
+
+struct grc_memo {
+  struct slot slots[SLOTS];
+};
+
+static struct slot *slot(struct grc_memo *memo, const long long *args, const long long n) {
+  unsigned long long h = 0;
+  for (long long i = 0; i < n; ++i) h = (h ^ (unsigned long long)args[i]) * 0x9e3779b97f4a7c15ull;
+  return &memo->slots[h >> (64 - 14)];
+}
+
+long long __grc_memo_get(struct grc_memo *memo, const long long *args, const long long n, long long *value) {
+  const struct slot *s = slot(memo, args, n);
+  if (!s->full) return 0;
+  for (long long i = 0; i < n; ++i)
+    if (s->args[i] != args[i]) return 0;
+  *value = s->value;
+  return 1;
+}
+
+void __grc_memo_put(struct grc_memo *memo, const long long *args, const long long n, const long long value) {
+  struct slot *s = slot(memo, args, n);
+  for (long long i = 0; i < n; ++i) s->args[i] = args[i];
+  s->value = value;
+  s->full = 1;
+}
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* the runtime of grc -pg: every function calls __grc_pg_enter with its counters when it's entered and
+ * __grc_pg_exit when it returns. Times are rdtsc cycles (nanoseconds of the monotonic clock where there's
+ * no rdtsc), converted to milliseconds with the rate the counter ran at while the program did. When the
+ * program exits a flat profile and a call graph are written to grcprof.out (to GRC_PG_FILE if it's set).
+ */
+
+static inline unsigned long long ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ull + t.tv_nsec;
+#endif
+}
+
+struct pg_function { // laid out by grc (see Func_def::count_calls)
+  unsigned long long calls;
+  unsigned long long self, total; // without and with the functions it calls
+  long long active;               // its calls on the stack (only the outermost one adds to total)
+  struct pg_function *next;
+  struct pg_function *last_caller; // and the arc from it, so calls from the same caller skip the lookup
+  unsigned long long last_arc;
+  const char name[];
+};
+
+struct pg_arc { // a caller and a function it calls
+  struct pg_function *caller, *callee;
+  unsigned long long calls, time;
+};
+
+struct pg_frame {
+  struct pg_function *f;
+  size_t arc;
+  unsigned long long start, children;
+};
+
+static struct pg_function *functions; // the ones called so far
+static struct pg_frame *stack;
+static size_t depth, stack_size;
+static struct pg_arc *arcs; // (by index, they move when they grow)
+static size_t arc_count, arc_size;
+static size_t *slots; // a hash table of the arcs, index + 1 (0 is an empty slot)
+static size_t slot_count;
+static unsigned long long start_tsc;
+static struct timespec start_time;
+
+static void *grow(void *p, size_t *size, size_t element) {
+  *size = *size ? *size * 2 : 1024;
+  p = realloc(p, *size * element);
+  if (p == NULL) {
+    perror("grc -pg");
+    exit(1);
+  }
+  return p;
+}
+
+static size_t slot_of(const struct pg_function *caller, const struct pg_function *callee) {
+  const size_t h = ((size_t)caller * 31 + (size_t)callee) * 0x9e3779b97f4a7c15ull;
+  return (h >> 20) & (slot_count - 1);
+}
+
+static void rehash(void) {
+  free(slots);
+  slot_count = slot_count ? slot_count * 2 : 4096;
+  slots = calloc(slot_count, sizeof(*slots));
+  if (slots == NULL) {
+    perror("grc -pg");
+    exit(1);
+  }
+  for (size_t a = 0; a < arc_count; ++a) {
+    size_t s = slot_of(arcs[a].caller, arcs[a].callee);
+    while (slots[s] != 0) s = (s + 1) & (slot_count - 1);
+    slots[s] = a + 1;
+  }
+}
+
+static size_t arc(struct pg_function *caller, struct pg_function *callee) {
+  size_t s = slot_of(caller, callee);
+  for (; slots[s] != 0; s = (s + 1) & (slot_count - 1)) {
+    const struct pg_arc *a = &arcs[slots[s] - 1];
+    if (a->caller == caller && a->callee == callee) return slots[s] - 1;
+  }
+  if (arc_count == arc_size) arcs = grow(arcs, &arc_size, sizeof(*arcs));
+  arcs[arc_count] = (struct pg_arc){caller, callee, 0, 0};
+  slots[s] = ++arc_count;
+  if (arc_count * 4 > slot_count * 3) rehash();
+  return arc_count - 1;
+}
+
+static int by_self(const void *a, const void *b) {
+  const struct pg_function *x = *(struct pg_function *const *)a, *y = *(struct pg_function *const *)b;
+  return x->self < y->self ? 1 : x->self > y->self ? -1 : 0;
+}
+
+static void write_report(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  const double ns = (now.tv_sec - start_time.tv_sec) * 1e9 + (now.tv_nsec - start_time.tv_nsec);
+  const double ms_per_cycle = ns > 0 ? ns / (ticks() - start_tsc) / 1e6 : 0;
+
+  const char *path = getenv("GRC_PG_FILE");
+  FILE *out = fopen(path != NULL ? path : "grcprof.out", "w");
+  if (out == NULL) {
+    perror(path != NULL ? path : "grcprof.out");
+    return;
+  }
+  size_t n = 0;
+  for (struct pg_function *f = functions; f != NULL; f = f->next) ++n;
+  struct pg_function **sorted = malloc(n * sizeof(*sorted));
+  n = 0;
+  for (struct pg_function *f = functions; f != NULL; f = f->next) sorted[n++] = f;
+  qsort(sorted, n, sizeof(*sorted), by_self);
+  unsigned long long all = 0;
+  for (size_t i = 0; i < n; ++i) all += sorted[i]->self;
+
+  fprintf(out, "flat profile (%.1f ms, %.2f GHz time stamp counter):\n\n", ns / 1e6, ns > 0 ? (ticks() - start_tsc) / ns : 0);
+  fprintf(out, "  %% time      self ms     total ms         calls   self us/call  total us/call  name\n");
+  for (size_t i = 0; i < n; ++i) {
+    const struct pg_function *f = sorted[i];
+    fprintf(out, "%8.2f %12.3f %12.3f %13llu %14.3f %14.3f  %s\n", all ? 100.0 * f->self / all : 0.0,
+            f->self * ms_per_cycle, f->total * ms_per_cycle, f->calls,
+            f->self * ms_per_cycle * 1000 / f->calls, f->total * ms_per_cycle * 1000 / f->calls, f->name);
+  }
+
+  fprintf(out, "\ncall graph (the callers of every function, then what it calls, with the calls and the total ms of each arc):\n");
+  for (size_t i = 0; i < n; ++i) {
+    const struct pg_function *f = sorted[i];
+    fprintf(out, "\n%s: %llu calls, %.3f ms self, %.3f ms total\n", f->name, f->calls, f->self * ms_per_cycle, f->total * ms_per_cycle);
+    for (size_t a = 0; a < arc_count; ++a)
+      if (arcs[a].callee == f && arcs[a].caller != NULL)
+        fprintf(out, "    called by %-30s %13llu %12.3f\n", arcs[a].caller->name, arcs[a].calls, arcs[a].time * ms_per_cycle);
+    for (size_t a = 0; a < arc_count; ++a)
+      if (arcs[a].caller == f)
+        fprintf(out, "    calls     %-30s %13llu %12.3f\n", arcs[a].callee->name, arcs[a].calls, arcs[a].time * ms_per_cycle);
+  }
+  free(sorted);
+  fclose(out);
+}
+
+void __grc_pg_enter(struct pg_function *f) {
+  if (f->calls++ == 0) {
+    if (functions == NULL) { // the program starts
+      rehash();
+      atexit(write_report);
+      clock_gettime(CLOCK_MONOTONIC, &start_time);
+      start_tsc = ticks();
+    }
+    f->next = functions;
+    functions = f;
+  }
+  if (depth == stack_size) stack = grow(stack, &stack_size, sizeof(*stack));
+  struct pg_frame *frame = &stack[depth];
+  frame->f = f;
+  struct pg_function *caller = depth > 0 ? stack[depth - 1].f : NULL;
+  if (f->last_caller != caller || f->calls == 1) {
+    f->last_caller = caller;
+    f->last_arc = arc(caller, f);
+  }
+  frame->arc = f->last_arc;
+  frame->children = 0;
+  ++arcs[frame->arc].calls;
+  ++f->active;
+  ++depth;
+  frame->start = ticks();
+}
+
+void __grc_pg_exit(void) {
+  const unsigned long long now = ticks();
+  const struct pg_frame *frame = &stack[--depth];
+  const unsigned long long elapsed = now - frame->start;
+  struct pg_function *f = frame->f;
+  f->self += elapsed - frame->children;
+  if (--f->active == 0) { // (a recursive call is part of the outermost one)
+    f->total += elapsed;
+    arcs[frame->arc].time += elapsed;
+  }
+  if (depth > 0) stack[depth - 1].children += elapsed;
+}
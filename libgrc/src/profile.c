@@ -0,0 +1,42 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+/* the runtime of grc -fprofile-generate: the program hands over the counters of its functions when it starts
+ * and they are written in llvm's text profile format when it exits (to GRC_PROFILE_FILE if it's set) */
+
+struct profiled_function {
+  const char *name; // not null terminated
+  long long name_length;
+  unsigned long long hash, counters;
+  const unsigned long long *counter;
+};
+
+static const struct profiled_function *functions;
+static long long function_count;
+static const char *profile_file;
+
+static void write_profile(void) {
+  const char *path = getenv("GRC_PROFILE_FILE");
+  if (path == NULL) path = profile_file;
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    perror(path);
+    return;
+  }
+  fputs("# IR level Instrumentation Flag\n:ir\n", f);
+  for (long long i = 0; i < function_count; ++i) {
+    const struct profiled_function *p = &functions[i];
+    fprintf(f, "%.*s\n# Func Hash:\n%llu\n# Num Counters:\n%llu\n# Counter Values:\n",
+            (int)p->name_length, p->name, p->hash, p->counters);
+    for (unsigned long long c = 0; c < p->counters; ++c) fprintf(f, "%llu\n", p->counter[c]);
+    fputc('\n', f);
+  }
+  fclose(f);
+}
+
+void __grc_profile_init(const struct profiled_function *f, long long n, const char *file) {
+  functions = f;
+  function_count = n;
+  profile_file = file;
+  atexit(write_profile);
+}
@@ -1,3 +1,5 @@
 #include <stdio.h>
 
-char readChar(void) { return getchar(); }
+#include "io.h"
+
+char readChar(void) { return __grc_io != NULL ? __grc_io_getc() : getchar(); }
@@ -1,6 +1,21 @@
+#include <ctype.h>
 #include <stdio.h>
 
+#include "io.h"
+
+static long long read_memory(void) { // like scanf("%lld")
+  int c;
+  while ((c = __grc_io_getc()) != EOF && isspace(c)) continue;
+  const int negative = c == '-';
+  if (c == '-' || c == '+') c = __grc_io_getc();
+  unsigned long long n = 0;
+  for (; c != EOF && isdigit(c); c = __grc_io_getc()) n = n * 10 + (c - '0');
+  if (c != EOF) __grc_io_ungetc();
+  return negative ? -n : n;
+}
+
 long long readInteger(void) {
+  if (__grc_io != NULL) return read_memory();
   long long n;
   scanf("%lld", &n);
   return n;
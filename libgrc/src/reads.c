@@ -1,3 +1,15 @@
 #include <stdio.h>
 
-void readString(long long n, char* const s) { fgets(s, n, stdin); }
+#include "io.h"
+
+static void read_memory(long long n, char* const s) { // like fgets
+  long long i = 0;
+  int c = 0;
+  while (i < n - 1 && c != '\n' && (c = __grc_io_getc()) != EOF) s[i++] = c;
+  if (i > 0 || n == 1) s[i] = '\0';
+}
+
+void readString(long long n, char* const s) {
+  if (__grc_io != NULL) read_memory(n, s);
+  else fgets(s, n, stdin);
+}
@@ -0,0 +1,46 @@
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "../grc.h"
+#include "io.h"
+
+/* the host api (see grc.h): every run has a memory backend (io.c) for the i/o of the thread it's on */
+
+#define STACK_SIZE (256 << 20) /* of every worker, the frames of recursive grace functions are on it (only the pages used are mapped) */
+
+void grc_run(long long (*main)(void), struct grc_run *run) {
+  struct grc_io io = {run->input, run->input_size, 0, NULL, 0, 0};
+  __grc_io = &io;
+  run->status = main();
+  __grc_io = NULL;
+  run->output = io.out;
+  run->output_size = io.out_size;
+}
+
+struct batch {
+  long long (*main)(void);
+  struct grc_run *runs;
+  size_t n, next;
+};
+
+static void *worker(void *p) {
+  struct batch *b = p;
+  for (size_t i; (i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED)) < b->n;) grc_run(b->main, &b->runs[i]);
+  return NULL;
+}
+
+void grc_run_all(long long (*main)(void), struct grc_run *runs, size_t n, unsigned threads) {
+  struct batch b = {main, runs, n, 0};
+  if (threads > n) threads = n;
+  if (threads == 0) threads = 1;
+  pthread_t *t = malloc(threads * sizeof(*t));
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, STACK_SIZE);
+  unsigned started = 0;
+  while (t != NULL && started < threads && pthread_create(&t[started], &attr, worker, &b) == 0) ++started;
+  if (started == 0) worker(&b); // (no thread could be made, its own stack will have to do)
+  for (unsigned i = 0; i < started; ++i) pthread_join(t[i], NULL);
+  pthread_attr_destroy(&attr);
+  free(t);
+}
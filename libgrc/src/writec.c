@@ -1,3 +1,8 @@
 #include <stdio.h>
 
-void writeChar(const char c) { putchar(c); }
+#include "io.h"
+
+void writeChar(const char c) {
+  if (__grc_io != NULL) __grc_io_write(&c, 1);
+  else putchar(c);
+}
@@ -0,0 +1,41 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "io.h"
+
+/* a run of writes grc merged into one call (see Stmt_list::compile): format is size bytes of text in which %d, %c
+ * and %s stand for the next argument (a long long, a char passed as a long long and a string) and %% for %.
+ * stdout is locked once for all of it */
+
+static void put(const char *s, const size_t n) {
+  if (__grc_io != NULL) __grc_io_write(s, n);
+  else fwrite_unlocked(s, 1, n, stdout);
+}
+
+void __grc_writef(const char *format, const long long size, ...) {
+  const char *const end = format + size;
+  va_list args;
+  va_start(args, size);
+  if (__grc_io == NULL) flockfile(stdout);
+  while (format < end) {
+    const char *percent = memchr(format, '%', end - format);
+    if (percent == NULL) percent = end;
+    put(format, percent - format);
+    if (percent == end) break;
+    char s[24];
+    switch (percent[1]) {
+      case 'd': put(s, snprintf(s, sizeof(s), "%lld", va_arg(args, long long))); break;
+      case 'c': s[0] = va_arg(args, long long); put(s, 1); break;
+      case 's': {
+        const char *const string = va_arg(args, const char *);
+        put(string, strlen(string));
+        break;
+      }
+      default: put(percent, 1); // %%
+    }
+    format = percent + 2;
+  }
+  if (__grc_io == NULL) funlockfile(stdout);
+  va_end(args);
+}
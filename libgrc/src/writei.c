@@ -1,3 +1,12 @@
 #include <stdio.h>
 
-void writeInteger(const long long n) { printf("%lld", n); }
+#include "io.h"
+
+void writeInteger(const long long n) {
+  if (__grc_io != NULL) {
+    char s[24];
+    __grc_io_write(s, snprintf(s, sizeof(s), "%lld", n));
+    return;
+  }
+  printf("%lld", n);
+}
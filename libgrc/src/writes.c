@@ -1,3 +1,9 @@
 #include <stdio.h>
+#include <string.h>
 
-void writeString(const char* const s) { printf("%s", s); }
+#include "io.h"
+
+void writeString(const char* const s) {
+  if (__grc_io != NULL) __grc_io_write(s, strlen(s));
+  else printf("%s", s);
+}
@@ -38,6 +38,7 @@ struct ll_scope { // needed to get nested function names
 class ll_symbol_table {
  public:
   ll_symbol_table() : scopes() {}
+  ~ll_symbol_table() { while(!scopes.empty()) pop_scope(); }
   void push_scope(const char* const func_name) {
     scopes.push_back(new ll_scope(func_name));
   }
@@ -47,10 +48,10 @@ class ll_symbol_table {
     scopes.pop_back();
   }
   void new_symbol(const std::string name, llvm::Value* const v, llvm::Type* const t, llvm::Type* base_type=nullptr, const unsigned long long frame_no=-1) {
-    scopes.back()->vars[name] = new ll_ste(v, t, base_type, frame_no, scopes.size(), nullptr, false);
+    replace(name, new ll_ste(v, t, base_type, frame_no, scopes.size(), nullptr, false));
   }
   void new_func(const std::string name, llvm::Function* const f, const bool is_rtf=false) {
-    scopes.back()->vars[name] = new ll_ste(nullptr, nullptr, nullptr, -1, scopes.size(), f, is_rtf);
+    replace(name, new ll_ste(nullptr, nullptr, nullptr, -1, scopes.size(), f, is_rtf));
   }
   const ll_ste* lookup(const std::string name) const {
     for(auto s = scopes.rbegin(); s != scopes.rend(); ++s) {
@@ -64,6 +65,7 @@ class ll_symbol_table {
     if(it == scopes[scope - 1]->vars.end()) return nullptr;
     return it->second;
   }
+  const std::map<std::string, ll_ste*> &get_scope_vars(const unsigned long long scope) const { return scopes[scope - 1]->vars; }
   std::string get_scope_name(const std::string &sep) const {
     std::string s_name = "";
     for(const auto &s : scopes)
@@ -74,6 +76,11 @@ class ll_symbol_table {
   }
   unsigned long long get_current_scope_no() const { return scopes.size(); }
  private:
+  void replace(const std::string &name, ll_ste* const e) { // an entry can be set again (e.g. when the variable is put in the stack frame)
+    ll_ste *&old = scopes.back()->vars[name];
+    delete old;
+    old = e;
+  }
   std::vector<ll_scope*> scopes;
 };
 
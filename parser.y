@@ -3,13 +3,15 @@
 #include <cstdlib>
 
 #include "ast.hpp"
+#include "batch.hpp"
+#include "cache.hpp"
+#include "driver.hpp"
+#include "jit.hpp"
+#include "server.hpp"
 #include "runtime_syms.cpp"
 #include "lexer.hpp"
 
-print_align align;
-
-symbol_table st;
-ll_symbol_table ll_st;
+thread_local print_align align;
 
 const char *INT  = "int";
 const char *CHAR = "char";
@@ -17,10 +19,35 @@ const char *CHAR = "char";
 /* Basic Types (usefull in some AST operations) */
 Type Int_t(new Data_type(INT));
 Type Char_t(new Data_type(CHAR));
-
-bool optimization_flag = false;
 %}
 
+%code requires {
+#include "lexer.hpp"
+}
+
+%code provides {
+int yylex(YYSTYPE* yylval, YYLTYPE* yylloc, yyscan_t scanner);
+void yyerror(YYLTYPE* yylloc, yyscan_t scanner, const char *msg);
+}
+
+%code {
+/* the line and column a node starts at (for -g) */
+template<class Node> Node* located(Node* const n, const YYLTYPE &l) {
+	n->locate(l.first_line, l.first_column);
+	return n;
+}
+
+/* --stream's steps run in the middle of the parse: their errors stop the parser (YYABORT) instead of being thrown
+ * through it, so that the %destructors free what's on its stack. cleanup frees the symbols of the rule itself,
+ * which the parser leaves to its action.
+ */
+#define STREAM(step, cleanup) try { step; } catch(const compile_error &e) { cleanup; session->parse_error = e.status; YYABORT; }
+}
+
+%define api.pure full
+%param {yyscan_t scanner}
+%locations
+
 %token T_and     "and"
 %token T_char    "char"
 %token T_div     "div"
@@ -103,6 +130,9 @@ bool optimization_flag = false;
 %type<exp>    expr
 %type<cnd>    cond
 
+/* what the parser drops when it stops at an error (what it has reduced is owned by the nodes built from it) */
+%destructor { delete $$; } <ldef> <fdef> <hdr> <ldlist> <blk> <idlist> <dtype> <type> <tail> <fpt> <rt> <fpdl> <fpd> <stm> <fc> <lv> <exp> <elist> <cnd>
+%destructor { free((void*)$$); } <id_name> <str> <chr>
 
 %expect 1
 
@@ -113,23 +143,36 @@ bool optimization_flag = false;
 program:
   func_def {
     // std::cout << "AST:\n" << *$1 << std::endl;
-    $1->sem();
-    $1->set_main();
-    $1->llvm_compile_and_dump(optimization_flag);
+    if(session->opts.stream) delete $1; // already emitted
+    else {
+      const std::unique_ptr<Func_def> program($1); // freed once it's compiled (or a semantic error is thrown)
+      program->sem();
+      program->set_main();
+      program->fold_constants();
+      if(session->opts.interp) program->interpret();
+      else {
+        if(session->opts.optimize && session->opts.budget == 0) program->promote_refs(); // (--budget counts the code of the refs as they're written)
+        program->llvm_compile_and_dump(session->opts.optimize, session->opts.fast, session->opts.emit);
+      }
+    }
   }
 ;
 
+/* with --stream every function is emitted as soon as it's parsed (see Func_def::stream_begin) */
 func_def:
-  header local_def_list block { $$ = new Func_def($1, $2, $3); }
+  header { if(session->opts.stream) STREAM(Func_def::stream_begin($1), ); } local_def_list block {
+    $$ = new Func_def($1, $3, $4);
+    if(session->opts.stream) STREAM($$->stream_end(), delete $$);
+  }
 ;
 
 local_def_list: /* nothing */ { $$ = new Local_def_list(); }
-| local_def_list local_def    { $1->append($2); $$ = $1; }
+| local_def_list local_def    { $1->append($2); $$ = $1; if(session->opts.stream) STREAM(Func_def::stream_def($2), delete $1); }
 ;
 
 header: 
-  "fun" T_id '(' ')' ':' ret_type               { $$ = new Header(new Id($2), nullptr, $6); }
-| "fun" T_id '(' fpar_def_list ')' ':' ret_type { $$ = new Header(new Id($2), $4, $7); }
+  "fun" T_id '(' ')' ':' ret_type               { $$ = located(new Header(new Id($2), nullptr, $6), @$); }
+| "fun" T_id '(' fpar_def_list ')' ':' ret_type { $$ = located(new Header(new Id($2), $4, $7), @$); }
 ;
 
 fpar_def_list:
@@ -143,8 +186,8 @@ fpar_def:
 ;
 
 identifier_list:
-  T_id                     { $$ = new Id_list(new Id($1)); }
-| identifier_list ',' T_id { $1->append(new Id($3)); $$ = $1; }
+  T_id                     { $$ = new Id_list(located(new Id($1), @1)); }
+| identifier_list ',' T_id { $1->append(located(new Id($3), @3)); $$ = $1; }
 ;
 
 data_type:
@@ -189,19 +232,19 @@ var_def:
 ;
 
 stmt:
-  ';'                               { $$ = new Empty_stmt(); }
-| l_value "<-" expr ';'             { $$ = new Assign($1, $3); }
+  ';'                               { $$ = located(new Empty_stmt(), @$); }
+| l_value "<-" expr ';'             { $$ = located(new Assign($1, $3), @$); }
 | block                             { $$ = $1; }
 | func_call ';'                     { $$ = $1; }
-| "if" cond "then" stmt             { $$ = new If($2, $4, nullptr); }
-| "if" cond "then" stmt "else" stmt { $$ = new If($2, $4, $6); }
-| "while" cond "do" stmt            { $$ = new While($2, $4); }
-| "return" ';'                      { $$ = new Return(nullptr); }
-| "return" expr ';'                 { $$ = new Return($2); }
+| "if" cond "then" stmt             { $$ = located(new If($2, $4, nullptr), @$); }
+| "if" cond "then" stmt "else" stmt { $$ = located(new If($2, $4, $6), @$); }
+| "while" cond "do" stmt            { $$ = located(new While($2, $4), @$); }
+| "return" ';'                      { $$ = located(new Return(nullptr), @$); }
+| "return" expr ';'                 { $$ = located(new Return($2), @$); }
 ;
 
 block:
-  '{' stmt_list '}' { $$ = $2; }
+  '{' stmt_list '}' { $$ = located($2, @1); $$->locate_end(@3.first_line, @3.first_column); }
 ;
 
 stmt_list: /* nothing */ { $$ = new Stmt_list(); }
@@ -209,8 +252,8 @@ stmt_list: /* nothing */ { $$ = new Stmt_list(); }
 ;
 
 func_call:
-  T_id '(' ')'           { $$ = new Func_call(new Id($1), nullptr); }
-| T_id '(' expr_list ')' { $$ = new Func_call(new Id($1), $3); }
+  T_id '(' ')'           { $$ = located(new Func_call(new Id($1), nullptr), @$); }
+| T_id '(' expr_list ')' { $$ = located(new Func_call(new Id($1), $3), @$); }
 ;
 
 expr_list:
@@ -265,13 +308,80 @@ std::vector<condensed_fpar_list_item>* get_condensed_rep_of_fpars(const Fpar_def
 	return v;
 }
 
+static void error_message(const char *msg) {
+	session->diag << "Line " << session->lineno << ": " << msg << std::endl;
+	session->out << "This is to make llc fail when running ./grc | llc\n";
+}
 void yyerror(const char *msg) {
-    fprintf(stderr, "Line %d: %s\n", lineno, msg);
-	printf("This is to make llc fail when running ./grc | llc\n");
-    exit(2);
+	error_message(msg);
+	throw compile_error(2);
+}
+void yyerror(YYLTYPE* yylloc, yyscan_t scanner, const char *msg) { error_message(msg); } // a syntax error, the parser stops by itself
+
+int compiler_session::compile(FILE *in) {
+	compiler_session* const outer = session; // in case a session is run from inside another one
+	session = this;
+	yyscan_t scanner;
+	yylex_init_extra(this, &scanner);
+	yyset_in(in, scanner);
+	int status;
+	try { status = yyparse(scanner) != 0 ? parse_error : 0; }
+	catch(const compile_error &e) { status = e.status; }
+	yylex_destroy(scanner);
+	out.flush();
+	session = outer;
+	return status;
 }
 
 int main(int argc, char** argv) {
-    if(argc > 1) optimization_flag = true;
-	return yyparse();
+	compile_options opts;
+	bool batch = false;
+	unsigned jobs = std::thread::hardware_concurrency();
+	std::vector<std::string> files; // for --batch
+	const char *serve = nullptr;
+	bool cached = false, cache_stats = false, run = false;
+	std::string cache_dir = compile_cache::default_directory();
+	unsigned long long cache_size = 256; // MiB
+	for(int i = 1; i < argc; ++i)
+		if(parse_compile_option(argv[i], opts))        continue;
+		else if(!strcmp(argv[i], "--batch"))           batch         = true;
+		else if(!strncmp(argv[i], "--jobs=", 7))       jobs          = atoi(argv[i] + 7);
+		else if(!strcmp(argv[i], "--serve") && i + 1 < argc) serve = argv[++i];
+		else if(!strcmp(argv[i], "--cache"))           cached        = true;
+		else if(!strncmp(argv[i], "--cache=", 8))      cached        = true, cache_dir = argv[i] + 8;
+		else if(!strncmp(argv[i], "--cache-size=", 13)) cache_size   = strtoull(argv[i] + 13, nullptr, 10);
+		else if(!strcmp(argv[i], "--cache-stats"))     cache_stats   = cached = true;
+		else if(!strcmp(argv[i], "--interp"))          opts.interp   = true;
+		else if(!strcmp(argv[i], "--run-inputs"))      run           = true;
+		else if(argv[i][0] == '@')                     read_manifest(argv[i] + 1, files);
+		else if(argv[i][0] != '-')                     files.push_back(argv[i]);
+		else {
+			std::cerr << bad_option(argv[i]) << std::endl;
+			return 1;
+		}
+
+	std::unique_ptr<compile_cache> cache;
+	if(cached) cache = std::make_unique<compile_cache>(cache_dir, cache_size << 20);
+	if(cache_stats) {
+		std::cout << cache->report();
+		return 0;
+	}
+	if(serve != nullptr) return compile_server(cache.get()).serve(serve);
+	if(batch) {
+		const int status = compile_batch(files, opts, jobs, cache.get());
+		if(cache) std::cerr << cache->report();
+		return status;
+	}
+
+	if(run) return run_inputs(opts, files, jobs, std::cerr);
+	if(opts.interp) return interpret_program(opts, files, std::cerr);
+	if(opts.stream && !cache) return compile_stream(opts, stdin, llvm::outs(), std::cerr);
+
+	std::string source, output;
+	char buffer[1 << 16];
+	for(size_t n; (n = fread(buffer, 1, sizeof(buffer), stdin)) > 0; )
+		source.append(buffer, n);
+	const int status = compile_source(source, opts, output, std::cerr, cache.get());
+	llvm::outs() << output;
+	return status;
 }
@@ -0,0 +1,52 @@
+#ifndef __POOL_HPP__
+#define __POOL_HPP__
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Runs jobs 0..n-1 on a number of threads. Every worker starts with its share of the jobs
+ * and, once it's out of work, steals from the back of the others' queues, so a few huge
+ * jobs (files in a batch, partitions of a module) don't leave the rest of the workers idle.
+ */
+class work_stealing_pool {
+	public:
+		template<class F>
+		static void run(const unsigned long long n, unsigned workers, F job) {
+			workers = std::max(1u, std::min<unsigned>(workers, n));
+			std::vector<job_queue> queues(workers);
+			for(unsigned long long i = 0; i < n; ++i)
+				queues[i % workers].jobs.push_back(i);
+
+			std::vector<std::thread> threads;
+			for(unsigned w = 0; w < workers; ++w)
+				threads.emplace_back([&queues, &job, w, workers] {
+					unsigned long long i;
+					while(take(queues[w], true, i) || steal(queues, w, workers, i))
+						job(i);
+				});
+			for(auto &t : threads) t.join();
+		}
+	private:
+		struct job_queue {
+			std::mutex m;
+			std::deque<unsigned long long> jobs;
+		};
+		static bool take(job_queue &q, const bool front, unsigned long long &i) {
+			std::lock_guard<std::mutex> lock(q.m);
+			if(q.jobs.empty()) return false;
+			if(front) { i = q.jobs.front(); q.jobs.pop_front(); }
+			else      { i = q.jobs.back();  q.jobs.pop_back(); }
+			return true;
+		}
+		static bool steal(std::vector<job_queue> &queues, const unsigned w, const unsigned workers, unsigned long long &i) {
+			// no job creates new jobs, so when every queue is empty the work is done
+			for(unsigned v = (w + 1) % workers; v != w; v = (v + 1) % workers)
+				if(take(queues[v], false, i)) return true;
+			return false;
+		}
+};
+
+#endif
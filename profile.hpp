@@ -0,0 +1,175 @@
+#ifndef __PROFILE_HPP__
+#define __PROFILE_HPP__
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <llvm/Analysis/BlockFrequencyInfo.h>
+#include <llvm/Analysis/CGSCCPassManager.h>
+#include <llvm/Analysis/LoopAnalysisManager.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Transforms/IPO/HotColdSplitting.h>
+#include <llvm/Transforms/IPO/Inliner.h>
+#include <llvm/Transforms/InstCombine/InstCombine.h>
+#include <llvm/Transforms/Instrumentation/PGOInstrumentation.h>
+#include <llvm/Transforms/Scalar/SROA.h>
+#include <llvm/Transforms/Scalar/SimplifyCFG.h>
+
+#include "driver.hpp"
+#include "session.hpp"
+
+/* -fprofile-generate[=file] and -fprofile-use=file: profile guided optimization with llvm's IR level instrumentation.
+ * Both run on the whole module once all its functions are compiled (and optimized), so a program must be
+ * compiled with the same -O flags to be instrumented and to use its profile.
+ * libgrc is the profile runtime: the counters are plain arrays of the program, and the program writes them
+ * when it exits in llvm's text profile format (see libgrc/src/profile.c), which llvm-profdata can merge.
+ * The profile gives the branches their weights and the functions their entry counts; with -O the hot calls are
+ * inlined and the cold code is split out of the functions, and the backend lays out the blocks after the weights.
+ */
+class profile_guide {
+	public:
+		static void generate(llvm::Module &m, const std::string &file) {
+			run_passes(m, [](llvm::ModulePassManager &MPM) { MPM.addPass(llvm::PGOInstrumentationGen()); });
+			lower(m, file);
+		}
+
+		static void use(llvm::Module &m, const std::string &path, const bool optimize) {
+			std::string converted;
+			const std::string indexed = indexed_profile(path, converted);
+			run_passes(m, [&](llvm::ModulePassManager &MPM) {
+				MPM.addPass(llvm::PGOInstrumentationUse(indexed));
+				if(!optimize) return;
+				MPM.addPass(llvm::ModuleInlinerWrapperPass(llvm::getInlineParams(2, 0))); // the hot calls get a higher threshold, the cold ones a lower one
+				llvm::FunctionPassManager FPM; // the frames of the inlined functions become registers
+				FPM.addPass(llvm::SROAPass(llvm::SROAOptions::ModifyCFG));
+				FPM.addPass(llvm::InstCombinePass());
+				FPM.addPass(llvm::SimplifyCFGPass());
+				MPM.addPass(llvm::createModuleToFunctionPassAdaptor(std::move(FPM)));
+				MPM.addPass(split_cold_code());
+			});
+			if(!converted.empty()) unlink(converted.c_str());
+		}
+	private:
+		/* HotColdSplitting takes the functions whose entry is cold for cold altogether (they are optimized for size),
+		 * but main runs once and any function called a few times can loop: while it runs, their entry counts are
+		 * hidden from it unless the whole function is cold, so it splits the cold code out of them instead.
+		 */
+		class split_cold_code : public llvm::PassInfoMixin<split_cold_code> {
+			public:
+				llvm::PreservedAnalyses run(llvm::Module &m, llvm::ModuleAnalysisManager &MAM) {
+					llvm::ProfileSummaryInfo &PSI = MAM.getResult<llvm::ProfileSummaryAnalysis>(m);
+					llvm::FunctionAnalysisManager &FAM = MAM.getResult<llvm::FunctionAnalysisManagerModuleProxy>(m).getManager();
+					std::vector<std::pair<llvm::Function*, uint64_t>> hidden;
+					for(llvm::Function &f : m)
+						if(!f.isDeclaration() && PSI.isFunctionEntryCold(&f) && !PSI.isFunctionColdInCallGraph(&f, FAM.getResult<llvm::BlockFrequencyAnalysis>(f))) {
+							hidden.emplace_back(&f, f.getEntryCount()->getCount());
+							f.setMetadata(llvm::LLVMContext::MD_prof, nullptr);
+						}
+					FAM.clear();
+					llvm::HotColdSplittingPass().run(m, MAM);
+					for(const auto &h : hidden) h.first->setEntryCount(h.second);
+					return llvm::PreservedAnalyses::none();
+				}
+		};
+
+		template<class Add> static void run_passes(llvm::Module &m, Add add) {
+			llvm::LoopAnalysisManager LAM;
+			llvm::FunctionAnalysisManager FAM;
+			llvm::CGSCCAnalysisManager CGAM;
+			llvm::ModuleAnalysisManager MAM;
+			llvm::PassBuilder PB(session->target); // (none for IR)
+			PB.registerModuleAnalyses(MAM);
+			PB.registerCGSCCAnalyses(CGAM);
+			PB.registerFunctionAnalyses(FAM);
+			PB.registerLoopAnalyses(LAM);
+			PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+			llvm::ModulePassManager MPM;
+			add(MPM);
+			MPM.run(m, MAM);
+		}
+
+		/* The instrumentation increments its counters through intrinsics llvm lowers for its own runtime (compiler-rt).
+		 * Here every function gets an array of counters the intrinsics become increments of, and main hands the
+		 * table of the arrays to libgrc.
+		 */
+		static void lower(llvm::Module &m, const std::string &file) {
+			llvm::LLVMContext &c = m.getContext();
+			llvm::Type* const i64 = llvm::Type::getInt64Ty(c);
+			llvm::Type* const ptr = llvm::PointerType::get(llvm::Type::getInt8Ty(c), 0);
+			llvm::StructType* const entry_t = llvm::StructType::get(c, {ptr, i64, i64, i64, ptr}); // name, its length, hash, counters
+
+			std::map<llvm::GlobalVariable*, llvm::GlobalVariable*> counters; // of every function (by its name variable)
+			std::vector<llvm::Constant*> table;
+			for(llvm::Function &f : m)
+				for(llvm::BasicBlock &b : f)
+					for(llvm::Instruction &i : llvm::make_early_inc_range(b)) {
+						if(llvm::isa<llvm::InstrProfValueProfileInst>(&i)) { // (of indirect calls and memory intrinsics, grace has none)
+							i.eraseFromParent();
+							continue;
+						}
+						llvm::IntrinsicInst* const intrinsic = llvm::dyn_cast<llvm::IntrinsicInst>(&i);
+						if(intrinsic == nullptr || (intrinsic->getIntrinsicID() != llvm::Intrinsic::instrprof_increment &&
+						                            intrinsic->getIntrinsicID() != llvm::Intrinsic::instrprof_increment_step)) continue;
+						llvm::InstrProfIncrementInst* const inc = static_cast<llvm::InstrProfIncrementInst*>(intrinsic); // (and the step one)
+						llvm::GlobalVariable* const name = inc->getName();
+						const uint64_t n = inc->getNumCounters()->getZExtValue();
+						llvm::ArrayType* const t = llvm::ArrayType::get(i64, n);
+						llvm::GlobalVariable *&counter = counters[name];
+						if(counter == nullptr) {
+							counter = new llvm::GlobalVariable(m, t, false, llvm::GlobalValue::PrivateLinkage, llvm::ConstantAggregateZero::get(t), "__grc_counters");
+							name->setLinkage(llvm::GlobalValue::PrivateLinkage);
+							name->setComdat(nullptr);
+							table.push_back(llvm::ConstantStruct::get(entry_t, {name, llvm::ConstantInt::get(i64, name->getValueType()->getArrayNumElements()),
+								inc->getHash(), llvm::ConstantInt::get(i64, n), counter}));
+						}
+						llvm::IRBuilder<> b(inc);
+						llvm::Value* const at = b.CreateConstInBoundsGEP2_64(t, counter, 0, inc->getIndex()->getZExtValue());
+						b.CreateStore(b.CreateAdd(b.CreateLoad(i64, at), inc->getStep()), at);
+						inc->eraseFromParent();
+					}
+			if(llvm::GlobalVariable* const version = m.getNamedGlobal("__llvm_profile_raw_version")) // (for compiler-rt)
+				version->eraseFromParent();
+			for(llvm::Function &f : llvm::make_early_inc_range(m))
+				if(f.isIntrinsic() && f.use_empty()) f.eraseFromParent();
+
+			llvm::Function* const main = m.getFunction("main");
+			if(main == nullptr || main->isDeclaration()) return;
+			llvm::ArrayType* const table_t = llvm::ArrayType::get(entry_t, table.size());
+			llvm::GlobalVariable* const functions = new llvm::GlobalVariable(m, table_t, true, llvm::GlobalValue::PrivateLinkage,
+				llvm::ConstantArray::get(table_t, table), "__grc_profiled_functions");
+			llvm::FunctionCallee init = m.getOrInsertFunction("__grc_profile_init", llvm::Type::getVoidTy(c), ptr, i64, ptr);
+			llvm::IRBuilder<> b(&*main->getEntryBlock().getFirstInsertionPt());
+			b.CreateCall(init, {functions, llvm::ConstantInt::get(i64, table.size()), b.CreateGlobalStringPtr(file, "__grc_profile_file")});
+		}
+
+		/* llvm reads indexed profiles, the text ones libgrc writes are converted with llvm-profdata */
+		static std::string indexed_profile(const std::string &path, std::string &converted) {
+			std::ifstream f(path, std::ios::binary);
+			if(!f) {
+				session->diag << "can't read the profile " << path << std::endl;
+				throw compile_error(1);
+			}
+			char magic[8] = {};
+			f.read(magic, sizeof(magic));
+			if(!memcmp(magic, "\xfflprofi\x81", sizeof(magic))) return path;
+			converted = write_temporary("", ".profdata");
+			if(converted.empty() || system(("llvm-profdata merge -o " + converted + ' ' + path).c_str()) != 0) {
+				if(!converted.empty()) unlink(converted.c_str());
+				session->diag << "can't convert the profile " << path << " with llvm-profdata" << std::endl;
+				throw compile_error(1);
+			}
+			return converted;
+		}
+};
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef __REMARKS_HPP__
+#define __REMARKS_HPP__
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/IR/DiagnosticHandler.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/LLVMRemarkStreamer.h>
+#include <llvm/Remarks/RemarkFormat.h>
+#include <llvm/Remarks/RemarkSerializer.h>
+#include <llvm/Remarks/RemarkStreamer.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/Support/ToolOutputFile.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "session.hpp"
+
+/* -Rpass=regex, -Rpass-missed=regex, -Rpass-analysis=regex and -fsave-optimization-record[=yaml|bitstream]:
+ * the remarks of llvm's passes (what they did, what they couldn't do and why) about the Grace program.
+ * The passes are the ones grc runs itself: the -O function passes, the -fprofile-use inliner and the backend
+ * when grc generates the final code (-O0/-Og, -c, --exe).
+ * The code keeps the lines of the Grace source even without -g (a compile unit that emits no DWARF), so every
+ * remark has the function (by its nested name, like main.outer.inner) and the line and column it's about.
+ * -Rpass* print the remarks of the passes whose name matches, like clang does, and the records have all of them
+ * (with the hotness of -fprofile-use). Along with the records, or with -Rpass-missed, the missed optimizations
+ * in loops are summed up at the end, the hottest (or the most deeply nested) first.
+ */
+class optimization_remarks {
+	public:
+		optimization_remarks(llvm::LLVMContext &c, const compile_options &opts)
+		: passed(regex(opts.remarks_passed)), missed(regex(opts.remarks_missed)), analysis(regex(opts.remarks_analysis)),
+		  summary(opts.records() || !opts.remarks_missed.empty()), file(opts.file) {
+			if(opts.records()) {
+				const std::string format = opts.remarks_format.empty() ? "yaml" : opts.remarks_format;
+				const std::string path = opts.remarks_file.empty() ? record_path(opts.file, format) : opts.remarks_file;
+				llvm::Expected<llvm::remarks::Format> f = llvm::remarks::parseFormat(format);
+				if(!f) {
+					session->diag << "-fsave-optimization-record: " << llvm::toString(f.takeError()) << std::endl;
+					throw compile_error(1);
+				}
+				std::error_code error;
+				record = std::make_unique<llvm::ToolOutputFile>(path, error, llvm::sys::fs::OF_None);
+				if(error) {
+					session->diag << "can't write the optimization records to " << path << ": " << error.message() << std::endl;
+					throw compile_error(1);
+				}
+				streamer = std::make_unique<llvm::remarks::RemarkStreamer>(
+					llvm::cantFail(llvm::remarks::createRemarkSerializer(*f, llvm::remarks::SerializerMode::Separate, record->os())), llvm::StringRef(path));
+				llvm_streamer = std::make_unique<llvm::LLVMRemarkStreamer>(*streamer);
+			}
+			c.setDiagnosticsHotnessRequested(!opts.profile_use.empty());
+			c.setDiagnosticHandler(std::make_unique<handler>(*this));
+		}
+
+		/* the loop depth of the lines of f, before the optimizations move its code around */
+		void loops(llvm::Function &f) {
+			llvm::DominatorTree dt(f);
+			llvm::LoopInfo li(dt);
+			for(llvm::BasicBlock &bb : f) {
+				const unsigned d = li.getLoopDepth(&bb);
+				if(d == 0) continue;
+				for(llvm::Instruction &i : bb)
+					if(const llvm::DebugLoc &l = i.getDebugLoc()) {
+						unsigned &depth = depths[{f.getName().str(), l.getLine()}];
+						depth = std::max(depth, d);
+					}
+			}
+		}
+
+		/* once the code is generated */
+		void finish() {
+			if(record != nullptr) {
+				llvm_streamer = nullptr;
+				streamer      = nullptr;
+				record->keep();
+				record = nullptr;
+			}
+			if(!summary || in_loops.empty()) return;
+			std::vector<const missed_remark*> top;
+			for(const auto &m : in_loops) top.push_back(&m.second);
+			std::sort(top.begin(), top.end(), [](const missed_remark *a, const missed_remark *b) {
+				return std::make_tuple(b->hotness, b->depth, a->line, a->column) < std::make_tuple(a->hotness, a->depth, b->line, b->column);
+			});
+			session->diag << "missed optimizations in loops (" << std::min(top.size(), shown) << " of " << top.size() << "):" << std::endl;
+			for(size_t i = 0; i < top.size() && i < shown; ++i) {
+				const missed_remark &m = *top[i];
+				session->diag << "  " << file << ':' << m.line << ':' << m.column << " in " << m.function << " (loop depth " << m.depth;
+				if(m.hotness > 0) session->diag << ", hotness " << m.hotness;
+				session->diag << "): " << m.pass << ": " << m.message;
+				session->diag << std::endl;
+			}
+		}
+	private:
+		class handler : public llvm::DiagnosticHandler {
+			public:
+				handler(optimization_remarks &r) : remarks(r) {}
+				bool handleDiagnostics(const llvm::DiagnosticInfo &d) override {
+					const llvm::DiagnosticInfoOptimizationBase* const r = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&d);
+					if(r == nullptr) return false; // (the default handler prints the rest)
+					remarks.add(*r);
+					return true;
+				}
+				bool isPassedOptRemarkEnabled(llvm::StringRef pass) const override { return remarks.record != nullptr || matches(remarks.passed, pass); }
+				bool isMissedOptRemarkEnabled(llvm::StringRef pass) const override { return remarks.summary || matches(remarks.missed, pass); }
+				bool isAnalysisRemarkEnabled(llvm::StringRef pass) const override { return remarks.record != nullptr || matches(remarks.analysis, pass); }
+				bool isAnyRemarkEnabled() const override { return true; }
+			private:
+				optimization_remarks &remarks;
+		};
+
+		struct missed_remark {
+			std::string function, pass, message;
+			unsigned line, column, depth;
+			uint64_t hotness;
+		};
+
+		void add(const llvm::DiagnosticInfoOptimizationBase &r) {
+			if(llvm_streamer != nullptr) llvm_streamer->emit(r);
+			const llvm::StringRef pass = r.getPassName();
+			std::string message; // (with the extra arguments, the why of the missed ones)
+			for(const llvm::DiagnosticInfoOptimizationBase::Argument &a : r.getArgs()) message += a.Val;
+			unsigned line = 0, column = 0;
+			if(r.isLocationAvailable()) {
+				line   = r.getLocation().getLine();
+				column = r.getLocation().getColumn();
+			}
+			const std::unique_ptr<llvm::Regex> &shown_if = r.isPassed() ? passed : r.isMissed() ? missed : analysis;
+			const char* const flag = r.isPassed() ? "-Rpass=" : r.isMissed() ? "-Rpass-missed=" : "-Rpass-analysis=";
+			if(matches(shown_if, pass)) { // the way clang prints them
+				session->diag << file << ':' << line << ':' << column << ": remark: " << message;
+				if(r.getHotness()) session->diag << " (hotness: " << *r.getHotness() << ')';
+				session->diag << " [" << flag << pass.str() << ']' << std::endl;
+			}
+			if(!summary || !r.isMissed() || line == 0) return;
+			const std::string function = r.getFunction().getName().str();
+			const auto d = depths.find({function, line});
+			const uint64_t hotness = r.getHotness() ? *r.getHotness() : 0;
+			if(d == depths.end() && hotness == 0) return;
+			const auto key = std::make_tuple(function, line, column, pass.str(), message); // (gvn repeats itself while it changes something)
+			auto m = in_loops.find(key);
+			if(m == in_loops.end()) in_loops.emplace(key, missed_remark{function, pass.str(), message, line, column, d != depths.end() ? d->second : 0, hotness});
+			else m->second.hotness = std::max(m->second.hotness, hotness);
+		}
+
+		static std::unique_ptr<llvm::Regex> regex(const std::string &pattern) {
+			if(pattern.empty()) return nullptr;
+			std::unique_ptr<llvm::Regex> r = std::make_unique<llvm::Regex>(pattern);
+			std::string error;
+			if(!r->isValid(error)) {
+				session->diag << "bad -Rpass regex " << pattern << ": " << error << std::endl;
+				throw compile_error(1);
+			}
+			return r;
+		}
+		static bool matches(const std::unique_ptr<llvm::Regex> &r, const llvm::StringRef pass) { return r != nullptr && r->match(pass); }
+
+		/* the records go next to the source (they're named after it), in the current directory if it's stdin */
+		static std::string record_path(const std::string &file, const std::string &format) {
+			llvm::SmallString<256> path(file == "<stdin>" ? "grc" : file);
+			llvm::sys::path::replace_extension(path, "opt." + format);
+			return path.str().str();
+		}
+
+		static constexpr size_t shown = 10; // missed optimizations in the summary
+
+		const std::unique_ptr<llvm::Regex> passed, missed, analysis; // of the -Rpass* flags that were given
+		const bool summary;
+		const std::string file;
+		// the records are streamed by the handler, with the context's streamer the backend would put the metadata
+		// of bitstream records in a section of the object (that only Mach-O has)
+		std::unique_ptr<llvm::ToolOutputFile>          record;
+		std::unique_ptr<llvm::remarks::RemarkStreamer> streamer;
+		std::unique_ptr<llvm::LLVMRemarkStreamer>      llvm_streamer;
+		std::map<std::pair<std::string, unsigned>, unsigned> depths; // of the lines in loops, by function
+		std::map<std::tuple<std::string, unsigned, unsigned, std::string, std::string>, missed_remark> in_loops;
+};
+
+#endif
@@ -1,5 +1,8 @@
 #include "ast.hpp"
 
+/* nodes own (and free) their names, like the ones the lexer makes */
+static Id *id(const char* const name) { return new Id(strdup(name)); }
+
 /* Runtime Library Function Formal Parameters */
 /* 1. IO funs */
 Ret_type rNothing(nullptr);
@@ -9,7 +12,7 @@ Ret_type rChar(new Data_type(CHAR));
 Fpar_def_list writeInteger_pars(
 	new Fpar_def(
 		false,
-		new Id_list(new Id("n")),
+		new Id_list(id("n")),
 		new Fpar_type(
 			new Data_type(INT),
 			false,
@@ -21,7 +24,7 @@ Fpar_def_list writeInteger_pars(
 Fpar_def_list writeChar_pars(
 	new Fpar_def(
 		false,
-		new Id_list(new Id("c")),
+		new Id_list(id("c")),
 		new Fpar_type(
 			new Data_type(CHAR),
 			false,
@@ -33,7 +36,7 @@ Fpar_def_list writeChar_pars(
 Fpar_def_list writeString_pars(
 	new Fpar_def(
 		true,
-		new Id_list(new Id("s")),
+		new Id_list(id("s")),
 		new Fpar_type(
 			new Data_type(CHAR),
 			true,
@@ -48,7 +51,7 @@ Fpar_def_list writeString_pars(
 Fpar_def_list readString_pars(
 	new Fpar_def(
 		false,
-		new Id_list(new Id("n")),
+		new Id_list(id("n")),
 		new Fpar_type(
 			new Data_type(INT),
 			false,
@@ -61,7 +64,7 @@ Fpar_def_list readString_pars(
 Fpar_def_list ascii_pars(
 	new Fpar_def(
 		false,
-		new Id_list(new Id("c")),
+		new Id_list(id("c")),
 		new Fpar_type(
 			new Data_type(CHAR),
 			false,
@@ -73,7 +76,7 @@ Fpar_def_list ascii_pars(
 Fpar_def_list chr_pars(
 	new Fpar_def(
 		false,
-		new Id_list(new Id("n")),
+		new Id_list(id("n")),
 		new Fpar_type(
 			new Data_type(INT),
 			false,
@@ -86,7 +89,7 @@ Fpar_def_list chr_pars(
 Fpar_def_list strlen_pars(
 	new Fpar_def(
 		true,
-		new Id_list(new Id("s")),
+		new Id_list(id("s")),
 		new Fpar_type(
 			new Data_type(CHAR),
 			true,
@@ -95,11 +98,11 @@ Fpar_def_list strlen_pars(
 	)
 );
 
-Id_list strcmp_id_list(new Id("s1"));
+Id_list *strcmp_id_list = new Id_list(id("s1"));
 Fpar_def_list strcmp_pars(
 	new Fpar_def(
 		true,
-		&strcmp_id_list,
+		strcmp_id_list,
 		new Fpar_type(
 			new Data_type(CHAR),
 			true,
@@ -108,11 +111,11 @@ Fpar_def_list strcmp_pars(
 	)
 );
 
-Id_list strcpy_id_list(new Id("trg"));
+Id_list *strcpy_id_list = new Id_list(id("trg"));
 Fpar_def_list strcpy_pars(
 	new Fpar_def(
 		true,
-		&strcpy_id_list,
+		strcpy_id_list,
 		new Fpar_type(
 			new Data_type(CHAR),
 			true,
@@ -121,11 +124,11 @@ Fpar_def_list strcpy_pars(
 	)
 );
 
-Id_list strcat_id_list(new Id("trg"));
+Id_list *strcat_id_list = new Id_list(id("trg"));
 Fpar_def_list strcat_pars(
 	new Fpar_def(
 		true,
-		&strcat_id_list,
+		strcat_id_list,
 		new Fpar_type(
 			new Data_type(CHAR),
 			true,
@@ -134,11 +137,11 @@ Fpar_def_list strcat_pars(
 	)
 );
 
-void finish_runtime_syms() { // needed by symbol_table for runtime lib formal params
+static bool finish_runtime_syms() { // needed by symbol_table for runtime lib formal params
 	readString_pars.append(
 		new Fpar_def(
 			true,
-			new Id_list(new Id("s")),
+			new Id_list(id("s")),
 			new Fpar_type(
 				new Data_type(CHAR),
 				true,
@@ -147,7 +150,10 @@ void finish_runtime_syms() { // needed by symbol_table for runtime lib formal pa
 		)
 	);
 
-	strcmp_id_list.append(new Id("s2"));
-	strcpy_id_list.append(new Id("src"));
-	strcat_id_list.append(new Id("src"));
+	strcmp_id_list->append(id("s2"));
+	strcpy_id_list->append(id("src"));
+	strcat_id_list->append(id("src"));
+	return true;
 }
+// done once, before any symbol table exists, so symbol tables (and compilations) can share them
+static const bool runtime_syms_finished = finish_runtime_syms();
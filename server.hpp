@@ -0,0 +1,230 @@
+#ifndef __SERVER_HPP__
+#define __SERVER_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ast.hpp"
+#include "driver.hpp"
+#include "session.hpp"
+
+/* grc --serve <socket>: a persistent compile server, so callers don't pay for starting grc (and
+ * initializing llvm) on every program. Every connection can send any number of requests:
+ *
+ *   request:  a line of options (the ones grc takes, --exe for a linked executable),
+ *             a line with the size of the source and then the source itself
+ *   response: a line "<exit status> <output size> <diagnostics size>", the output and the diagnostics
+ *
+ * A size that isn't a number of at most max_source bytes gets an error response and ends the connection
+ * (the server can't know where the next request starts).
+ * The option line --stats asks for the number of requests served and their latency percentiles
+ * (and the hits and misses of the cache, with --cache).
+ * grc-client (client.c) is a thin client for it.
+ */
+
+class connection {
+	public:
+		connection(int f) : fd(f), pos(0), end(0) {}
+		~connection() { close(fd); }
+
+		bool line(std::string &l) {
+			l.clear();
+			for(;;) {
+				if(pos == end && !fill()) return false;
+				char c = buf[pos++];
+				if(c == '\n') return true;
+				l += c;
+			}
+		}
+		bool bytes(std::string &s, size_t n) {
+			s.clear();
+			s.reserve(n);
+			while(s.size() < n) {
+				if(pos == end && !fill()) return false;
+				const size_t k = std::min(n - s.size(), end - pos);
+				s.append(buf + pos, k);
+				pos += k;
+			}
+			return true;
+		}
+		bool send(const std::string &s) {
+			for(size_t done = 0; done < s.size(); ) {
+				const ssize_t k = write(fd, s.data() + done, s.size() - done);
+				if(k <= 0) return false;
+				done += k;
+			}
+			return true;
+		}
+	private:
+		bool fill() {
+			const ssize_t k = read(fd, buf, sizeof(buf));
+			if(k <= 0) return false;
+			pos = 0;
+			end = k;
+			return true;
+		}
+		int fd;
+		char buf[4096];
+		size_t pos, end;
+};
+
+/* Target machines are expensive to create and can't be used by two compilations at once,
+ * so the server keeps the ones that aren't in use (one set for -O0/-Og, one for the rest)
+ */
+class target_machine_pool {
+	public:
+		void warm_up() { // more are created when requests come in at the same time, and then kept
+			release(false, AST::create_target_machine(false));
+			release(true,  AST::create_target_machine(true));
+		}
+		std::unique_ptr<llvm::TargetMachine> acquire(const bool fast) {
+			{
+				std::lock_guard<std::mutex> lock(m);
+				if(!idle[fast].empty()) {
+					std::unique_ptr<llvm::TargetMachine> tm = std::move(idle[fast].back());
+					idle[fast].pop_back();
+					return tm;
+				}
+			}
+			return AST::create_target_machine(fast);
+		}
+		void release(const bool fast, std::unique_ptr<llvm::TargetMachine> tm) {
+			std::lock_guard<std::mutex> lock(m);
+			idle[fast].push_back(std::move(tm));
+		}
+	private:
+		std::mutex m;
+		std::vector<std::unique_ptr<llvm::TargetMachine>> idle[2];
+};
+
+class latency_stats {
+	public:
+		void record(const double us, const int status) {
+			std::lock_guard<std::mutex> lock(m);
+			latencies.push_back(us);
+			if(status != 0) ++failed;
+		}
+		std::string report() {
+			std::lock_guard<std::mutex> lock(m);
+			std::ostringstream r;
+			r << "requests " << latencies.size() << " failed " << failed;
+			if(!latencies.empty())
+				r << " p50 " << percentile(0.50) << " us p99 " << percentile(0.99) << " us max " << *std::max_element(latencies.begin(), latencies.end()) << " us";
+			r << '\n';
+			return r.str();
+		}
+	private:
+		double percentile(const double p) { // nearest rank
+			std::vector<double> l(latencies);
+			const size_t k = std::min(l.size() - 1, (size_t)(p * l.size()));
+			std::nth_element(l.begin(), l.begin() + k, l.end());
+			return l[k];
+		}
+		std::mutex m;
+		std::vector<double> latencies; // in microseconds
+		unsigned long long failed = 0;
+};
+
+class compile_server {
+	public:
+		compile_server(compile_cache* const c=nullptr) : cache(c) {}
+
+		int serve(const char* const path) {
+			signal(SIGPIPE, SIG_IGN); // a client that goes away only ends its own connection
+			const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+			sockaddr_un addr = {};
+			addr.sun_family = AF_UNIX;
+			if(fd < 0 || strlen(path) >= sizeof(addr.sun_path)) {
+				std::cerr << "can't serve on " << path << std::endl;
+				return 1;
+			}
+			strcpy(addr.sun_path, path);
+			unlink(path); // left behind by a previous server
+			if(bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+				perror(path);
+				return 1;
+			}
+			targets.warm_up();
+			std::string warm_up = "fun main(): nothing {}", output; // so the first request doesn't pay for the lazily built state either
+			std::ostringstream diag;
+			compile_options opts;
+			opts.emit = EMIT_OBJ;
+			compile_source(warm_up, opts, output, diag);
+			std::cerr << "grc serving on " << path << std::endl;
+
+			for(;;) {
+				const int client = accept(fd, nullptr, nullptr);
+				if(client < 0) continue;
+				std::thread([this, client] { handle(client); }).detach();
+			}
+		}
+	private:
+		void handle(const int fd) {
+			connection c(fd);
+			std::string options, size, source;
+			while(c.line(options) && c.line(size)) {
+				size_t n;
+				if(!source_size(size, n)) {
+					c.send(response(1, "", "bad source size " + size + " (at most " + std::to_string(max_source) + " bytes)\n"));
+					return;
+				}
+				if(!c.bytes(source, n)) return;
+				if(options == "--stats") {
+					if(!c.send(response(0, stats.report() + (cache ? cache->report() : ""), ""))) return;
+					continue;
+				}
+				const auto start = std::chrono::steady_clock::now();
+				std::string output, diag;
+				const int status = compile(options, source, output, diag);
+				stats.record(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count(), status);
+				if(!c.send(response(status, output, diag))) return;
+			}
+		}
+
+		int compile(const std::string &options, std::string &source, std::string &output, std::string &diag) {
+			compile_options opts;
+			std::istringstream words(options);
+			for(std::string w; words >> w; )
+				if(!parse_compile_option(w.c_str(), opts)) {
+					diag = bad_option(w) + '\n';
+					return 1;
+				}
+
+			std::ostringstream d;
+			std::unique_ptr<llvm::TargetMachine> tm = targets.acquire(opts.fast);
+			const int status = compile_source(source, opts, output, d, cache, tm.get());
+			targets.release(opts.fast, std::move(tm));
+			diag = d.str();
+			return status;
+		}
+
+		static const size_t max_source = 64 << 20; // bytes, what a request can make the server allocate for its source
+
+		static bool source_size(const std::string &line, size_t &n) { // only digits, and not too many
+			if(line.empty() || line.size() > 9 || line.find_first_not_of("0123456789") != std::string::npos) return false;
+			n = strtoull(line.c_str(), nullptr, 10);
+			return n <= max_source;
+		}
+
+		static std::string response(const int status, const std::string &output, const std::string &diag) {
+			return std::to_string(status) + ' ' + std::to_string(output.size()) + ' ' + std::to_string(diag.size()) + '\n' + output + diag;
+		}
+
+		target_machine_pool targets;
+		latency_stats stats;
+		compile_cache* const cache;
+};
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef __SESSION_HPP__
+#define __SESSION_HPP__
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include "symbol_table.hpp"
+#include "ll_st.hpp"
+
+enum emit_kind { EMIT_IR, EMIT_ASM, EMIT_OBJ }; // what llvm_compile_and_dump writes to the output
+enum debug_kind { DEBUG_NONE, DEBUG_LINES, DEBUG_FULL }; // -g0, -gline-tables-only, -g (see debug.hpp)
+
+struct compile_options {
+	bool optimize     = false;
+	bool fast         = false; // -O0/-Og
+	bool frame_layout = false;
+	emit_kind emit    = EMIT_IR;
+	bool exe          = false; // --exe: emit an object and link it with libgrc
+	unsigned threads  = 0;     // -jN: objects are generated on N threads (0 is on one, without splitting the module)
+	bool stream       = false; // --stream: every function is emitted (and freed) as soon as it's parsed
+	bool reentrant    = false; // --reentrant: main allocates its frame on every call, so many threads can run it at once
+	bool fork_server  = false; // --fork-server: with GRC_FORK_SERVER set the program runs main once per request (see libgrc/src/fork.c)
+	bool auto_memo    = false; // -fauto-memo: pure recursive int functions remember their results (see Func_def::memoize)
+	bool freestanding = false; // --freestanding: the executable is linked statically with a runtime without libc (see libgrc/freestanding)
+	bool interp       = false; // --interp: grc runs the program itself (see interp.hpp), only on the command line
+	debug_kind debug  = DEBUG_NONE;
+	std::string file  = "<stdin>"; // --file=path: the name of the source in the debug info
+	std::string profile_generate;  // -fprofile-generate[=file]: where the instrumented program writes its profile
+	std::string profile_use;       // -fprofile-use=file (see profile.hpp)
+	bool profile_calls = false;    // -pg: every function counts its calls and the time spent in it (see Func_def::count_calls)
+	unsigned long long budget = 0; // --budget[=N]: the program stops after about N instructions (see Func_def::meter)
+	std::string remarks_passed, remarks_missed, remarks_analysis; // -Rpass=, -Rpass-missed=, -Rpass-analysis= (regexes of pass names)
+	std::string remarks_format;    // -fsave-optimization-record[=format]: yaml or bitstream records (see remarks.hpp)
+	std::string remarks_file;      // -foptimization-record-file=path (yaml if there's no format)
+
+	bool remarks() const { return !remarks_passed.empty() || !remarks_missed.empty() || !remarks_analysis.empty() || records(); }
+	bool records() const { return !remarks_format.empty() || !remarks_file.empty(); }
+};
+
+/* --budget=N: a positive number of instructions (0 would be no budget at all), false if n isn't one */
+inline bool parse_budget(const char* const n, unsigned long long &budget) {
+	char *end;
+	errno = 0;
+	budget = strtoull(n, &end, 10);
+	return *n >= '0' && *n <= '9' && *end == '\0' && errno == 0 && budget != 0;
+}
+
+/* sets the option arg stands for, false if arg isn't one (shared by the command line and --serve requests) */
+inline bool parse_compile_option(const char* const arg, compile_options &opts) {
+	if(!strcmp(arg, "--frame-layout"))                   opts.frame_layout = true;
+	else if(!strcmp(arg, "-O0") || !strcmp(arg, "-Og"))  opts.fast         = true;
+	else if(!strcmp(arg, "-S"))                          opts.emit         = EMIT_ASM;
+	else if(!strcmp(arg, "-c"))                          opts.emit         = EMIT_OBJ;
+	else if(!strcmp(arg, "-O"))                          opts.optimize     = true;
+	else if(!strcmp(arg, "--exe"))                       opts.exe          = true;
+	else if(!strcmp(arg, "--stream"))                    opts.stream       = true;
+	else if(!strcmp(arg, "--reentrant"))                 opts.reentrant    = true;
+	else if(!strcmp(arg, "--fork-server"))               opts.fork_server  = true;
+	else if(!strcmp(arg, "--freestanding"))              opts.freestanding = true;
+	else if(!strcmp(arg, "-g"))                          opts.debug        = DEBUG_FULL;
+	else if(!strcmp(arg, "-gline-tables-only"))          opts.debug        = DEBUG_LINES;
+	else if(!strcmp(arg, "-g0"))                         opts.debug        = DEBUG_NONE;
+	else if(!strncmp(arg, "--file=", 7))                 opts.file         = arg + 7;
+	else if(!strcmp(arg, "-fprofile-generate"))          opts.profile_generate = "default.proftext";
+	else if(!strncmp(arg, "-fprofile-generate=", 19))    opts.profile_generate = arg + 19;
+	else if(!strncmp(arg, "-fprofile-use=", 14))         opts.profile_use      = arg + 14;
+	else if(!strcmp(arg, "-pg"))                         opts.profile_calls = true;
+	else if(!strcmp(arg, "-fauto-memo"))                 opts.auto_memo    = true;
+	else if(!strcmp(arg, "--budget"))                    opts.budget       = 10000000000ull;
+	else if(!strncmp(arg, "--budget=", 9))               return parse_budget(arg + 9, opts.budget);
+	else if(!strncmp(arg, "-Rpass=", 7))                 opts.remarks_passed   = arg + 7;
+	else if(!strncmp(arg, "-Rpass-missed=", 14))         opts.remarks_missed   = arg + 14;
+	else if(!strncmp(arg, "-Rpass-analysis=", 16))       opts.remarks_analysis = arg + 16;
+	else if(!strcmp(arg, "-fsave-optimization-record"))  opts.remarks_format   = "yaml";
+	else if(!strncmp(arg, "-fsave-optimization-record=", 27)) opts.remarks_format = arg + 27;
+	else if(!strncmp(arg, "-foptimization-record-file=", 27)) opts.remarks_file   = arg + 27;
+	else if(!strncmp(arg, "-j", 2))                      opts.threads      = arg[2] ? atoi(arg + 2) : std::thread::hardware_concurrency();
+	else return false;
+	return true;
+}
+inline std::string bad_option(const std::string &arg) { // why parse_compile_option refused arg
+	if(!arg.compare(0, 9, "--budget=")) return arg + ": the budget is a positive number of instructions";
+	return "unknown option " + arg;
+}
+
+struct compile_error { // thrown to abandon a compilation, status is what grc exits with
+	compile_error(int s) : status(s) {}
+	int status;
+};
+
+class compile_cache;
+class stream_state;
+class debug_info;
+class optimization_remarks;
+class alias_tags;
+
+/* All the state of one compilation (what used to be globals and static members of AST)
+ * Sessions don't share anything so many of them can run at the same time on different threads.
+ * While a session compiles, the code of its thread reaches it through session.
+ */
+class compiler_session {
+	public:
+		compiler_session(const compile_options &options, llvm::raw_ostream &output, std::ostream &diagnostics)
+		: TheContext(), Builder(TheContext), i8(llvm::IntegerType::get(TheContext, 8)), i64(llvm::IntegerType::get(TheContext, 64)),
+		  st(), ll_st(), opts(options), out(output), diag(diagnostics), lineno(1), column(1) {}
+
+		int compile(FILE *in); // returns the exit status of the compilation (defined in parser.y)
+
+		llvm::LLVMContext TheContext;
+		llvm::IRBuilder<> Builder;
+		std::unique_ptr<llvm::Module> TheModule;
+		std::unique_ptr<llvm::legacy::FunctionPassManager> TheFPM;
+		std::unique_ptr<llvm::Linker> linker; // of TheModule, for the functions reused from the cache
+
+		llvm::Type *i8;
+		llvm::Type *i64;
+
+		symbol_table    st;
+		ll_symbol_table ll_st;
+
+		llvm::TargetMachine *target = nullptr; // lent by --serve (a warm one), otherwise each compilation creates its own
+		std::unique_ptr<llvm::TargetMachine> own_target;
+		compile_cache       *cache  = nullptr; // where the optimized functions are kept to be reused (--cache)
+		std::shared_ptr<stream_state> stream;  // --stream (see Func_def::stream_begin)
+		std::shared_ptr<debug_info>   debug;   // -g
+		std::shared_ptr<optimization_remarks> remarks; // -Rpass*, -fsave-optimization-record
+		std::shared_ptr<alias_tags>   tbaa;    // -O (see alias.hpp)
+
+		const compile_options opts;
+		llvm::raw_ostream &out;  // generated code
+		std::ostream      &diag; // errors and reports
+		int lineno;
+		int column; // of the next character the lexer reads
+		int parse_error = 2; // what grc exits with when the parser stops at an error (a syntax error, or see lexer.l and parser.y)
+};
+
+extern thread_local compiler_session *session;
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef __SPECIALIZE_HPP__
+#define __SPECIALIZE_HPP__
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <llvm/Analysis/CGSCCPassManager.h>
+#include <llvm/Analysis/LoopAnalysisManager.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Transforms/IPO/SCCP.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+/* -O: the interprocedural part, on the whole module once its functions are compiled and optimized (the function
+ * passes only ever see one function, and every function but main is internal, so all its calls are known).
+ * Function specialization: a call whose arguments are constants (numbers, and pointers into main's frame, like
+ * the static link of the functions nested in main or a ref to one of its variables) may get a clone of the
+ * function with those parameters replaced by the constants, which the function passes then fold. The cost model
+ * weighs what the constants would simplify against the size of the function: a parameter used in a comparison
+ * (a branch that folds away) counts most, one used to address memory (a load or store the alias analysis then
+ * knows the target of) or in arithmetic less. A function is cloned if the bonus is at least a tenth of its size,
+ * it isn't too big to be copied and it doesn't have too many clones already; the calls inside a clone that pass
+ * the same constants call the clone too. Then IPSCCP propagates the constants every call of a function agrees
+ * on (without cloning it) and the return values that are always the same.
+ * Every clone (and every call that wasn't worth one) is an optimization remark of "specialize" (-Rpass=specialize,
+ * -Rpass-missed=specialize and the records).
+ */
+class specializer {
+	public:
+		specializer(llvm::Module &module, llvm::legacy::FunctionPassManager &function_passes) : m(module), fpm(function_passes) {}
+
+		void run() {
+			for(unsigned round = 0; round < max_rounds && specialize_calls(); ++round) continue;
+			run_ipsccp();
+		}
+
+	private:
+		static const unsigned max_rounds    = 3;    // the clones of the clones' calls (with the constants they pass on)
+		static const unsigned max_size      = 1000; // instructions of a function that may be cloned
+		static const unsigned max_clones    = 4;    // per function
+		static const unsigned bonus_percent = 10;   // of its size the bonus of a clone must be
+
+		typedef std::vector<std::pair<unsigned, llvm::Constant*>> constants; // the constant arguments of a call, by their position
+
+		struct clone_t {
+			llvm::Function *f;
+			constants      args;
+			llvm::Function *clone;
+		};
+
+		/* one round: the calls are grouped by their callee and constants, and every group gets a clone if it's
+		 * worth one (or the one it got already), true if a call changed
+		 */
+		bool specialize_calls() {
+			std::map<std::pair<llvm::Function*, constants>, size_t> index;
+			std::vector<std::pair<std::pair<llvm::Function*, constants>, std::vector<llvm::CallInst*>>> groups; // (in the order of the code)
+			for(llvm::Function &caller : m)
+				for(llvm::BasicBlock &bb : caller)
+					for(llvm::Instruction &i : bb) {
+						llvm::CallInst* const call = llvm::dyn_cast<llvm::CallInst>(&i);
+						if(call == nullptr) continue;
+						llvm::Function* const f = call->getCalledFunction();
+						if(f == nullptr || !candidate(*f)) continue;
+						constants args;
+						for(unsigned a = 0; a < call->arg_size(); ++a)
+							if(llvm::Constant* const c = llvm::dyn_cast<llvm::Constant>(call->getArgOperand(a)))
+								if(!llvm::isa<llvm::UndefValue>(c) && bonus(*f->getArg(a)) > 0) args.emplace_back(a, c);
+						if(args.empty()) continue;
+						const auto g = index.emplace(std::make_pair(f, args), groups.size());
+						if(g.second) groups.push_back({{f, args}, {}});
+						groups[g.first->second].second.push_back(call);
+					}
+			bool changed = false;
+			for(auto &g : groups) {
+				llvm::Function* const f = g.first.first;
+				const constants &args = g.first.second;
+				if(f->getNumUses() == g.second.size()) continue; // all its calls agree (IPSCCP propagates them without a clone)
+				llvm::Function *clone = find_clone(f, args);
+				if(clone == nullptr) {
+					unsigned b = 0;
+					for(const auto &a : args) b += bonus(*f->getArg(a.first));
+					const unsigned size = f->getInstructionCount();
+					if(size > max_size || clones_of[f] >= max_clones || b * 100 < size * bonus_percent) {
+						llvm::OptimizationRemarkMissed r("specialize", "NotProfitable", g.second[0]);
+						r << "not specialized " << f->getName() << " for " << describe(*f, args) << " (" << calls(g.second.size())
+						  << "): the bonus is " << std::to_string(b) << " for " << std::to_string(size) << " instructions";
+						if(clones_of[f] >= max_clones) r << " and it has " << std::to_string(max_clones) << " clones already";
+						m.getContext().diagnose(r);
+						continue;
+					}
+					clone = make_clone(f, args);
+					llvm::OptimizationRemark r("specialize", "Specialized", g.second[0]);
+					r << "specialized " << f->getName() << " for " << describe(*f, args) << " as " << clone->getName() << " ("
+					  << calls(g.second.size()) << ", a bonus of " << std::to_string(b) << " for " << std::to_string(size) << " instructions)";
+					m.getContext().diagnose(r);
+				}
+				for(llvm::CallInst* const call : g.second) redirect(call, args, clone);
+				changed = true;
+			}
+			return changed;
+		}
+
+		/* the functions of the Grace program except main: all their calls are in the module */
+		static bool candidate(const llvm::Function &f) {
+			if(f.isDeclaration() || !f.hasLocalLinkage() || f.isVarArg() || f.hasAddressTaken()) return false;
+			return f.getInstructionCount() > 0;
+		}
+
+		/* what the constant value of a parameter would simplify in f */
+		static unsigned bonus(const llvm::Argument &a) {
+			unsigned b = 0;
+			for(const llvm::User* const u : a.users()) {
+				if(llvm::isa<llvm::ICmpInst>(u) || llvm::isa<llvm::SwitchInst>(u) || llvm::isa<llvm::SelectInst>(u)) b += 4; // a branch folds away
+				else if(llvm::isa<llvm::LoadInst>(u) || llvm::isa<llvm::StoreInst>(u) || llvm::isa<llvm::GetElementPtrInst>(u)) b += 2;
+				else if(llvm::isa<llvm::BinaryOperator>(u) || llvm::isa<llvm::CastInst>(u)) b += 1;
+			}
+			return b;
+		}
+
+		llvm::Function *find_clone(llvm::Function* const f, const constants &args) const {
+			for(const clone_t &c : clones)
+				if(c.f == f && c.args == args) return c.clone;
+			return nullptr;
+		}
+
+		/* a copy of f without the parameters that are constants, optimized with them */
+		llvm::Function *make_clone(llvm::Function* const f, const constants &args) {
+			llvm::ValueToValueMapTy map;
+			for(const auto &a : args) map[f->getArg(a.first)] = a.second;
+			llvm::Function* const clone = llvm::CloneFunction(f, map);
+			clone->setName(f->getName() + ".specialized." + std::to_string(++clones_of[f]));
+			clones.push_back({f, args, clone});
+			fpm.run(*clone);
+			return clone;
+		}
+
+		static void redirect(llvm::CallInst* const call, const constants &args, llvm::Function* const clone) {
+			std::vector<llvm::Value*> rest;
+			size_t next = 0;
+			for(unsigned a = 0; a < call->arg_size(); ++a) {
+				if(next < args.size() && args[next].first == a) { ++next; continue; }
+				rest.push_back(call->getArgOperand(a));
+			}
+			llvm::CallInst* const c = llvm::CallInst::Create(clone, rest, "", call);
+			c->setDebugLoc(call->getDebugLoc());
+			c->setCallingConv(call->getCallingConv());
+			c->takeName(call);
+			call->replaceAllUsesWith(c);
+			call->eraseFromParent();
+		}
+
+		static std::string calls(const size_t n) {
+			return std::to_string(n) + (n == 1 ? " call" : " calls");
+		}
+
+		static std::string describe(const llvm::Function &f, const constants &args) {
+			std::string s;
+			for(const auto &a : args) {
+				if(!s.empty()) s += ", ";
+				const llvm::Argument* const p = f.getArg(a.first);
+				s += p->hasName() ? p->getName().str() : a.first == 0 ? "the static link" : "parameter " + std::to_string(a.first);
+				s += " = ";
+				if(const llvm::ConstantInt* const n = llvm::dyn_cast<llvm::ConstantInt>(a.second)) s += std::to_string(n->getSExtValue());
+				else if(llvm::isa<llvm::GlobalVariable>(a.second))                               s += "the frame of main";
+				else                                                                              s += "a variable of main";
+			}
+			return s;
+		}
+
+		void run_ipsccp() {
+			llvm::LoopAnalysisManager LAM;
+			llvm::FunctionAnalysisManager FAM;
+			llvm::CGSCCAnalysisManager CGAM;
+			llvm::ModuleAnalysisManager MAM;
+			llvm::PassBuilder PB;
+			PB.registerModuleAnalyses(MAM);
+			PB.registerCGSCCAnalyses(CGAM);
+			PB.registerFunctionAnalyses(FAM);
+			PB.registerLoopAnalyses(LAM);
+			PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+			llvm::ModulePassManager MPM;
+			MPM.addPass(llvm::IPSCCPPass(llvm::IPSCCPOptions(false))); // (the specialization is ours)
+			MPM.run(m, MAM);
+		}
+
+		llvm::Module &m;
+		llvm::legacy::FunctionPassManager &fpm;
+		std::vector<clone_t> clones;
+		std::map<const llvm::Function*, unsigned> clones_of;
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <string>
 
 // Do print debug tests                       [yes]
 // Add library identifiers                    [yes]
@@ -22,6 +23,7 @@ class Type;
 class Ret_type;
 class Fpar_type;
 class Fpar_def_list;
+class Func_def;
 
 extern Ret_type rNothing;
 extern Ret_type rInt;
@@ -41,8 +43,6 @@ extern Fpar_def_list strcmp_pars;
 extern Fpar_def_list strcpy_pars;
 extern Fpar_def_list strcat_pars;
 
-extern void finish_runtime_syms();
-
 extern bool check_fpt_eq(const Fpar_type* const a, const Fpar_type* const b);
 
 struct condensed_fpar_list_item {
@@ -56,12 +56,30 @@ struct condensed_fpar_list_item {
 
 extern std::vector<condensed_fpar_list_item>* get_condensed_rep_of_fpars(const Fpar_def_list* const fpdl);
 
+/* a variable or parameter by the function it belongs to and its name, since the symbols are gone after sem
+ * (for -O's ref promotion, see Func_def::promote_refs), {nullptr, ""} if an expression isn't a variable
+ */
+typedef std::pair<const Func_def*, std::string> var_id;
+struct call_site {
+	const Func_def      *callee; // nullptr if it isn't defined yet
+	std::vector<var_id> args;    // the variables its arguments are (or are elements of)
+	int                 line;
+};
+
 struct stentry {
 	stentry(bool is_f, Type* const ty, const Ret_type* const rty=nullptr, const std::vector<condensed_fpar_list_item>* const fp=nullptr) : is_fun(is_f), t(ty), rt(rty), fpars(fp) {}
+	~stentry() { delete fpars; }
 	bool is_fun;
 	Type* const t;
 	const Ret_type* const rt;
 	const std::vector<condensed_fpar_list_item>* const fpars;
+	unsigned long long uses = 0; // static number of references, used to order the stack frame
+	int line = 0;                // where it was defined (for -g)
+	const Func_def *def = nullptr; // a function's definition, once it's checked (for the calls evaluated at compile time)
+	const char *impure = nullptr;      // why a function isn't pure, if it isn't by itself (for -fauto-memo)
+	std::vector<const Func_def*> calls; // the functions it calls (by their definitions)
+	std::set<var_id> used, written;     // the variables its code uses and assigns
+	std::vector<call_site> sites;       // its calls of Grace functions
 };
 
 class scope {
@@ -86,18 +104,17 @@ class scope {
 				if(is_fun && owed.find(id_name) != owed.end()) {
 					std::vector<condensed_fpar_list_item>* v = get_condensed_rep_of_fpars(fpdl);
 					if(*v != *(e->second->fpars)) {
-						yyerror("Semantic Error: identifier was previously declared with different formal parameters: ");
-						std::cout << id_name << std::endl;
+						yyerror(("Semantic Error: identifier was previously declared with different formal parameters: " + id_name).c_str());
 						return;
 					}
 
-					latest = new stentry(is_fun, nullptr, rt, v);
+					delete e->second; // the declaration, the definition takes its place
+					e->second = latest = new stentry(is_fun, nullptr, rt, v);
 					owed.erase(id_name);
 					return;
 				}
 
-				yyerror("Semantic Error: redeclaration of identifier: ");
-				std::cout << id_name << std::endl;
+				yyerror(("Semantic Error: redeclaration of identifier: " + id_name).c_str());
 			}
 
 			if(is_fun) {
@@ -121,36 +138,23 @@ class scope {
 
 class symbol_table {
 	public:
-		symbol_table() : scopes() {
-			finish_runtime_syms(); // CAUTION, CALL SYMBOL TABLE CONSTRUCTOR ONLY ONCE,
-								   // OTHERWISE IT WILL APPEND RUNTIME LIB FORMAL PARAMETERS AGAIN FOR SOME FUNS (because of this function, we could make it not do that)
-			
-			push_scope();
-			new_symbol("writeInteger", true, nullptr, &rNothing, &writeInteger_pars);
-			new_symbol("writeChar",    true, nullptr, &rNothing, &writeChar_pars);
-			new_symbol("writeString",  true, nullptr, &rNothing, &writeString_pars);
-
-			new_symbol("readInteger",  true, nullptr, &rInt,     nullptr);
-			new_symbol("readChar",     true, nullptr, &rChar,    nullptr);
-			new_symbol("readString",   true, nullptr, &rNothing, &readString_pars);
-
-			new_symbol("ascii",        true, nullptr, &rInt,     &ascii_pars);
-			new_symbol("chr",          true, nullptr, &rChar,    &chr_pars);
-
-			new_symbol("strlen",       true, nullptr, &rInt,     &strlen_pars);
-			new_symbol("strcmp",       true, nullptr, &rInt,     &strcmp_pars);
-			new_symbol("strcpy",       true, nullptr, &rNothing, &strcpy_pars);
-			new_symbol("strcat",       true, nullptr, &rNothing, &strcat_pars);
-			// the first identifier "main" will also be placed in this scope and set as the owner of the next scope because of the way the compiler uses the symbol table (see ast.hpp in Header class)
+		symbol_table() : scopes(1, runtime_lib_scope()) {}
+		// frees the scopes left when a compilation fails and main (in the copy of the runtime lib scope), without
+		// checking them like pop_scope does. The runtime lib entries are shared by all the sessions
+		~symbol_table() {
+			const std::map<std::string, stentry*> &lib = runtime_lib_scope().symbols;
+			for(const scope &s : scopes)
+				for(const auto &it : s.symbols) {
+					const auto l = lib.find(it.first);
+					if(l == lib.end() || l->second != it.second) delete it.second;
+				}
 		}
-		~symbol_table() { while(!scopes.empty()) pop_scope(); }
 		stentry* lookup(const char* const id_name) {
 			for(auto s = scopes.rbegin(); s != scopes.rend(); ++s) {
 				stentry *e = s->lookup(id_name);
 				if(e != nullptr) return e;
 			}
-			std::cout << id_name << std::endl;
-			yyerror("Semantic Error: Usage of undeclared identifier: ");
+			yyerror(("Semantic Error: Usage of undeclared identifier: " + std::string(id_name)).c_str());
 			return nullptr;
 		}
 
@@ -158,6 +162,8 @@ class symbol_table {
 			scopes.back().new_symbol(id_name, is_fun, t, rt, fpdl, is_fdecl);
 		}
 
+		stentry *get_latest() { return scopes.back().get_latest(); }
+
 		void push_scope() { scopes.push_back(scope()); }
 		void pop_scope() {
 			/* MOVE PRINT CODE TO EXTERN AND ABOVE MAIN IN PARSER.Y SO THAT IT CAN PRINT 
@@ -186,18 +192,54 @@ class symbol_table {
 			*/
 
 			if(scopes.back().owes()) {
-				yyerror("Semantic Error: No definition provided in the same scope for declarations: ");
+				std::string msg = "Semantic Error: No definition provided in the same scope for declarations:";
 				for(const auto &it : scopes.back().owed)
-					std::cout << it << ' ';
-				std::cout << std::endl;
+					msg += ' ' + it;
+				yyerror(msg.c_str());
 			}
+			for(const auto &it : scopes.back().symbols) delete it.second;
 			scopes.pop_back();
 			scope_owners.pop_back();
 		}
 
 		const Ret_type *get_scope_owner_rtype() { return scope_owners.back()->rt; };
+		const std::map<std::string, stentry*> &get_current_symbols() { return scopes.back().symbols; }
 		void set_next_scope_owner_latest_symbol() { scope_owners.push_back(scopes.back().get_latest()); }
+		stentry *get_scope_owner() { return scope_owners.empty() ? nullptr : scope_owners.back(); }
+		const Func_def *owner(const char* const id_name) { // the definition of the function id_name belongs to
+			for(size_t s = scopes.size(); s-- > 1;)
+				if(scopes[s].lookup(id_name) != nullptr) return scope_owners[s - 1]->def;
+			return nullptr;
+		}
+		bool is_runtime_lib(const char* const id_name, const stentry* const e) { return scopes.front().lookup(id_name) == e; }
 	private:
+		/* built once and copied by every symbol table, so the runtime lib entries (and their formal
+		 * parameters) are shared by all sessions and never modified
+		 * the first identifier "main" will also be placed in the copy and set as the owner of the next scope because of the way the compiler uses the symbol table (see ast.hpp in Header class)
+		 */
+		static const scope &runtime_lib_scope() {
+			static const scope lib = [] {
+				scope s;
+				s.new_symbol("writeInteger", true, nullptr, &rNothing, &writeInteger_pars);
+				s.new_symbol("writeChar",    true, nullptr, &rNothing, &writeChar_pars);
+				s.new_symbol("writeString",  true, nullptr, &rNothing, &writeString_pars);
+
+				s.new_symbol("readInteger",  true, nullptr, &rInt,     nullptr);
+				s.new_symbol("readChar",     true, nullptr, &rChar,    nullptr);
+				s.new_symbol("readString",   true, nullptr, &rNothing, &readString_pars);
+
+				s.new_symbol("ascii",        true, nullptr, &rInt,     &ascii_pars);
+				s.new_symbol("chr",          true, nullptr, &rChar,    &chr_pars);
+
+				s.new_symbol("strlen",       true, nullptr, &rInt,     &strlen_pars);
+				s.new_symbol("strcmp",       true, nullptr, &rInt,     &strcmp_pars);
+				s.new_symbol("strcpy",       true, nullptr, &rNothing, &strcpy_pars);
+				s.new_symbol("strcat",       true, nullptr, &rNothing, &strcat_pars);
+				return s;
+			}();
+			return lib;
+		}
+
 		std::vector<scope>    scopes;
 		std::vector<stentry*> scope_owners;
 };